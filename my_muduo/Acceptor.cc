@@ -1,29 +1,79 @@
 #include "Acceptor.h"
 #include "logger.h"
 #include "InetAddress.h"
+#include "MemoryBudget.h"
+#include "EventLoop.h"
 
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <sys/socket.h>
 #include <errno.h>
 
-static int createNonblocking()
+static int createNonblocking(sa_family_t family)
 {
-    int sockfd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int sockfd = ::socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
     if(sockfd < 0)
     {
         LOG_FATAL("%s:%s:%d listen socket create err:%d \n", __FILE__,__FUNCTION__,__LINE__,errno);  
     }
+    return sockfd;
+}
+
+//上一次运行留下的socket文件会让bind失败（EADDRINUSE），只删这种：
+//不是socket的文件不动；还有进程在监听的（connect成功或者backlog满了）也不动，交给bind报错
+void Acceptor::removeStaleUnixSocket(const InetAddress &addr)
+{
+    const std::string path = addr.toIp();
+    struct stat st;
+    if(::lstat(path.c_str(), &st) < 0)
+    {
+        return;
+    }
+    if(!S_ISSOCK(st.st_mode))
+    {
+        LOG_ERROR("%s:%s:%d %s exists and is not a socket, not removed \n",
+                __FILE__,__FUNCTION__,__LINE__,path.c_str());
+        return;
+    }
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(fd < 0)
+    {
+        return;
+    }
+    int ret = ::connect(fd, addr.getSockAddr(), addr.getSockAddrLen());
+    int savedErrno = errno;
+    ::close(fd);
+    if(ret < 0 && savedErrno == ECONNREFUSED)
+    {
+        ::unlink(path.c_str());
+    }
+    else
+    {
+        LOG_ERROR("%s:%s:%d %s is in use by another server \n",
+                __FILE__,__FUNCTION__,__LINE__,path.c_str());
+    }
 }
 
 Acceptor::Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool resuseport)
     : loop_(loop)
-    , acceptSocket_(createNonblocking()) //创建sock
+    , acceptSocket_(createNonblocking(listenAddr.family())) //创建sock，地址族跟着监听地址走
     , acceptChannel_(loop, acceptSocket_.fd()) //封装成channel
     , listenning_(false)
 {
-    acceptSocket_.setReuseAddr(true); //更改TCP选项
-    acceptSocket_.setReusePort(true); 
+    if(listenAddr.isUnix())
+    {
+        //抽象命名空间没有文件；退出时不删，同一个路径可能已经交给了别的进程
+        if(!listenAddr.isAbstract())
+        {
+            removeStaleUnixSocket(listenAddr);
+        }
+    }
+    else
+    {
+        acceptSocket_.setReuseAddr(true); //更改TCP选项
+        acceptSocket_.setReusePort(true); 
+    }
     acceptSocket_.bindAddress(listenAddr); //绑定套接字
     // Tcpserver::start() Acceptor.listen 有新用户的连接
     // 执行一个回调（connfd=> channel => subloop）
@@ -31,6 +81,15 @@ Acceptor::Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool resusepo
     acceptChannel_.setReadCallback(std::bind(&Acceptor::headleRead,this));
 }
 
+Acceptor::Acceptor(EventLoop *loop, int listenfd)
+    : loop_(loop)
+    , acceptSocket_(listenfd)
+    , acceptChannel_(loop, acceptSocket_.fd())
+    , listenning_(false)
+{
+    acceptChannel_.setReadCallback(std::bind(&Acceptor::headleRead,this));
+}
+
 Acceptor::~Acceptor()
 {
     acceptChannel_.disableAll();
@@ -44,6 +103,12 @@ void Acceptor::listen()
     acceptChannel_.enableReading(); //acceptChannel_=> Poller
 }
 
+void Acceptor::stopListening()
+{
+    listenning_ = false;
+    acceptChannel_.disableAll();
+}
+
 //listenfd 有事件发生了，就是有新用户连接了
 void Acceptor::headleRead()
 {
@@ -51,6 +116,15 @@ void Acceptor::headleRead()
     int connfd = acceptSocket_.accept(&peerAddr);
     if(connfd >= 0)
     {
+        //连接缓冲区的内存已经超出全局预算，不再接收新连接
+        if(MemoryBudget::hasPolicy(MemoryBudget::kRejectConnection) && MemoryBudget::exceeded())
+        {
+            LOG_ERROR("%s:%s:%d over memory budget, reject connection, buffered %ld bytes \n",
+                __FILE__,__FUNCTION__,__LINE__,(long)MemoryBudget::totalBytes());
+            ::close(connfd);
+            return;
+        }
+        LoopMetrics::add(loop_->metrics().connectionsAccepted, 1);
         if (newConnetionCallback_)
         {
             newConnetionCallback_(connfd,peerAddr);//轮询找到SUBLOOP唤醒，分发当前的新客户端的Channel
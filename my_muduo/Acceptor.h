@@ -14,6 +14,8 @@ class Acceptor : noncopyable
 public:
     using NewConnectionCallback = std::function<void(int sockfd, const InetAddress&)>;
     Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool resuseport);
+    //接管一个已经绑定好的监听fd（热重启时从旧进程收到的），不再创建和bind
+    Acceptor(EventLoop *loop, int listenfd);
     ~Acceptor();
 
     void setNewConnetionCallback(const NewConnectionCallback &cb)
@@ -22,7 +24,13 @@ public:
     }
 
     bool listenning() const { return listenning_; }
+    int fd() const { return acceptSocket_.fd(); }
     void listen();
+    //不再accept新连接，fd保持打开；内核队列里的连接留给其它持有同一个fd的进程。在loop线程调用
+    void stopListening();
+
+    //Unix域地址bind之前调用：只删除上一次运行留下的socket文件
+    static void removeStaleUnixSocket(const InetAddress &addr);
 private:
     void headleRead();
      
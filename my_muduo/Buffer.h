@@ -5,6 +5,8 @@
 #include <stddef.h>
 #include <string>
 #include <algorithm>
+#include <stdint.h>
+#include <endian.h>
 
 //网络库底层的缓冲期定义
 class Buffer
@@ -28,6 +30,9 @@ public:
 
     size_t prependableBytes() const { return readerIndex_; }
 
+    //底层实际分配的内存，内存预算按这个记账
+    size_t internalCapacity() const { return buffer_.capacity(); }
+
     const char* peek() const
     {
         return begin() + readerIndex_; //返回缓冲区中可读数据的起始地址
@@ -53,6 +58,16 @@ public:
         readerIndex_ = writerIndex_ = kCheapPrepend;
     }
 
+    //没有可读数据时把底层内存缩回初始大小，突发流量撑大的缓冲区不会一直占着内存
+    void shrinkIfEmpty()
+    {
+        if(readableBytes() == 0)
+        {
+            std::vector<char>(kInitialSize + kCheapPrepend).swap(buffer_);
+            retrieveAll();
+        }
+    }
+
     //把onMessage函数上报的Buffer数据，转成string类型的数据返回
     std::string retrieveAllAsString()
     {
@@ -83,6 +98,131 @@ public:
         writerIndex_ += len;
     }
 
+    void append(const void* data, size_t len)
+    {
+        append(static_cast<const char*>(data), len);
+    }
+
+    //整数按网络字节序（大端）追加到可写区
+    void appendInt64(int64_t x)
+    {
+        int64_t be64 = htobe64(x);
+        append(&be64, sizeof be64);
+    }
+
+    void appendInt32(int32_t x)
+    {
+        int32_t be32 = htobe32(x);
+        append(&be32, sizeof be32);
+    }
+
+    void appendInt16(int16_t x)
+    {
+        int16_t be16 = htobe16(x);
+        append(&be16, sizeof be16);
+    }
+
+    void appendInt8(int8_t x)
+    {
+        append(&x, sizeof x);
+    }
+
+    //从可读区开头按网络字节序取整数，不移动readerIndex_，调用前要保证可读数据足够
+    int64_t peekInt64() const
+    {
+        int64_t be64 = 0;
+        ::memcpy(&be64, peek(), sizeof be64);
+        return be64toh(be64);
+    }
+
+    int32_t peekInt32() const
+    {
+        int32_t be32 = 0;
+        ::memcpy(&be32, peek(), sizeof be32);
+        return be32toh(be32);
+    }
+
+    int16_t peekInt16() const
+    {
+        int16_t be16 = 0;
+        ::memcpy(&be16, peek(), sizeof be16);
+        return be16toh(be16);
+    }
+
+    int8_t peekInt8() const
+    {
+        int8_t x = *peek();
+        return x;
+    }
+
+    //取整数并且移动readerIndex_
+    int64_t readInt64()
+    {
+        int64_t result = peekInt64();
+        retrieve(sizeof result);
+        return result;
+    }
+
+    int32_t readInt32()
+    {
+        int32_t result = peekInt32();
+        retrieve(sizeof result);
+        return result;
+    }
+
+    int16_t readInt16()
+    {
+        int16_t result = peekInt16();
+        retrieve(sizeof result);
+        return result;
+    }
+
+    int8_t readInt8()
+    {
+        int8_t result = peekInt8();
+        retrieve(sizeof result);
+        return result;
+    }
+
+    /**
+     * 往kCheapPrepend的头部空间里写数据，可读数据不用挪动
+     * 典型用法是payload写完以后再在前面补上长度头
+    */
+    bool prepend(const void* data, size_t len)
+    {
+        if(len > prependableBytes())
+        {
+            return false;
+        }
+        readerIndex_ -= len;
+        const char* d = static_cast<const char*>(data);
+        std::copy(d, d+len, begin()+readerIndex_);
+        return true;
+    }
+
+    bool prependInt64(int64_t x)
+    {
+        int64_t be64 = htobe64(x);
+        return prepend(&be64, sizeof be64);
+    }
+
+    bool prependInt32(int32_t x)
+    {
+        int32_t be32 = htobe32(x);
+        return prepend(&be32, sizeof be32);
+    }
+
+    bool prependInt16(int16_t x)
+    {
+        int16_t be16 = htobe16(x);
+        return prepend(&be16, sizeof be16);
+    }
+
+    bool prependInt8(int8_t x)
+    {
+        return prepend(&x, sizeof x);
+    }
+
     char* beginWrite() {return begin() + writerIndex_; }
     const char* beginWrite() const {return begin() + writerIndex_; }
 
@@ -13,6 +13,7 @@ using ConnectionCallback = std::function<void (const TcpConnectionPtr&)>;
 using CloseCallback = std::function<void (const TcpConnectionPtr&)>;
 using WriteCompleteCallback = std::function<void (const TcpConnectionPtr&)>;
 using HighWaterMarkCallback = std::function<void (const TcpConnectionPtr&,size_t)>;
+using TimerCallback = std::function<void()>;
 
 using MessageCallback = std::function<void(const TcpConnectionPtr&,
                                         Buffer*,
@@ -1,6 +1,8 @@
 #include "Channel.h"
 #include "EventLoop.h"
 #include "logger.h"
+#include "Tracer.h"
+#include "StallWatchdog.h"
 
 #include <sys/epoll.h>
 
@@ -15,6 +17,7 @@ Channel::Channel(EventLoop *loop,int fd)
     , events_(0)
     , revents_(0)
     , index_(-1)
+    , deferred_(false)
     , tied_(false)
 {
 
@@ -51,6 +54,8 @@ void Channel::remove()
 
 void Channel::handleEvent(TimeStamp receiveTime)
 {
+    TraceSpan span("handleEvent", fd_, revents_);
+    LoopActivity activity(loop_, "handleEvent", fd_);
     
     if(tied_)
     {
@@ -68,6 +73,13 @@ void Channel::handleEvent(TimeStamp receiveTime)
 }
 
 
+//EPOLLHUP/EPOLLERR不管关不关心epoll都会报告，保留
+bool Channel::dropDisabledEvents()
+{
+    revents_ &= events_ | EPOLLHUP | EPOLLERR;
+    return revents_ != 0;
+}
+
 void Channel::handleEventWithGuard(TimeStamp receiveTime)
 {
     LOG_INFO("channel handleEvent revents:%d\n",revents_);
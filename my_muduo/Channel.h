@@ -38,7 +38,8 @@ public:
     //
     int fd() const {return fd_;}
     int events() const {return events_;}
-    int set_revents(int revt) { revents_=revt; }
+    int revents() const {return revents_;}
+    void set_revents(int revt) { revents_=revt; }
 
     //设置fd相应的状态 update()相当于调用epoll_ctl
     void enableReading() { events_ |= kReadEvent; update();} //相当于把读事件给events相应的位置位了
@@ -55,6 +56,12 @@ public:
     int index() {return index_;}
     void set_index(int idx) { index_ = idx;}
 
+    //超出本轮读预算，被EventLoop推迟到下一轮处理
+    bool isDeferred() const { return deferred_; }
+    void setDeferred(bool on) { deferred_ = on; }
+    //推迟期间关掉的事件（比如stopRead）从revents里去掉，返回是否还有事件要处理
+    bool dropDisabledEvents();
+
     // one loop per thread
     EventLoop* onwerLoop() {return loop_;}
     void remove();
@@ -73,6 +80,7 @@ private:
     int events_;           //注册fd感兴趣的事件
     int revents_;          //poller返回的具体发生的事件
     int index_;
+    bool deferred_;
 
     std::weak_ptr<void> tie_;
     bool tied_;
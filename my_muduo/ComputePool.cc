@@ -0,0 +1,264 @@
+#include "ComputePool.h"
+#include "LoopMetrics.h"
+#include "logger.h"
+
+#include <chrono>
+#include <thread>
+#include <algorithm>
+
+//当前线程是哪个线程池的第几个worker，任务里再submit时直接放进自己的队列
+static __thread ComputePool *t_pool = nullptr;
+static __thread int t_workerIndex = -1;
+
+static std::mutex g_poolsMutex;
+static std::vector<ComputePool*> g_pools;
+
+static int64_t nowNanos()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+ComputePool::ComputePool(int numThreads, const std::string &name)
+    : name_(name)
+    , numThreads_(numThreads > 0 ? numThreads : 1)
+    , queued_(0)
+    , submitted_(0)
+    , nextWorker_(0)
+    , running_(false)
+    , sleepers_(0)
+{
+    for(int i = 0; i < numThreads_; ++i)
+    {
+        workers_.emplace_back(new Worker);
+    }
+}
+
+ComputePool::~ComputePool()
+{
+    stop();
+}
+
+void ComputePool::start()
+{
+    if(running_.exchange(true))
+    {
+        return;
+    }
+    for(int i = 0; i < numThreads_; ++i)
+    {
+        workers_[i]->thread.reset(new Thread(std::bind(&ComputePool::runWorker, this, i),
+            name_ + std::to_string(i)));
+        workers_[i]->thread->start();
+    }
+    std::lock_guard<std::mutex> lock(g_poolsMutex);
+    g_pools.push_back(this);
+}
+
+void ComputePool::stop()
+{
+    if(!running_.exchange(false))
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(g_poolsMutex);
+        g_pools.erase(std::remove(g_pools.begin(), g_pools.end(), this), g_pools.end());
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        sleepCond_.notify_all();
+    }
+    for(auto &w : workers_)
+    {
+        w->thread->join();
+    }
+    for(auto &w : workers_)
+    {
+        std::lock_guard<std::mutex> lock(w->mutex);
+        queued_.fetch_sub(w->deque.size() + w->injected.size(), std::memory_order_relaxed);
+        w->deque.clear();
+        w->injected.clear();
+    }
+}
+
+void ComputePool::submit(Task task)
+{
+    submit(std::move(task), false);
+}
+
+void ComputePool::submitFifo(Task task)
+{
+    submit(std::move(task), true);
+}
+
+void ComputePool::submit(Task &&task, bool fifo)
+{
+    if(!running_)
+    {
+        LOG_ERROR("ComputePool [%s] submit before start or after stop, task dropped \n", name_.c_str());
+        return;
+    }
+    Item item;
+    item.task = std::move(task);
+    item.submitNanos = nowNanos();
+    if(t_pool == this && !fifo)
+    {
+        Worker &w = *workers_[t_workerIndex];
+        std::lock_guard<std::mutex> lock(w.mutex);
+        w.deque.push_back(std::move(item));
+    }
+    else
+    {
+        //外部的任务轮流放进各个worker的注入队列，先进先出；worker自己submitFifo的放进自己的注入队列
+        int index = t_pool == this
+            ? t_workerIndex
+            : static_cast<int>(nextWorker_.fetch_add(1, std::memory_order_relaxed) % numThreads_);
+        Worker &w = *workers_[index];
+        std::lock_guard<std::mutex> lock(w.mutex);
+        w.injected.push_back(std::move(item));
+    }
+    wakeWorker();
+}
+
+void ComputePool::wakeWorker()
+{
+    submitted_.fetch_add(1, std::memory_order_relaxed);
+    //和runWorker里先sleepers_++再检查queued_配对，两边都是seq_cst，至少有一边能看到另一边
+    queued_.fetch_add(1);
+    if(sleepers_.load() > 0)
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        sleepCond_.notify_one();
+    }
+}
+
+//自己派生的任务从尾部取（后进先出），注入队列从头部取（先进先出）
+//自己的队列空了，或者每kInjectedInterval个任务，先取注入队列：任务不停地派生新任务时外部的任务也不会一直排着
+bool ComputePool::popOwn(int index, Item *item)
+{
+    Worker &w = *workers_[index];
+    std::lock_guard<std::mutex> lock(w.mutex);
+    bool injectedFirst = w.deque.empty() || ++w.ticks % kInjectedInterval == 0;
+    if(!w.injected.empty() && injectedFirst)
+    {
+        *item = std::move(w.injected.front());
+        w.injected.pop_front();
+    }
+    else if(!w.deque.empty())
+    {
+        *item = std::move(w.deque.back());
+        w.deque.pop_back();
+    }
+    else
+    {
+        return false;
+    }
+    queued_.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+//从下一个worker开始找，偷头部最老的任务，先偷派生的任务，再偷注入队列
+bool ComputePool::steal(int index, Item *item)
+{
+    for(int i = 1; i < numThreads_; ++i)
+    {
+        Worker &victim = *workers_[(index + i) % numThreads_];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        std::deque<Item> &from = victim.deque.empty() ? victim.injected : victim.deque;
+        if(from.empty())
+        {
+            continue;
+        }
+        *item = std::move(from.front());
+        from.pop_front();
+        queued_.fetch_sub(1, std::memory_order_relaxed);
+        LoopMetrics::add(workers_[index]->steals, 1);
+        return true;
+    }
+    return false;
+}
+
+void ComputePool::runWorker(int index)
+{
+    t_pool = this;
+    t_workerIndex = index;
+    Worker &w = *workers_[index];
+    while(running_)
+    {
+        Item item;
+        if(popOwn(index, &item) || steal(index, &item))
+        {
+            int64_t start = nowNanos();
+            w.queueLatency.record(start - item.submitNanos);
+            item.task();
+            w.runTime.record(nowNanos() - start);
+            LoopMetrics::add(w.completed, 1);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        sleepers_.fetch_add(1);
+        sleepCond_.wait(lock, [this]() { return queued_.load() > 0 || !running_; });
+        sleepers_.fetch_sub(1);
+    }
+    t_pool = nullptr;
+    t_workerIndex = -1;
+}
+
+int64_t ComputePool::completed() const
+{
+    int64_t total = 0;
+    for(auto &w : workers_)
+    {
+        total += w->completed.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+int64_t ComputePool::steals() const
+{
+    int64_t total = 0;
+    for(auto &w : workers_)
+    {
+        total += w->steals.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void ComputePool::mergeQueueLatency(Histogram *out) const
+{
+    for(auto &w : workers_)
+    {
+        out->merge(w->queueLatency);
+    }
+}
+
+void ComputePool::mergeRunTime(Histogram *out) const
+{
+    for(auto &w : workers_)
+    {
+        out->merge(w->runTime);
+    }
+}
+
+ComputePool* ComputePool::defaultPool()
+{
+    //不析构，进程退出时还有loop在offload的话不会用到已经析构的线程池
+    static ComputePool *pool = []() {
+        unsigned n = std::thread::hardware_concurrency();
+        ComputePool *p = new ComputePool(n > 0 ? static_cast<int>(n) : 1, "compute");
+        p->start();
+        return p;
+    }();
+    return pool;
+}
+
+void ComputePool::forEachPool(const std::function<void(const ComputePool&)> &cb)
+{
+    std::lock_guard<std::mutex> lock(g_poolsMutex);
+    for(ComputePool *pool : g_pools)
+    {
+        cb(*pool);
+    }
+}
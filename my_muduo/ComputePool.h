@@ -0,0 +1,106 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Thread.h"
+#include "Histogram.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <stdint.h>
+
+/**
+ * 计算线程池：给压缩、加解密、序列化这类CPU密集的任务用，不占用loop线程
+ * 每个worker两个队列：任务里再submit的放进自己的双端队列，自己从尾部取（后进先出，缓存热）；
+ * 外部线程（比如loop线程）submit的轮流放进各个worker的注入队列，先进先出，持续有负载时最老的请求也不会一直排着
+ * 自己的队列都空了就从别的worker的头部偷（偷走的是老任务），任务大小差几个数量级时也不会有worker闲着而别的worker还排着一长串
+ * 每个队列一把锁，只有偷的时候才会和别的worker竞争
+ *
+ * 通常通过 EventLoop::offload(work, continuation) 使用：work在这里执行，continuation回到loop线程执行
+*/
+class ComputePool : noncopyable
+{
+public:
+    using Task = std::function<void()>;
+
+    explicit ComputePool(int numThreads, const std::string &name = "ComputePool");
+    ~ComputePool(); //等正在执行的任务完成，队列里没执行的任务丢弃
+
+    void start();
+    //停止接收任务，唤醒所有worker并join
+    void stop();
+
+    //可以在任意线程调用
+    void submit(Task task);
+    //在worker里调用时也放进注入队列的尾部（外部线程调用和submit一样）：排在已经提交的外部任务后面，
+    //之后提交的任务排在它后面。一个任务执行完想让出worker再接着执行时用，比如Strand每执行一个任务重新提交一次
+    void submitFifo(Task task);
+
+    const std::string& name() const { return name_; }
+    int numThreads() const { return numThreads_; }
+
+    //以下统计可以在任意线程读取
+    int64_t queued() const { return queued_.load(std::memory_order_relaxed); } //还在队列里的任务数
+    int64_t submitted() const { return submitted_.load(std::memory_order_relaxed); }
+    int64_t completed() const;
+    int64_t steals() const;
+    //从submit到开始执行的等待时间、执行时间（纳秒），把所有worker的直方图合并到out里
+    void mergeQueueLatency(Histogram *out) const;
+    void mergeRunTime(Histogram *out) const;
+
+    //EventLoop::offload默认用的进程级线程池，第一次调用时创建，线程数等于cpu个数
+    static ComputePool* defaultPool();
+    //遍历所有已经start的线程池，MetricsServer导出指标用
+    static void forEachPool(const std::function<void(const ComputePool&)> &cb);
+
+private:
+    struct Item
+    {
+        Task task;
+        int64_t submitNanos;
+    };
+
+    //每个worker一个，只有worker自己写统计
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<Item> deque; //自己派生的任务
+        std::deque<Item> injected; //外部submit的任务
+        unsigned ticks; //popOwn的次数，只有worker自己读写
+        std::unique_ptr<Thread> thread;
+        std::atomic<int64_t> completed;
+        std::atomic<int64_t> steals;
+        Histogram queueLatency;
+        Histogram runTime;
+
+        Worker() : ticks(0), completed(0), steals(0) {}
+    };
+
+    void runWorker(int index);
+    bool popOwn(int index, Item *item);
+    bool steal(int index, Item *item);
+    void submit(Task &&task, bool fifo);
+    //任务入队以后更新计数，有worker在睡就唤醒一个
+    void wakeWorker();
+
+    //自己的队列不空时，每隔多少个任务先取一次注入队列
+    static const unsigned kInjectedInterval = 61;
+
+    const std::string name_;
+    const int numThreads_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<int64_t> queued_;
+    std::atomic<int64_t> submitted_;
+    std::atomic<uint32_t> nextWorker_; //外部submit轮流放的下一个worker
+    std::atomic_bool running_;
+
+    //没有任务可做的worker在这里睡，sleepers_>0时submit才需要notify
+    std::mutex sleepMutex_;
+    std::condition_variable sleepCond_;
+    std::atomic<int> sleepers_;
+};
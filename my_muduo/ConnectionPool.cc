@@ -0,0 +1,169 @@
+#include "ConnectionPool.h"
+#include "TcpClient.h"
+#include "TcpConnection.h"
+#include "EventLoop.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <stdio.h>
+
+//空闲的连接上收到的数据没有人要，直接丢掉
+static void discardMessage(const TcpConnectionPtr&, Buffer *buf, TimeStamp)
+{
+    buf->retrieveAll();
+}
+
+ConnectionPool::ConnectionPool(EventLoop *loop, const std::string &name, size_t maxIdlePerBackend)
+    : loop_(loop)
+    , name_(name)
+    , maxIdlePerBackend_(maxIdlePerBackend)
+    , connectTimeout_(3.0)
+    , nextClientId_(1)
+    , created_(0)
+    , reused_(0)
+    , failed_(0)
+    , alive_(std::make_shared<bool>(true))
+{
+}
+
+ConnectionPool::~ConnectionPool()
+{
+    //TcpClient析构时forceClose可能马上触发连接回调，先让所有回调失效
+    alive_.reset();
+    for(auto &item : pending_)
+    {
+        loop_->cancel(item.second.timeout);
+    }
+    pending_.clear();
+    //先放掉空闲连接的引用，TcpClient析构时发现自己是唯一持有者才会关闭连接
+    backends_.clear();
+    clients_.clear();
+}
+
+void ConnectionPool::acquire(const InetAddress &backend, const AcquireCallback &cb)
+{
+    Backend &entry = backends_[backend.toIpPort()];
+    while(!entry.idle.empty())
+    {
+        TcpConnectionPtr conn = entry.idle.back();
+        entry.idle.pop_back();
+        if(conn->connected())
+        {
+            ++reused_;
+            cb(conn);
+            return;
+        }
+    }
+
+    char buf[32] = {0};
+    snprintf(buf,sizeof buf,"-pool#%d",nextClientId_);
+    ++nextClientId_;
+    TcpClient *client = new TcpClient(loop_,backend,name_ + buf);
+    clients_[client] = std::unique_ptr<TcpClient>(client);
+    PendingConnect &pending = pending_[client];
+    pending.cb = cb;
+    std::weak_ptr<bool> alive(alive_);
+    if(connectTimeout_ > 0)
+    {
+        pending.timeout = loop_->runAfter(connectTimeout_, [this, alive, client]() {
+            if(alive.lock())
+            {
+                onConnectTimeout(client);
+            }
+        });
+    }
+    //回调会拷贝到TcpConnection上，连接可能比pool活得久
+    client->setConnectionCallback([this, alive, client](const TcpConnectionPtr &conn) {
+        if(alive.lock())
+        {
+            onConnection(client, conn);
+        }
+    });
+    client->connect();
+}
+
+void ConnectionPool::release(const TcpConnectionPtr &conn)
+{
+    if(!conn->connected())
+    {
+        return;
+    }
+    Backend &entry = backends_[conn->peerAddress().toIpPort()];
+    if(entry.idle.size() >= maxIdlePerBackend_)
+    {
+        conn->shutdown();
+        return;
+    }
+    conn->setMessageCallback(discardMessage);
+    entry.idle.push_back(conn);
+}
+
+size_t ConnectionPool::idleCount(const InetAddress &backend) const
+{
+    auto it = backends_.find(backend.toIpPort());
+    return it == backends_.end() ? 0 : it->second.idle.size();
+}
+
+void ConnectionPool::onConnection(TcpClient *client, const TcpConnectionPtr &conn)
+{
+    if(conn->connected())
+    {
+        auto it = pending_.find(client);
+        if(it == pending_.end())
+        {
+            //已经超时，client马上会被销毁，连接跟着关闭
+            return;
+        }
+        AcquireCallback cb = std::move(it->second.cb);
+        loop_->cancel(it->second.timeout);
+        pending_.erase(it);
+        ++created_;
+        cb(conn);
+    }
+    else
+    {
+        //连接断开了，从空闲列表里摘掉，TcpClient还在关闭流程中，下一轮再销毁
+        removeIdle(conn);
+        queueDestroyClient(client);
+    }
+}
+
+//超时还没连上：停掉Connector的重试，销毁TcpClient，告诉调用者失败了
+void ConnectionPool::onConnectTimeout(TcpClient *client)
+{
+    auto it = pending_.find(client);
+    if(it == pending_.end())
+    {
+        return;
+    }
+    AcquireCallback cb = std::move(it->second.cb);
+    pending_.erase(it);
+    ++failed_;
+    LOG_ERROR("ConnectionPool [%s] - %s connect timeout after %.1fs \n",
+            name_.c_str(),client->name().c_str(),connectTimeout_);
+    //stopInLoop排在销毁client前面执行
+    client->stop();
+    queueDestroyClient(client);
+    cb(TcpConnectionPtr());
+}
+
+void ConnectionPool::removeIdle(const TcpConnectionPtr &conn)
+{
+    auto it = backends_.find(conn->peerAddress().toIpPort());
+    if(it != backends_.end())
+    {
+        std::vector<TcpConnectionPtr> &idle = it->second.idle;
+        idle.erase(std::remove(idle.begin(),idle.end(),conn),idle.end());
+    }
+}
+
+void ConnectionPool::queueDestroyClient(TcpClient *client)
+{
+    std::weak_ptr<bool> alive(alive_);
+    loop_->queueInLoop([this, alive, client]() {
+        if(alive.lock())
+        {
+            clients_.erase(client);
+        }
+    });
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "InetAddress.h"
+#include "Callbacks.h"
+#include "TimerId.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <functional>
+
+class EventLoop;
+class TcpClient;
+
+/**
+ * 每个loop一个的后端连接池，按后端地址(ip:port)分组
+ * handler处理请求时从池子里拿一个已经连好的连接，用完还回来，
+ * 省掉每个请求一次三次握手。只能在所属loop线程中使用
+*/
+class ConnectionPool : noncopyable
+{
+public:
+    using AcquireCallback = std::function<void (const TcpConnectionPtr&)>;
+
+    //maxIdlePerBackend：每个后端最多保留多少个空闲连接，为0表示不复用
+    ConnectionPool(EventLoop *loop, const std::string &name, size_t maxIdlePerBackend = 16);
+    ~ConnectionPool();
+
+    //拿一个到backend的连接，有空闲的直接复用，没有就新建，连上以后回调cb
+    //超时还没连上（比如后端挂了，Connector一直在重试）时cb收到空的TcpConnectionPtr
+    void acquire(const InetAddress &backend, const AcquireCallback &cb);
+
+    //新建连接的超时时间，默认3秒，0表示一直等
+    void setConnectTimeout(double seconds) { connectTimeout_ = seconds; }
+
+    //用完的连接还回池子，超过空闲上限就关闭
+    void release(const TcpConnectionPtr &conn);
+
+    size_t idleCount(const InetAddress &backend) const;
+    int64_t createdCount() const { return created_; } //新建了多少连接
+    int64_t reusedCount() const { return reused_; } //复用了多少次
+    int64_t failedCount() const { return failed_; } //超时没连上的次数
+
+private:
+    struct Backend
+    {
+        std::vector<TcpConnectionPtr> idle; //空闲的连接，从尾部取
+    };
+
+    //还没连上的TcpClient
+    struct PendingConnect
+    {
+        AcquireCallback cb;
+        TimerId timeout;
+    };
+
+    void onConnection(TcpClient *client, const TcpConnectionPtr &conn);
+    void onConnectTimeout(TcpClient *client);
+    void removeIdle(const TcpConnectionPtr &conn);
+    //TcpClient还在关闭流程中，下一轮再销毁
+    void queueDestroyClient(TcpClient *client);
+
+    EventLoop *loop_;
+    const std::string name_;
+    const size_t maxIdlePerBackend_;
+    double connectTimeout_;
+    int nextClientId_;
+    int64_t created_;
+    int64_t reused_;
+    int64_t failed_;
+
+    std::unordered_map<std::string, Backend> backends_; //key是后端的ip:port
+    std::unordered_map<TcpClient*, std::unique_ptr<TcpClient>> clients_; //每个连接对应一个TcpClient
+    std::unordered_map<TcpClient*, PendingConnect> pending_;
+    //连接回调、定时器和queueInLoop的回调都持有weak_ptr，pool析构以后（连接晚些才关闭）不再回调
+    std::shared_ptr<bool> alive_;
+};
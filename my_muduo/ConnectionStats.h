@@ -0,0 +1,38 @@
+#pragma once
+
+#include "TimeStamp.h"
+
+#include <string>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * 一个TcpConnection的流量统计快照
+ * 在连接所属的loop线程里生成，之后可以拷贝到任意线程，用于容量规划、找出异常的客户端
+*/
+struct ConnectionStats
+{
+    std::string name;
+    std::string peer;
+    TimeStamp established;
+
+    int64_t bytesRead = 0;
+    int64_t bytesWritten = 0;
+    int64_t messagesRead = 0;  //messageCallback的调用次数
+    int64_t messagesSent = 0;  //send/sendOutputBuffer的调用次数
+    int64_t readEagain = 0;    //read返回EAGAIN的次数
+    int64_t writeEagain = 0;   //write返回EAGAIN的次数，内核发送缓冲区满了
+    size_t outputBufferBytes = 0;
+    size_t maxOutputBufferBytes = 0;
+    int64_t highWaterMicros = 0; //outputBuffer在高水位以上的累计时间，包括当前这一段
+
+    //最近一次TCP_INFO采样，tcpInfoTime无效表示还没有采样过
+    TimeStamp tcpInfoTime;
+    uint32_t rttMicros = 0;
+    uint32_t rttVarMicros = 0;
+    uint32_t sendCwnd = 0;
+    uint32_t unacked = 0;
+    uint32_t lost = 0;
+    uint32_t retransmits = 0;  //当前这个段的重传次数
+    uint32_t totalRetrans = 0; //整个连接的重传次数
+};
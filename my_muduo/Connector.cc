@@ -0,0 +1,208 @@
+#include "Connector.h"
+#include "Channel.h"
+#include "EventLoop.h"
+#include "logger.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <strings.h>
+#include <errno.h>
+#include <algorithm>
+
+const int Connector::kMaxRetryDelayMs;
+const int Connector::kInitRetryDelayMs;
+
+static int createNonblocking(sa_family_t family)
+{
+    int sockfd = ::socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(sockfd < 0)
+    {
+        LOG_FATAL("%s:%s:%d connect socket create err:%d \n", __FILE__,__FUNCTION__,__LINE__,errno);
+    }
+    return sockfd;
+}
+
+static int getSocketError(int sockfd)
+{
+    int optval;
+    socklen_t optlen = sizeof optval;
+    if(::getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &optval, &optlen) < 0)
+    {
+        return errno;
+    }
+    return optval;
+}
+
+//连到了自己（本地端口和对端端口一样），要断开重试；Unix域socket不会出现
+static bool isSelfConnect(int sockfd)
+{
+    InetAddress local = InetAddress::getLocalAddr(sockfd);
+    return !local.isUnix() && local == InetAddress::getPeerAddr(sockfd);
+}
+
+Connector::Connector(EventLoop *loop, const InetAddress &serverAddr)
+    : loop_(loop)
+    , serverAddr_(serverAddr)
+    , connect_(false)
+    , state_(kDisconnected)
+    , retryDelayMs_(kInitRetryDelayMs)
+{
+}
+
+Connector::~Connector()
+{
+}
+
+void Connector::start()
+{
+    connect_ = true;
+    loop_->runInLoop(std::bind(&Connector::startInLoop,shared_from_this()));
+}
+
+void Connector::startInLoop()
+{
+    if(connect_)
+    {
+        connect();
+    }
+}
+
+void Connector::stop()
+{
+    connect_ = false;
+    loop_->queueInLoop(std::bind(&Connector::stopInLoop,shared_from_this()));
+}
+
+void Connector::stopInLoop()
+{
+    loop_->cancel(retryTimer_);
+    if(state_ == kConnecting)
+    {
+        setState(kDisconnected);
+        int sockfd = removeAndResetChannel();
+        ::close(sockfd);
+    }
+}
+
+void Connector::restart()
+{
+    setState(kDisconnected);
+    retryDelayMs_ = kInitRetryDelayMs;
+    connect_ = true;
+    startInLoop();
+}
+
+void Connector::connect()
+{
+    int sockfd = createNonblocking(serverAddr_.family());
+    int ret = ::connect(sockfd, serverAddr_.getSockAddr(), serverAddr_.getSockAddrLen());
+    int savedErrno = (ret == 0) ? 0 : errno;
+    switch(savedErrno)
+    {
+    case 0:
+    case EINPROGRESS: //非阻塞connect正在进行中
+    case EINTR:
+    case EISCONN:
+        connecting(sockfd);
+        break;
+
+    case EAGAIN:
+    case EADDRINUSE:
+    case EADDRNOTAVAIL:
+    case ECONNREFUSED:
+    case ENETUNREACH:
+    case ENOENT: //Unix域socket的文件还没创建，服务端可能还没启动
+        retry(sockfd);
+        break;
+
+    default:
+        LOG_ERROR("Connector::connect to %s error:%d \n",serverAddr_.toIpPort().c_str(),savedErrno);
+        ::close(sockfd);
+        break;
+    }
+}
+
+//注册epollout，等连接结果
+void Connector::connecting(int sockfd)
+{
+    setState(kConnecting);
+    channel_.reset(new Channel(loop_, sockfd));
+    channel_->setWriteCallback(std::bind(&Connector::handleWrite,this));
+    channel_->setErrorCallback(std::bind(&Connector::handleError,this));
+    channel_->enableWriting();
+}
+
+//channel只负责connect这一段，连上以后fd交给TcpConnection
+int Connector::removeAndResetChannel()
+{
+    channel_->disableAll();
+    channel_->remove();
+    int sockfd = channel_->fd();
+    //现在还在Channel::handleEvent里面，不能直接reset
+    loop_->queueInLoop(std::bind(&Connector::resetChannel,shared_from_this()));
+    return sockfd;
+}
+
+void Connector::resetChannel()
+{
+    channel_.reset();
+}
+
+void Connector::handleWrite()
+{
+    if(state_ == kConnecting)
+    {
+        int sockfd = removeAndResetChannel();
+        int err = getSocketError(sockfd);
+        if(err)
+        {
+            LOG_ERROR("Connector::handleWrite - SO_ERROR = %d \n",err);
+            retry(sockfd);
+        }
+        else if(isSelfConnect(sockfd))
+        {
+            LOG_ERROR("Connector::handleWrite - Self connect \n");
+            retry(sockfd);
+        }
+        else
+        {
+            setState(kConnected);
+            if(connect_)
+            {
+                newConnectionCallback_(sockfd);
+            }
+            else
+            {
+                ::close(sockfd);
+            }
+        }
+    }
+}
+
+void Connector::handleError()
+{
+    LOG_ERROR("Connector::handleError state=%d \n",(int)state_);
+    if(state_ == kConnecting)
+    {
+        int sockfd = removeAndResetChannel();
+        int err = getSocketError(sockfd);
+        LOG_ERROR("Connector::handleError - SO_ERROR = %d \n",err);
+        retry(sockfd);
+    }
+}
+
+//指数退避重试
+void Connector::retry(int sockfd)
+{
+    ::close(sockfd);
+    setState(kDisconnected);
+    if(connect_)
+    {
+        LOG_INFO("Connector::retry - Retry connecting to %s in %d milliseconds. \n",
+                serverAddr_.toIpPort().c_str(),retryDelayMs_);
+        retryTimer_ = loop_->runAfter(retryDelayMs_ / 1000.0,
+                            std::bind(&Connector::startInLoop,shared_from_this()));
+        retryDelayMs_ = std::min(retryDelayMs_ * 2, kMaxRetryDelayMs);
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "InetAddress.h"
+#include "TimerId.h"
+
+#include <functional>
+#include <memory>
+#include <atomic>
+
+class Channel;
+class EventLoop;
+
+/**
+ * 客户端发起连接，TcpServer有Acceptor，TcpClient就有Connector
+ * 非阻塞connect返回EINPROGRESS以后，给channel注册epollout，
+ * 可写了再用SO_ERROR判断连接是否真的建立，失败就按指数退避重试
+*/
+class Connector : noncopyable, public std::enable_shared_from_this<Connector>
+{
+public:
+    using NewConnectionCallback = std::function<void (int sockfd)>;
+
+    Connector(EventLoop *loop, const InetAddress &serverAddr);
+    ~Connector();
+
+    void setNewConnectionCallback(const NewConnectionCallback &cb)
+    {
+        newConnectionCallback_ = cb;
+    }
+
+    const InetAddress& serverAddress() const { return serverAddr_; }
+
+    void start();   //可以跨线程调用
+    void restart(); //只能在loop线程中调用，重置重试间隔重新连接
+    void stop();    //可以跨线程调用
+
+private:
+    enum States { kDisconnected, kConnecting, kConnected };
+    static const int kMaxRetryDelayMs = 30 * 1000; //最大重试间隔30s
+    static const int kInitRetryDelayMs = 500;      //初始重试间隔0.5s
+
+    void setState(States s) { state_ = s; }
+    void startInLoop();
+    void stopInLoop();
+    void connect();
+    void connecting(int sockfd);
+    void handleWrite();
+    void handleError();
+    void retry(int sockfd);
+    int removeAndResetChannel();
+    void resetChannel();
+
+    EventLoop *loop_;
+    InetAddress serverAddr_;
+    std::atomic_bool connect_; //是否需要连接，stop以后为false
+    std::atomic_int state_;
+    std::unique_ptr<Channel> channel_; //连接过程中监听可写事件的channel
+    NewConnectionCallback newConnectionCallback_;
+    int retryDelayMs_;
+    TimerId retryTimer_;
+};
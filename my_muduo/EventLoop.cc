@@ -2,12 +2,18 @@
 #include "logger.h"
 #include "Poller.h"
 #include "Channel.h"
+#include "MemoryBudget.h"
+#include "TimerQueue.h"
+#include "Tracer.h"
+#include "StallWatchdog.h"
+#include "ComputePool.h"
 
 #include <sys/eventfd.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <memory>
 #include <errno.h>
+#include <algorithm>
 
 //防止一个线程创建多个EventLoop
 //当创建了一个EventLoop对象时，*t_loopInThisThread就指向这个对象
@@ -18,6 +24,9 @@ __thread EventLoop *t_loopInThisThread = nullptr;
 //定义默认的Poller IO复用接口的超时时间
 const int kPollTimeMs = 10000;
 
+//有连接在等内存预算时，poll最多阻塞这么久就回来检查一次
+const int kBudgetRetryMs = 10;
+
 //创建wakeupfd 用来notify唤醒subReactor处理新来的channel
 int createEventfd()
 {
@@ -33,11 +42,28 @@ int createEventfd()
 EventLoop::EventLoop()
     : looping_(false)
     , quit_(false)
-    , callingPendingFunctors_(false)
     , threadId_(CurrentThread::tid())
+    , pthreadId_(::pthread_self())
     , poller_(Poller::newDefaultPoller(this)) //当前对象本身就是loop
     , wakeupFd_(createEventfd())
     , wakeupChannel_(new Channel(this,wakeupFd_))
+    , timerQueue_(new TimerQueue(this))
+    , budgetBytes_(0)
+    , budgetMicros_(0)
+    , iterationBytes_(0)
+    , spinWindowMicros_(0)
+    , busyPollMicros_(0)
+    , spinTimeMicros_(0)
+    , workTimeMicros_(0)
+    , spinPolls_(0)
+    , iteration_(0)
+    , bufferShard_(MemoryBudget::allocShard())
+    , bufferedBytes_(0)
+    , overMemoryBudget_(false)
+    , messageHistogram_(nullptr)
+    , computePool_(nullptr)
+    , callingPendingFunctors_(false)
+    , callingFlushFunctors_(false)
 {
     LOG_DEBUG("EventLoop created %p in thread %d \n",this threadId_);
     if(t_loopInThisThread)
@@ -55,11 +81,14 @@ EventLoop::EventLoop()
     //minreactor通过给subreactor写东西，通知其苏醒
     wakeupChannel_->enableReading();
 
+    LoopMetrics::registerLoop(this);
 }
 
 
 EventLoop::~EventLoop()
 {
+    LoopMetrics::unregisterLoop(this); //先注销，汇总指标的线程就不会再读到这个loop
+    timerQueue_.reset(); //先于其他成员析构，它的channel还要从poller里删除
     wakeupChannel_->disableAll();
     wakeupChannel_->remove();
     ::close(wakeupFd_);
@@ -74,15 +103,72 @@ void EventLoop::loop()
 
     LOG_INFO("EventLoop %p start looping \n",this);
 
+    if(!perf_ && PerfCounters::enabledForLoops())
+    {
+        enablePerfCounters();
+    }
+
     while(!quit_)
     {
         activeChannels_.clear();
+        int timeoutMs = pollTimeoutMs();
+        std::chrono::steady_clock::time_point pollStart = std::chrono::steady_clock::now();
         //监听两类fd 一种是client的fd  一种是wakeup
-        pollReturnTime_ = poller_->poll(kPollTimeMs,&activeChannels_);
-        for(Channel *channel : activeChannels_)
+        t_loopPhase = "poll";
+        pollReturnTime_ = poller_->poll(timeoutMs,&activeChannels_);
+        t_loopPhase = "handleEvent";
+        if(perf_)
+        {
+            samplePerf(LoopMetrics::kPerfPoll);
+        }
+        std::chrono::steady_clock::time_point workStart = std::chrono::steady_clock::now();
+        ++iteration_;
+        refreshMemoryBudget();
+
+        int64_t pollNanos = std::chrono::duration_cast<std::chrono::nanoseconds>(workStart - pollStart).count();
+        LoopMetrics::add(metrics_.pollWakeups, 1);
+        LoopMetrics::add(metrics_.pollNanos, pollNanos);
+        LoopMetrics::add(metrics_.eventsDispatched, activeChannels_.size());
+        metrics_.pollBatchSize.record(activeChannels_.size());
+        if(Tracer::enabled())
+        {
+            Tracer::record("epoll_wait",
+                std::chrono::duration_cast<std::chrono::nanoseconds>(pollStart.time_since_epoch()).count(),
+                std::chrono::duration_cast<std::chrono::nanoseconds>(workStart.time_since_epoch()).count(),
+                -1, static_cast<int>(activeChannels_.size()));
+        }
+
+        if(spinWindowMicros_ > 0)
+        {
+            if(activeChannels_.empty())
+            {
+                //什么都没等到，这次poll算空转
+                if(timeoutMs == 0)
+                {
+                    spinPolls_.fetch_add(1,std::memory_order_relaxed);
+                    spinTimeMicros_.fetch_add(pollNanos / 1000,std::memory_order_relaxed);
+                }
+            }
+            else
+            {
+                lastActive_ = workStart;
+            }
+        }
+        if(budgetBytes_ == 0 && budgetMicros_ == 0 && deferredChannels_.empty())
+        {
+            for(Channel *channel : activeChannels_)
+            {
+                //poller监听哪些channel发生事件了，然后上报给EventLoop，通知channel处理相应的事件
+                channel->handleEvent(pollReturnTime_);
+            }
+        }
+        else
+        {
+            handleActiveChannelsWithBudget();
+        }
+        if(perf_)
         {
-            //poller监听哪些channel发生事件了，然后上报给EventLoop，通知channel处理相应的事件
-            channel->handleEvent(pollReturnTime_);
+            samplePerf(LoopMetrics::kPerfDispatch);
         }
         //执行当前EventLoop事件循环需要处理的回调操作
         /**
@@ -92,8 +178,25 @@ void EventLoop::loop()
          * 
         */
         doPendingFunctors();
+
+        //本轮所有事件和回调都处理完了，统一把被cork住的连接的数据发出去
+        doFlushFunctors();
+        if(perf_)
+        {
+            samplePerf(LoopMetrics::kPerfFunctors);
+        }
+
+        int64_t workNanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - workStart).count();
+        LoopMetrics::add(metrics_.callbackNanos, workNanos);
+        metrics_.iterationNanos.record(workNanos);
+        if(spinWindowMicros_ > 0 && !activeChannels_.empty())
+        {
+            workTimeMicros_.fetch_add(workNanos / 1000,std::memory_order_relaxed);
+        }
     }
     LOG_INFO("EventLoop %p stop looping,\n",this);
+    t_loopPhase = nullptr;
     looping_ = false;
 }
 
@@ -146,7 +249,8 @@ void EventLoop::queueInLoop(Functor cb)
     //执行完又阻塞poller_->poll(kPollTimeMs,&activeChannels_);
     //若有添加新的回调pendingFunctors_.emplace_back(cb);
     // 在唤醒一下后执行新的回调doPendingFunctors
-    if(!isInLoopThread() || callingPendingFunctors_) 
+    //flush阶段产生的回调(比如writeCompleteCallback)也需要唤醒，否则要等到下一次poll超时
+    if(!isInLoopThread() || callingPendingFunctors_ || callingFlushFunctors_) 
     {
         wakeup();
     }
@@ -175,6 +279,28 @@ void EventLoop::wakeup()
     }
 }
 
+TimerId EventLoop::runAt(TimeStamp time, TimerCallback cb)
+{
+    return timerQueue_->addTimer(std::move(cb), time, 0.0);
+}
+
+TimerId EventLoop::runAfter(double delay, TimerCallback cb)
+{
+    TimeStamp time(addTime(TimeStamp::now(), delay));
+    return runAt(time, std::move(cb));
+}
+
+TimerId EventLoop::runEvery(double interval, TimerCallback cb)
+{
+    TimeStamp time(addTime(TimeStamp::now(), interval));
+    return timerQueue_->addTimer(std::move(cb), time, interval);
+}
+
+void EventLoop::cancel(TimerId timerId)
+{
+    timerQueue_->cancel(timerId);
+}
+
 //EventLoop的方法=> poller的方法
 void EventLoop::updateChannel(Channel* channel)
 {
@@ -183,6 +309,14 @@ void EventLoop::updateChannel(Channel* channel)
 
 void EventLoop::removeChannel(Channel* channel)
 {
+    //被推迟的channel要从队列里摘掉，否则下一轮会访问到已经析构的channel
+    if(channel->isDeferred())
+    {
+        channel->setDeferred(false);
+        deferredChannels_.erase(
+            std::remove(deferredChannels_.begin(),deferredChannels_.end(),channel),
+            deferredChannels_.end());
+    }
     poller_->removeChannel(channel);
 }
 
@@ -199,16 +333,246 @@ void EventLoop::doPendingFunctors()
     //当有新的事件往里写得时候写不进去(mainloop向subloop里面写回调)
     std::vector<Functor> functors;
     callingPendingFunctors_ = true; //需要执行回调
+    t_loopPhase = "pendingFunctors";
 
     //括号用于上锁 出了括号就解锁了
     {
         std::unique_lock<std::mutex> lock(mutex_);
         functors.swap(pendingFunctors_);
     }
+    if(!functors.empty())
+    {
+        metrics_.functorQueueDepth.record(functors.size());
+        LoopMetrics::add(metrics_.functorsRun, functors.size());
+    }
+    TraceSpan span("doPendingFunctors", -1, static_cast<int>(functors.size()));
 
     for(const Functor &functor: functors)
     {
+        LoopActivity activity(this, "pendingFunctor");
         functor();//执行当前loop需要执行的回调操作
     } 
     callingPendingFunctors_=false;
-} 
\ No newline at end of file
+}
+
+//work在计算线程池里执行，continuation回到loop线程
+void EventLoop::offload(Functor work, Functor continuation)
+{
+    ComputePool *pool = computePool();
+    //continuation按值捕获，work执行完以后跟普通的跨线程回调一样进pendingFunctors_
+    //裸的this：loop必须比在途的work活得久，见EventLoop.h
+    pool->submit([this, work, continuation]() {
+        work();
+        queueInLoop(continuation);
+    });
+}
+
+ComputePool* EventLoop::computePool() const
+{
+    return computePool_ ? computePool_ : ComputePool::defaultPool();
+}
+
+//把cb放到本轮事件循环的最后执行
+void EventLoop::queueFlush(Functor cb)
+{
+    flushFunctors_.emplace_back(std::move(cb));
+}
+
+//执行本轮末尾的flush回调
+void EventLoop::doFlushFunctors()
+{
+    if(flushFunctors_.empty())
+    {
+        return;
+    }
+
+    std::vector<Functor> functors;
+    callingFlushFunctors_ = true;
+    t_loopPhase = "flushFunctors";
+    functors.swap(flushFunctors_);
+    TraceSpan span("doFlushFunctors", -1, static_cast<int>(functors.size()));
+
+    for(const Functor &functor: functors)
+    {
+        LoopActivity activity(this, "flushFunctor");
+        functor();
+    }
+    callingFlushFunctors_ = false;
+}
+
+//每轮事件循环的读预算
+void EventLoop::setIterationBudget(size_t maxBytes, int maxMicros)
+{
+    budgetBytes_ = maxBytes;
+    budgetMicros_ = maxMicros;
+}
+
+bool EventLoop::budgetExhausted() const
+{
+    if(budgetBytes_ > 0 && iterationBytes_ >= budgetBytes_)
+    {
+        return true;
+    }
+    if(budgetMicros_ > 0)
+    {
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - iterationStart_);
+        return elapsed.count() >= budgetMicros_;
+    }
+    return false;
+}
+
+/**
+ * 水平触发下，一个大流量的连接每次读64K，messageCallback_又可能跑很久，
+ * 同一轮里排在后面的连接只能干等。这里给每轮设一个预算，用完以后
+ * 剩下的channel放进deferredChannels_，下一轮（poll超时为0）排在最前面处理
+*/
+void EventLoop::handleActiveChannelsWithBudget()
+{
+    iterationBytes_ = 0;
+    if(budgetMicros_ > 0)
+    {
+        iterationStart_ = std::chrono::steady_clock::now();
+    }
+
+    //上一轮推迟的channel排在前面，本轮poll又返回的同一个channel不重复加入，poller已经用新的revents覆盖了旧的
+    //没有再返回的channel还带着上一轮的revents，推迟期间关掉的事件（比如stopRead）不再分发，什么都不剩的直接丢掉
+    readyChannels_.swap(deferredChannels_);
+    readyChannels_.erase(
+        std::remove_if(readyChannels_.begin(),readyChannels_.end(),[](Channel *channel) {
+            if(channel->dropDisabledEvents())
+            {
+                return false;
+            }
+            channel->setDeferred(false);
+            return true;
+        }),
+        readyChannels_.end());
+    for(Channel *channel : activeChannels_)
+    {
+        if(!channel->isDeferred())
+        {
+            readyChannels_.push_back(channel);
+        }
+    }
+    for(Channel *channel : readyChannels_)
+    {
+        channel->setDeferred(false);
+    }
+
+    size_t i = 0;
+    for(; i < readyChannels_.size(); ++i)
+    {
+        //至少处理一个channel，保证每轮都有进展
+        if(i > 0 && budgetExhausted())
+        {
+            break;
+        }
+        readyChannels_[i]->handleEvent(pollReturnTime_);
+    }
+
+    //预算用完了，剩下的推迟到下一轮
+    for(; i < readyChannels_.size(); ++i)
+    {
+        readyChannels_[i]->setDeferred(true);
+        deferredChannels_.push_back(readyChannels_[i]);
+    }
+    readyChannels_.clear();
+}
+
+//低延迟模式
+void EventLoop::setSpinMode(int spinMicros, int busyPollMicros)
+{
+    spinWindowMicros_ = spinMicros;
+    busyPollMicros_ = busyPollMicros;
+    lastActive_ = std::chrono::steady_clock::now();
+}
+
+//本轮poll的超时时间
+int EventLoop::pollTimeoutMs() const
+{
+    //上一轮有被推迟的channel时不能阻塞，poll一下马上回来接着处理
+    if(!deferredChannels_.empty())
+    {
+        return 0;
+    }
+    int timeoutMs = kPollTimeMs;
+    if(!budgetWaiters_.empty())
+    {
+        timeoutMs = kBudgetRetryMs;
+    }
+    //最近刚有过事件，先空转等下一个事件，省掉一次线程睡眠唤醒的调度开销
+    if(spinWindowMicros_ > 0)
+    {
+        auto idle = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - lastActive_);
+        if(idle.count() < spinWindowMicros_)
+        {
+            return 0;
+        }
+    }
+    return timeoutMs;
+}
+
+void EventLoop::addBufferedBytes(int64_t delta)
+{
+    bufferedBytes_.store(bufferedBytes_.load(std::memory_order_relaxed) + delta,
+                        std::memory_order_relaxed);
+    MemoryBudget::add(bufferShard_, delta);
+}
+
+bool EventLoop::enablePerfCounters()
+{
+    if(perf_)
+    {
+        return true;
+    }
+    std::unique_ptr<PerfCounters> perf(new PerfCounters);
+    if(!perf->open() || !perf->read(&perfLast_))
+    {
+        return false;
+    }
+    perf_ = std::move(perf);
+    metrics_.perfEnabled.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+void EventLoop::samplePerf(int phase)
+{
+    PerfCounters::Values now;
+    if(!perf_->read(&now))
+    {
+        return;
+    }
+    for(int c = 0; c < PerfCounters::kNumCounters; ++c)
+    {
+        LoopMetrics::add(metrics_.perf[phase][c], now.v[c] - perfLast_.v[c]);
+    }
+    perfLast_ = now;
+}
+
+void EventLoop::runWhenUnderBudget(Functor cb)
+{
+    budgetWaiters_.emplace_back(std::move(cb));
+}
+
+//每轮只汇总一次，连接在读写路径上直接看overMemoryBudget_
+void EventLoop::refreshMemoryBudget()
+{
+    if(MemoryBudget::budget() == 0 && budgetWaiters_.empty())
+    {
+        overMemoryBudget_ = false;
+        return;
+    }
+
+    overMemoryBudget_ = MemoryBudget::exceeded();
+    if(!overMemoryBudget_ && !budgetWaiters_.empty())
+    {
+        std::vector<Functor> waiters;
+        waiters.swap(budgetWaiters_);
+        for(const Functor &waiter : waiters)
+        {
+            waiter();
+        }
+    }
+}
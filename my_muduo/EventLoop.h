@@ -5,13 +5,22 @@
 #include <atomic>
 #include <memory>
 #include <mutex>
+#include <chrono>
+#include <type_traits>
+#include <pthread.h>
 
 #include "noncopyable.h"
 #include "TimeStamp.h"
 #include "CurrentThread.h"
+#include "Callbacks.h"
+#include "TimerId.h"
+#include "LoopMetrics.h"
 
 class Channel;
 class Poller;
+class TimerQueue;
+class Histogram;
+class ComputePool;
 
 //事件循环类  主要包含了两大模块 Channel Poller（epoll的抽象）
 class EventLoop : noncopyable
@@ -39,6 +48,87 @@ public:
     //用来唤醒loop所在的线程的
     void wakeup();
 
+    //定时器，可以跨线程调用
+    TimerId runAt(TimeStamp time, TimerCallback cb); //在time时刻执行cb
+    TimerId runAfter(double delay, TimerCallback cb); //delay秒以后执行cb
+    TimerId runEvery(double interval, TimerCallback cb); //每隔interval秒执行一次cb
+    void cancel(TimerId timerId);
+
+    //把cb放到本轮事件循环的最后执行（所有活跃channel和pendingFunctors之后）
+    //用于合并写：同一轮里多次send只在最后flush一次，只能在loop线程中调用
+    void queueFlush(Functor cb);
+
+    //在计算线程池里执行work（压缩、加解密、编码这类CPU密集的活），完成以后把continuation放回这个loop执行
+    //可以在任意线程调用；work执行完会queueInLoop到这个loop上，loop没有生命期保护：
+    //析构loop之前要保证它offload出去的work都执行完了（比如先stop线程池），否则continuation会投递到已经释放的loop上
+    void offload(Functor work, Functor continuation);
+
+    //work的返回值移动给continuation，比如
+    //conn->getLoop()->offloadResult([data]() { return compress(data); }, [conn](std::string out) { conn->send(out); });
+    template<typename Work, typename Continuation>
+    void offloadResult(Work work, Continuation continuation)
+    {
+        using Result = typename std::result_of<Work()>::type;
+        std::shared_ptr<std::unique_ptr<Result>> result = std::make_shared<std::unique_ptr<Result>>();
+        offload([work, result]() { result->reset(new Result(work())); },
+                [continuation, result]() { continuation(std::move(**result)); });
+    }
+
+    //offload用的线程池，nullptr表示用ComputePool::defaultPool()；线程池由调用者持有
+    void setComputePool(ComputePool *pool) { computePool_ = pool; }
+    //offload实际用的线程池
+    ComputePool* computePool() const;
+
+    //每轮事件循环的读预算，超出以后剩下的活跃channel推迟到下一轮优先处理
+    //maxBytes/maxMicros为0表示不限制，需要在loop线程中设置（比如ThreadInitCallback）
+    void setIterationBudget(size_t maxBytes, int maxMicros);
+
+    //连接每次读到数据以后上报给loop，计入本轮的读预算
+    void consumeReadBudget(size_t bytes) { iterationBytes_ += bytes; }
+
+    //低延迟模式：最后一次有事件以后的spinMicros内，用超时为0的poll空转，不进入阻塞
+    //busyPollMicros>0时，这个loop上建立的连接会设置SO_BUSY_POLL
+    //spinMicros为0表示关闭，需要在loop线程中设置（比如ThreadInitCallback）
+    void setSpinMode(int spinMicros, int busyPollMicros = 0);
+    int busyPollMicros() const { return busyPollMicros_; }
+
+    //低延迟模式的统计，可以在其他线程读取
+    int64_t spinTimeMicros() const { return spinTimeMicros_.load(std::memory_order_relaxed); } //空转花的时间
+    int64_t workTimeMicros() const { return workTimeMicros_.load(std::memory_order_relaxed); } //处理事件花的时间
+    int64_t spinPolls() const { return spinPolls_.load(std::memory_order_relaxed); } //空转poll的次数
+
+    //连接缓冲区内存记账，delta为这次增加（负数为减少）的字节数，只在loop线程中调用
+    void addBufferedBytes(int64_t delta);
+    //这个loop上所有连接缓冲区占用的内存（容量），可以在其他线程读取
+    int64_t bufferedBytes() const { return bufferedBytes_.load(std::memory_order_relaxed); }
+
+    //全局内存预算是否超出，每轮事件循环开始时刷新一次
+    bool overMemoryBudget() const { return overMemoryBudget_; }
+    //等全局缓冲降到预算以内以后再执行cb（比如恢复被暂停的读），只在loop线程中调用
+    void runWhenUnderBudget(Functor cb);
+
+    //已经执行了多少轮事件循环
+    uint64_t iteration() const { return iteration_; }
+
+    //运行时指标，只有loop线程写，其他线程可以读
+    LoopMetrics& metrics() { return metrics_; }
+    const LoopMetrics& metrics() const { return metrics_; }
+
+    //给这个loop线程打开硬件性能计数器，按阶段累计到metrics().perf里，需要在loop线程中调用
+    //打不开（内核不支持、没有权限、虚拟机）返回false，loop照常运行
+    //PerfCounters::setEnabledForLoops(true)或者环境变量MUDUO_PERF_COUNTERS=1时loop开始时自动打开
+    bool enablePerfCounters();
+
+    //loop所在线程的tid
+    pid_t threadId() const { return threadId_; }
+    //loop所在线程的pthread_t，StallWatchdog给它发信号抓调用栈
+    pthread_t pthreadId() const { return pthreadId_; }
+
+    //记录这个loop上每次messageCallback的耗时（纳秒），nullptr表示不记录
+    //histogram由调用者持有，只有loop线程写，其他线程可以读；需要在loop线程中设置
+    void setMessageHistogram(Histogram *histogram) { messageHistogram_ = histogram; }
+    Histogram* messageHistogram() const { return messageHistogram_; }
+
     //EventLoop的方法=> poller的方法
     void updateChannel(Channel* channel);
     void removeChannel(Channel* channel);
@@ -53,6 +143,20 @@ private:
  
     void handleRead(); //唤醒用的 wake up
     void doPendingFunctors(); //执行回调的
+    void doFlushFunctors(); //执行本轮末尾的flush回调
+
+    //开启读预算时分发活跃channel，上一轮推迟的先处理
+    void handleActiveChannelsWithBudget();
+    bool budgetExhausted() const;
+
+    //本轮poll的超时时间：有推迟的channel或者还在spin窗口内就不阻塞
+    int pollTimeoutMs() const;
+
+    //刷新全局内存预算状态，降到预算以内就执行等待的回调
+    void refreshMemoryBudget();
+
+    //读一次硬件计数器，把和上一次读数的差值记到phase上
+    void samplePerf(int phase);
 
     using ChannelList = std::vector<Channel*>; 
 
@@ -60,6 +164,7 @@ private:
     std::atomic_bool quit_; //标志退出loop循环
     
     const pid_t threadId_; //记录当前loop所在线程的id
+    const pthread_t pthreadId_;
 
     TimeStamp pollReturnTime_; //poller返回发生事件的channels的时间点
     std::unique_ptr<Poller> poller_;
@@ -69,11 +174,42 @@ private:
     int wakeupFd_;
     std::unique_ptr<Channel> wakeupChannel_;
 
+    std::unique_ptr<TimerQueue> timerQueue_; //定时器队列，timerfd也注册在poller上
+
     ChannelList activeChannels_;
 
+    size_t budgetBytes_; //每轮最多读多少字节，0表示不限制
+    int budgetMicros_; //每轮最多处理多久，0表示不限制
+    size_t iterationBytes_; //本轮已经读了多少字节
+    std::chrono::steady_clock::time_point iterationStart_; //本轮开始处理事件的时间
+    ChannelList readyChannels_; //本轮按顺序待处理的channel
+    ChannelList deferredChannels_; //超出预算被推迟到下一轮的channel
+
+    int spinWindowMicros_; //最后一次有事件以后空转多久，0表示不空转
+    int busyPollMicros_; //连接上SO_BUSY_POLL的值，0表示不设置
+    std::chrono::steady_clock::time_point lastActive_; //最后一次poll到事件的时间
+    std::atomic<int64_t> spinTimeMicros_;
+    std::atomic<int64_t> workTimeMicros_;
+    std::atomic<int64_t> spinPolls_;
+
+    uint64_t iteration_;
+    const int bufferShard_; //内存记账的分片
+    std::atomic<int64_t> bufferedBytes_; //这个loop上所有连接缓冲区占用的内存
+    bool overMemoryBudget_;
+    std::vector<Functor> budgetWaiters_; //等内存降到预算以内再执行的回调，只在loop线程访问
+
+    Histogram *messageHistogram_;
+    ComputePool *computePool_;
+    LoopMetrics metrics_;
+    std::unique_ptr<PerfCounters> perf_; //nullptr表示没有打开硬件计数器
+    PerfCounters::Values perfLast_; //上一次的读数
+
     std::atomic_bool callingPendingFunctors_; //标识当前loop是否有需要执行的回调操作
     std::vector<Functor> pendingFunctors_; //存储loop需要执行的所有回调操作
     std::mutex mutex_;  //互斥锁，用来保护上面vector容器的线程安全操作
 
+    bool callingFlushFunctors_; //标识当前loop是否正在执行flush回调
+    std::vector<Functor> flushFunctors_; //本轮末尾需要执行的flush回调，只在loop线程访问，不需要加锁
+
 };
 
@@ -0,0 +1,172 @@
+#include "Histogram.h"
+
+#include <stdio.h>
+
+const int Histogram::kSubBucketBits;
+const int64_t Histogram::kMaxValue;
+
+Histogram::Histogram()
+{
+    reset();
+}
+
+void Histogram::reset()
+{
+    for(int i = 0; i < kBucketCount; ++i)
+    {
+        counts_[i].store(0, std::memory_order_relaxed);
+    }
+    count_.store(0, std::memory_order_relaxed);
+    sum_.store(0, std::memory_order_relaxed);
+    min_.store(kMaxValue, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+}
+
+/**
+ * value < 128：下标就是value
+ * 否则最高位为msb，shift = msb - 6，sub = value >> shift 落在[64,128)，
+ * 下标 = shift * 64 + sub，和前面的线性区间首尾相接
+*/
+int Histogram::indexOf(int64_t value)
+{
+    if(value < kSubBucketCount)
+    {
+        return static_cast<int>(value);
+    }
+    int msb = 63 - __builtin_clzll(static_cast<uint64_t>(value));
+    int shift = msb - (kSubBucketBits - 1);
+    return shift * kSubBucketHalf + static_cast<int>(value >> shift);
+}
+
+int64_t Histogram::highestEquivalent(int index)
+{
+    if(index < kSubBucketCount)
+    {
+        return index;
+    }
+    int shift = index / kSubBucketHalf - 1;
+    int64_t sub = index % kSubBucketHalf + kSubBucketHalf;
+    return ((sub + 1) << shift) - 1;
+}
+
+void Histogram::recordCount(int64_t value, int64_t count)
+{
+    if(value < 0)
+    {
+        value = 0;
+    }
+    else if(value > kMaxValue)
+    {
+        value = kMaxValue;
+    }
+    add(counts_[indexOf(value)], count);
+    add(count_, count);
+    add(sum_, value * count);
+    if(value < min_.load(std::memory_order_relaxed))
+    {
+        min_.store(value, std::memory_order_relaxed);
+    }
+    if(value > max_.load(std::memory_order_relaxed))
+    {
+        max_.store(value, std::memory_order_relaxed);
+    }
+}
+
+void Histogram::record(int64_t value)
+{
+    recordCount(value, 1);
+}
+
+void Histogram::recordCorrected(int64_t value, int64_t expectedInterval)
+{
+    recordCount(value, 1);
+    if(expectedInterval <= 0)
+    {
+        return;
+    }
+    for(int64_t missing = value - expectedInterval; missing >= expectedInterval; missing -= expectedInterval)
+    {
+        recordCount(missing, 1);
+    }
+}
+
+void Histogram::merge(const Histogram &other)
+{
+    for(int i = 0; i < kBucketCount; ++i)
+    {
+        int64_t c = other.counts_[i].load(std::memory_order_relaxed);
+        if(c > 0)
+        {
+            add(counts_[i], c);
+        }
+    }
+    add(count_, other.count_.load(std::memory_order_relaxed));
+    add(sum_, other.sum_.load(std::memory_order_relaxed));
+    int64_t otherMin = other.min_.load(std::memory_order_relaxed);
+    if(otherMin < min_.load(std::memory_order_relaxed))
+    {
+        min_.store(otherMin, std::memory_order_relaxed);
+    }
+    int64_t otherMax = other.max_.load(std::memory_order_relaxed);
+    if(otherMax > max_.load(std::memory_order_relaxed))
+    {
+        max_.store(otherMax, std::memory_order_relaxed);
+    }
+}
+
+int64_t Histogram::min() const
+{
+    return count() == 0 ? 0 : min_.load(std::memory_order_relaxed);
+}
+
+double Histogram::mean() const
+{
+    int64_t n = count();
+    return n == 0 ? 0.0 : static_cast<double>(sum_.load(std::memory_order_relaxed)) / n;
+}
+
+int64_t Histogram::percentile(double p) const
+{
+    //按桶重新累加一遍总数，写者并发写的时候也不会越界
+    int64_t total = 0;
+    for(int i = 0; i < kBucketCount; ++i)
+    {
+        total += counts_[i].load(std::memory_order_relaxed);
+    }
+    if(total == 0)
+    {
+        return 0;
+    }
+    if(p > 100)
+    {
+        p = 100;
+    }
+    int64_t target = static_cast<int64_t>(p / 100 * total + 0.5);
+    if(target < 1)
+    {
+        target = 1;
+    }
+    int64_t seen = 0;
+    for(int i = 0; i < kBucketCount; ++i)
+    {
+        seen += counts_[i].load(std::memory_order_relaxed);
+        if(seen >= target)
+        {
+            int64_t value = highestEquivalent(i);
+            int64_t maxValue = max();
+            return value < maxValue ? value : maxValue;
+        }
+    }
+    return max();
+}
+
+std::string Histogram::summary() const
+{
+    char buf[256] = {0};
+    snprintf(buf, sizeof buf, "count=%ld mean=%.1f p50=%ld p90=%ld p99=%ld p99.9=%ld max=%ld",
+            static_cast<long>(count()), mean(),
+            static_cast<long>(percentile(50)), static_cast<long>(percentile(90)),
+            static_cast<long>(percentile(99)), static_cast<long>(percentile(99.9)),
+            static_cast<long>(max()));
+    return buf;
+}
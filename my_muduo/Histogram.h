@@ -0,0 +1,71 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <atomic>
+#include <string>
+#include <stdint.h>
+
+/**
+ * HDR风格的对数-线性直方图，用来统计延迟分布
+ * 小于128的值每个值一个桶；往上每个2的幂区间再线性分成64个桶，相对误差小于1.6%
+ * 单写者：一个Histogram只能由一个线程record（比如每个loop线程一个），
+ * 写的时候只有relaxed的load/store，没有锁也没有原子RMW
+ * 其他线程可以随时读取percentile/count，或者merge到自己的Histogram里汇总
+*/
+class Histogram : noncopyable
+{
+public:
+    static const int kSubBucketBits = 7;
+    static const int64_t kMaxValue = (INT64_C(1) << 40) - 1; //超过的值按kMaxValue记录
+
+    Histogram();
+
+    //记录一个值（负数按0记录），只能在写者线程调用
+    void record(int64_t value);
+
+    /**
+     * 修正coordinated omission：闭环压测时一个慢请求会推迟后面所有请求的发送，
+     * 这段时间里本该发出的请求没有被测到。value大于expectedInterval时，
+     * 按HDR的做法补记 value-expectedInterval, value-2*expectedInterval ... 这些样本
+    */
+    void recordCorrected(int64_t value, int64_t expectedInterval);
+
+    //把other的计数加到自己身上，other可以正在被别的线程写；只能在自己的写者线程调用
+    void merge(const Histogram &other);
+
+    //清空，调用时不能有写者在写
+    void reset();
+
+    int64_t count() const { return count_.load(std::memory_order_relaxed); }
+    int64_t min() const;
+    int64_t max() const { return max_.load(std::memory_order_relaxed); }
+    int64_t sum() const { return sum_.load(std::memory_order_relaxed); }
+    double mean() const;
+
+    //第p百分位（0~100）的值，返回所在桶的上界
+    int64_t percentile(double p) const;
+
+    //count=.. mean=.. p50=.. p90=.. p99=.. p99.9=.. max=..
+    std::string summary() const;
+
+private:
+    static const int kSubBucketCount = 1 << kSubBucketBits;
+    static const int kSubBucketHalf = kSubBucketCount / 2;
+    static const int kBucketCount = (40 - kSubBucketBits + 1 + 1) * kSubBucketHalf;
+
+    static int indexOf(int64_t value);
+    static int64_t highestEquivalent(int index);
+
+    void add(std::atomic<int64_t> &counter, int64_t delta)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+    void recordCount(int64_t value, int64_t count);
+
+    std::atomic<int64_t> counts_[kBucketCount];
+    std::atomic<int64_t> count_;
+    std::atomic<int64_t> sum_;
+    std::atomic<int64_t> min_;
+    std::atomic<int64_t> max_;
+};
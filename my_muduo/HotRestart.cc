@@ -0,0 +1,397 @@
+#include "HotRestart.h"
+#include "EventLoop.h"
+#include "TcpServer.h"
+#include "Acceptor.h"
+#include "logger.h"
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+//控制连接上的协议：旧进程发 头部 + 每行一个server名字 + 空行，同一个sendmsg里按顺序带上监听fd；
+//新进程接手以后回 READY，旧进程关掉控制监听和这个连接，新进程读到EOF就知道控制地址空出来了
+static const char kHeader[] = "MUDUO-HOT-RESTART 1\n";
+static const char kReady[] = "READY\n";
+static const int kMaxFds = 64;
+
+static int remainingMs(TimeStamp deadline)
+{
+    double left = timeDifference(deadline, TimeStamp::now());
+    return left > 0 ? static_cast<int>(left * 1000) + 1 : 0;
+}
+
+static bool waitReadable(int fd, TimeStamp deadline)
+{
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    for(;;)
+    {
+        int ms = remainingMs(deadline);
+        if(ms <= 0)
+        {
+            return false;
+        }
+        int n = ::poll(&pfd, 1, ms);
+        if(n > 0)
+        {
+            return true;
+        }
+        if(n < 0 && errno != EINTR)
+        {
+            return false;
+        }
+    }
+}
+
+static void closeAll(const std::vector<int> &fds)
+{
+    for(int fd : fds)
+    {
+        ::close(fd);
+    }
+}
+
+HotRestart::HotRestart(EventLoop *loop, const InetAddress &controlAddr)
+    : loop_(loop)
+    , controlAddr_(controlAddr)
+    , timeoutSeconds_(5.0)
+    , inheritSocket_(-1)
+{
+}
+
+HotRestart::~HotRestart()
+{
+    if(inheritSocket_ >= 0)
+    {
+        ::close(inheritSocket_);
+    }
+    for(auto &item : inheritedFds_)
+    {
+        ::close(item.second);
+    }
+    closeControlListen();
+    closeControlConnection();
+}
+
+bool HotRestart::inherit(double timeoutSeconds)
+{
+    timeoutSeconds_ = timeoutSeconds;
+    int sockfd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(sockfd < 0)
+    {
+        LOG_ERROR("HotRestart::inherit socket errno:%d \n", errno);
+        return false;
+    }
+    if(::connect(sockfd, controlAddr_.getSockAddr(), controlAddr_.getSockAddrLen()) < 0)
+    {
+        //没有旧进程在监听，第一次启动
+        LOG_INFO("HotRestart::inherit no previous process at %s \n", controlAddr_.toIpPort().c_str());
+        ::close(sockfd);
+        return false;
+    }
+
+    TimeStamp deadline(addTime(TimeStamp::now(), timeoutSeconds));
+    std::string payload;
+    std::vector<int> fds;
+    while(payload.size() < 2 || payload.compare(payload.size() - 2, 2, "\n\n") != 0)
+    {
+        if(!waitReadable(sockfd, deadline))
+        {
+            LOG_ERROR("HotRestart::inherit timed out waiting for %s \n", controlAddr_.toIpPort().c_str());
+            closeAll(fds);
+            ::close(sockfd);
+            return false;
+        }
+        char buf[4096];
+        char control[CMSG_SPACE(sizeof(int) * kMaxFds)];
+        struct iovec iov;
+        iov.iov_base = buf;
+        iov.iov_len = sizeof buf;
+        struct msghdr msg;
+        memset(&msg, 0, sizeof msg);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof control;
+        ssize_t n = ::recvmsg(sockfd, &msg, MSG_CMSG_CLOEXEC);
+        if(n <= 0)
+        {
+            if(n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            LOG_ERROR("HotRestart::inherit previous process closed the control connection, errno:%d \n", errno);
+            closeAll(fds);
+            ::close(sockfd);
+            return false;
+        }
+        for(struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm))
+        {
+            if(cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS)
+            {
+                size_t count = (cm->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                const int *received = reinterpret_cast<const int*>(CMSG_DATA(cm));
+                fds.insert(fds.end(), received, received + count);
+            }
+        }
+        if(msg.msg_flags & MSG_CTRUNC)
+        {
+            LOG_ERROR("HotRestart::inherit too many fds, control data truncated \n");
+            closeAll(fds);
+            ::close(sockfd);
+            return false;
+        }
+        payload.append(buf, n);
+    }
+
+    size_t headerLen = sizeof kHeader - 1;
+    if(payload.compare(0, headerLen, kHeader) != 0)
+    {
+        LOG_ERROR("HotRestart::inherit unknown protocol from %s \n", controlAddr_.toIpPort().c_str());
+        closeAll(fds);
+        ::close(sockfd);
+        return false;
+    }
+    std::vector<std::string> names;
+    size_t start = headerLen;
+    for(size_t end; (end = payload.find('\n', start)) != std::string::npos && end > start; start = end + 1)
+    {
+        names.push_back(payload.substr(start, end - start));
+    }
+    if(names.size() != fds.size())
+    {
+        LOG_ERROR("HotRestart::inherit got %d names but %d fds \n", (int)names.size(), (int)fds.size());
+        closeAll(fds);
+        ::close(sockfd);
+        return false;
+    }
+    for(size_t i = 0; i < names.size(); ++i)
+    {
+        inheritedFds_[names[i]] = fds[i];
+        LOG_INFO("HotRestart::inherit listen fd %d for [%s] at %s \n",
+            fds[i], names[i].c_str(), InetAddress::getLocalAddr(fds[i]).toIpPort().c_str());
+    }
+    inheritSocket_ = sockfd;
+    return true;
+}
+
+int HotRestart::takeListenFd(const std::string &name)
+{
+    auto it = inheritedFds_.find(name);
+    if(it == inheritedFds_.end())
+    {
+        return -1;
+    }
+    int fd = it->second;
+    inheritedFds_.erase(it);
+    return fd;
+}
+
+void HotRestart::addServer(TcpServer *server)
+{
+    servers_.push_back(server);
+}
+
+void HotRestart::start()
+{
+    if(inheritSocket_ >= 0)
+    {
+        //新进程已经在accept了，通知旧进程停下来；等它关掉控制连接，说明控制地址已经空出来
+        TimeStamp deadline(addTime(TimeStamp::now(), timeoutSeconds_));
+        if(::write(inheritSocket_, kReady, sizeof kReady - 1) < 0)
+        {
+            LOG_ERROR("HotRestart::start notify previous process errno:%d \n", errno);
+        }
+        char buf[64];
+        while(waitReadable(inheritSocket_, deadline) && ::read(inheritSocket_, buf, sizeof buf) > 0)
+        {
+        }
+        ::close(inheritSocket_);
+        inheritSocket_ = -1;
+
+        //没有被TcpServer接手的fd不再需要
+        for(auto &item : inheritedFds_)
+        {
+            LOG_ERROR("HotRestart::start listen fd for [%s] was not taken, closing \n", item.first.c_str());
+            ::close(item.second);
+        }
+        inheritedFds_.clear();
+    }
+    listenControl();
+}
+
+void HotRestart::listenControl()
+{
+    int fd = ::socket(controlAddr_.family(), SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(fd < 0)
+    {
+        LOG_FATAL("HotRestart control socket create err:%d \n", errno);
+    }
+    controlListenSocket_.reset(new Socket(fd));
+    if(!controlAddr_.isUnix())
+    {
+        controlListenSocket_->setReuseAddr(true);
+    }
+    else if(!controlAddr_.isAbstract())
+    {
+        Acceptor::removeStaleUnixSocket(controlAddr_);
+    }
+    controlListenSocket_->bindAddress(controlAddr_);
+    controlListenSocket_->listen();
+    controlListenChannel_.reset(new Channel(loop_, fd));
+    controlListenChannel_->setReadCallback(std::bind(&HotRestart::handleControlAccept, this));
+    controlListenChannel_->enableReading();
+}
+
+void HotRestart::closeControlListen()
+{
+    if(controlListenChannel_)
+    {
+        controlListenChannel_->disableAll();
+        controlListenChannel_->remove();
+        controlListenChannel_.reset();
+    }
+    controlListenSocket_.reset();
+}
+
+void HotRestart::handleControlAccept()
+{
+    InetAddress peerAddr;
+    int sockfd = controlListenSocket_->accept(&peerAddr);
+    if(sockfd < 0)
+    {
+        if(errno != EAGAIN && errno != EINTR)
+        {
+            LOG_ERROR("HotRestart control accept err:%d \n", errno);
+        }
+        return;
+    }
+    newControlConnection(sockfd);
+}
+
+//新进程连上来了，把所有登记的监听fd发过去
+void HotRestart::newControlConnection(int sockfd)
+{
+    if(controlSocket_)
+    {
+        LOG_ERROR("HotRestart a handoff is already in progress, rejecting \n");
+        ::close(sockfd);
+        return;
+    }
+
+    std::string payload(kHeader);
+    std::vector<int> fds;
+    for(TcpServer *server : servers_)
+    {
+        payload += server->name() + "\n";
+        fds.push_back(server->listenFd());
+    }
+    payload += "\n";
+    if(fds.size() > static_cast<size_t>(kMaxFds))
+    {
+        LOG_ERROR("HotRestart too many servers to hand off: %d \n", (int)fds.size());
+        ::close(sockfd);
+        return;
+    }
+
+    char control[CMSG_SPACE(sizeof(int) * kMaxFds)];
+    memset(control, 0, sizeof control);
+    struct iovec iov;
+    iov.iov_base = &payload[0];
+    iov.iov_len = payload.size();
+    struct msghdr msg;
+    memset(&msg, 0, sizeof msg);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    if(!fds.empty())
+    {
+        msg.msg_control = control;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+        struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+        cm->cmsg_level = SOL_SOCKET;
+        cm->cmsg_type = SCM_RIGHTS;
+        cm->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+        memcpy(CMSG_DATA(cm), fds.data(), sizeof(int) * fds.size());
+    }
+    //消息只有几百字节，新建的连接发送缓冲区一定放得下
+    if(::sendmsg(sockfd, &msg, MSG_NOSIGNAL) != static_cast<ssize_t>(payload.size()))
+    {
+        LOG_ERROR("HotRestart sendmsg to new process errno:%d \n", errno);
+        ::close(sockfd);
+        return;
+    }
+    LOG_INFO("HotRestart handed %d listen fds to a new process, waiting for it to take over \n", (int)fds.size());
+
+    controlInput_.clear();
+    controlSocket_.reset(new Socket(sockfd));
+    controlChannel_.reset(new Channel(loop_, sockfd));
+    controlChannel_->setReadCallback(std::bind(&HotRestart::handleControlRead, this));
+    controlChannel_->enableReading();
+    controlTimeout_ = loop_->runAfter(timeoutSeconds_, std::bind(&HotRestart::handleControlTimeout, this));
+}
+
+void HotRestart::handleControlRead()
+{
+    char buf[64];
+    ssize_t n = ::read(controlSocket_->fd(), buf, sizeof buf);
+    if(n > 0)
+    {
+        controlInput_.append(buf, n);
+        if(controlInput_.find(kReady) == std::string::npos)
+        {
+            return;
+        }
+        LOG_INFO("HotRestart new process took over, stop accepting \n");
+        loop_->cancel(controlTimeout_);
+        for(TcpServer *server : servers_)
+        {
+            server->stopAccepting();
+        }
+        //不能在channel自己的回调里析构它，放到这一轮末尾；先关控制监听再关连接，新进程读到EOF时地址已经空出来
+        loop_->queueInLoop([this]() {
+            closeControlListen();
+            closeControlConnection();
+            if(handoffCallback_)
+            {
+                handoffCallback_();
+            }
+        });
+    }
+    else if(n == 0 || (errno != EAGAIN && errno != EINTR))
+    {
+        //新进程没接手就退出了，继续正常服务，等下一个
+        LOG_ERROR("HotRestart new process went away before taking over \n");
+        controlChannel_->disableAll();
+        loop_->queueInLoop(std::bind(&HotRestart::closeControlConnection, this));
+    }
+}
+
+//新进程连上来以后既不回READY也不断开（比如卡死了），不能一直占着控制连接，否则以后的重启都会被拒绝
+void HotRestart::handleControlTimeout()
+{
+    controlTimeout_ = TimerId();
+    LOG_ERROR("HotRestart new process did not take over within %.1fs, closing control connection \n", timeoutSeconds_);
+    //控制连接的channel可能也在这一轮的活跃列表里，和读出错时一样放到这一轮末尾再析构
+    controlChannel_->disableAll();
+    loop_->queueInLoop(std::bind(&HotRestart::closeControlConnection, this));
+}
+
+void HotRestart::closeControlConnection()
+{
+    if(controlSocket_)
+    {
+        loop_->cancel(controlTimeout_);
+        controlTimeout_ = TimerId();
+    }
+    if(controlChannel_)
+    {
+        controlChannel_->disableAll();
+        controlChannel_->remove();
+        controlChannel_.reset();
+    }
+    controlSocket_.reset();
+}
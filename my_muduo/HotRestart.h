@@ -0,0 +1,78 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "InetAddress.h"
+#include "Socket.h"
+#include "Channel.h"
+#include "TimerId.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <memory>
+#include <map>
+
+class EventLoop;
+class TcpServer;
+
+/**
+ * 热重启：新进程通过一个Unix域控制socket从旧进程拿到监听fd（SCM_RIGHTS），
+ * 新进程开始accept以后旧进程才停止accept并drain已有连接，中间没有拒绝连接的窗口
+ *
+ * 旧进程：addServer登记要交出去的TcpServer，setHandoffCallback，start()开始监听控制地址
+ * 新进程：inherit()连上旧进程收下监听fd，用takeListenFd(name)构造TcpServer并start，
+ *         然后start()通知旧进程已经接手，等旧进程让出控制地址以后自己监听，等下一次重启
+ * 没有旧进程（第一次启动）时inherit()返回false，按正常方式用地址构造TcpServer
+ *
+ * 旧进程等新进程接手最多timeoutSeconds秒（默认5秒），超时关掉这个控制连接，继续服务并等下一次重启
+ * 控制地址建议用抽象命名空间（InetAddress::unixPath(name, true)），不会留下文件
+ * 除了inherit/takeListenFd以外都要在loop线程调用
+*/
+class HotRestart : noncopyable
+{
+public:
+    using HandoffCallback = std::function<void()>;
+
+    HotRestart(EventLoop *loop, const InetAddress &controlAddr);
+    ~HotRestart();
+
+    //新进程启动时调用，阻塞最多timeoutSeconds秒；收到的fd按TcpServer的名字保存
+    bool inherit(double timeoutSeconds = 5.0);
+    //取走收到的名为name的监听fd，之后归调用者所有；没有返回-1
+    int takeListenFd(const std::string &name);
+
+    //这个server的监听fd会交给以后来接手的进程，按server->name()对应
+    void addServer(TcpServer *server);
+    //新进程已经开始accept以后在loop线程回调，一般在里面对每个server调用drain
+    void setHandoffCallback(const HandoffCallback &cb) { handoffCallback_ = cb; }
+
+    //继承了fd的话先通知旧进程并等它让出控制地址，然后开始监听控制地址
+    //等旧进程时用poll阻塞调用线程，最多inherit的timeoutSeconds秒，要在loop.loop()之前调用
+    void start();
+
+private:
+    void listenControl();
+    void closeControlListen();
+    void handleControlAccept();
+    void newControlConnection(int sockfd);
+    void handleControlRead();
+    void handleControlTimeout();
+    void closeControlConnection();
+
+    EventLoop *loop_;
+    InetAddress controlAddr_;
+    double timeoutSeconds_;
+    std::vector<TcpServer*> servers_;
+    HandoffCallback handoffCallback_;
+
+    std::map<std::string,int> inheritedFds_;
+    int inheritSocket_; //新进程连着旧进程的控制连接，start()里通知完就关掉
+
+    //控制地址上的监听，不用Acceptor：控制连接不计入connectionsAccepted，也不会被内存预算拒绝
+    std::unique_ptr<Socket> controlListenSocket_;
+    std::unique_ptr<Channel> controlListenChannel_;
+    std::unique_ptr<Socket> controlSocket_; //旧进程这边正在交接的一个控制连接
+    std::unique_ptr<Channel> controlChannel_;
+    std::string controlInput_; //新进程发回来的内容，等READY
+    TimerId controlTimeout_; //新进程连上来以后timeoutSeconds_秒内没有接手就关掉控制连接
+};
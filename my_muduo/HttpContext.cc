@@ -0,0 +1,222 @@
+#include "HttpContext.h"
+#include "Buffer.h"
+
+#include <algorithm>
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+
+const size_t HttpContext::kMaxHeaderSize;
+const size_t HttpContext::kMaxBodySize;
+
+static const char kCRLF[] = "\r\n";
+
+//请求行 GET /path?query HTTP/1.1
+bool HttpContext::processRequestLine(const char *base, const char *begin, const char *end)
+{
+    const char *space = std::find(begin, end, ' ');
+    if(space == end)
+    {
+        return false;
+    }
+
+    HttpRequest::Method method = HttpRequest::kInvalid;
+    size_t len = space - begin;
+    if(len == 3 && memcmp(begin, "GET", 3) == 0) method = HttpRequest::kGet;
+    else if(len == 4 && memcmp(begin, "POST", 4) == 0) method = HttpRequest::kPost;
+    else if(len == 4 && memcmp(begin, "HEAD", 4) == 0) method = HttpRequest::kHead;
+    else if(len == 3 && memcmp(begin, "PUT", 3) == 0) method = HttpRequest::kPut;
+    else if(len == 6 && memcmp(begin, "DELETE", 6) == 0) method = HttpRequest::kDelete;
+    if(method == HttpRequest::kInvalid)
+    {
+        return false;
+    }
+    request_.method_ = method;
+
+    const char *start = space + 1;
+    space = std::find(start, end, ' ');
+    if(space == end)
+    {
+        return false;
+    }
+    const char *question = std::find(start, space, '?');
+    path_.offset = start - base;
+    path_.length = question - start;
+    if(question != space)
+    {
+        query_.offset = question + 1 - base;
+        query_.length = space - question - 1;
+    }
+    else
+    {
+        query_.offset = 0;
+        query_.length = 0;
+    }
+
+    start = space + 1;
+    if(end - start != 8 || memcmp(start, "HTTP/1.", 7) != 0)
+    {
+        return false;
+    }
+    if(start[7] == '1')
+    {
+        request_.version_ = HttpRequest::kHttp11;
+    }
+    else if(start[7] == '0')
+    {
+        request_.version_ = HttpRequest::kHttp10;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+//头部 Name: value，去掉value两边的空白
+bool HttpContext::processHeader(const char *base, const char *begin, const char *end)
+{
+    const char *colon = std::find(begin, end, ':');
+    if(colon == end || colon == begin)
+    {
+        return false;
+    }
+    const char *value = colon + 1;
+    while(value < end && (*value == ' ' || *value == '\t'))
+    {
+        ++value;
+    }
+    const char *valueEnd = end;
+    while(valueEnd > value && (valueEnd[-1] == ' ' || valueEnd[-1] == '\t'))
+    {
+        --valueEnd;
+    }
+
+    Span field = { static_cast<size_t>(begin - base), static_cast<size_t>(colon - begin) };
+    Span content = { static_cast<size_t>(value - base), static_cast<size_t>(valueEnd - value) };
+    headers_.push_back(std::make_pair(field, content));
+
+    //body长度现在就要知道
+    if(field.length == 14 && strncasecmp(begin, "Content-Length", 14) == 0)
+    {
+        std::string len(value, valueEnd);
+        char *endptr = nullptr;
+        unsigned long long n = strtoull(len.c_str(), &endptr, 10);
+        if(len.empty() || *endptr != '\0' || n > kMaxBodySize)
+        {
+            return false;
+        }
+        contentLength_ = static_cast<size_t>(n);
+    }
+    else if(field.length == 17 && strncasecmp(begin, "Transfer-Encoding", 17) == 0)
+    {
+        //不支持chunked
+        return false;
+    }
+    return true;
+}
+
+void HttpContext::processHeadersDone()
+{
+    if(contentLength_ > 0)
+    {
+        state_ = kExpectBody;
+    }
+    else
+    {
+        body_.offset = parsed_;
+        body_.length = 0;
+        state_ = kGotAll;
+    }
+}
+
+bool HttpContext::parseRequest(Buffer *buf, TimeStamp receiveTime)
+{
+    const char *base = buf->peek();
+    const size_t total = buf->readableBytes();
+
+    while(state_ != kGotAll)
+    {
+        if(state_ == kExpectRequestLine || state_ == kExpectHeaders)
+        {
+            //从上次扫过的位置接着找，\r\n可能正好被拆在两次数据之间，所以退回一个字节
+            size_t from = std::max(parsed_, scanned_ > 0 ? scanned_ - 1 : 0);
+            const char *crlf = std::search(base + from, base + total, kCRLF, kCRLF + 2);
+            if(crlf == base + total)
+            {
+                scanned_ = total;
+                return total <= kMaxHeaderSize; //一直等不到头部结束，请求头太大
+            }
+
+            const char *lineBegin = base + parsed_;
+            bool ok = true;
+            if(state_ == kExpectRequestLine)
+            {
+                ok = processRequestLine(base, lineBegin, crlf);
+                state_ = kExpectHeaders;
+            }
+            else if(crlf == lineBegin)
+            {
+                //空行，头部结束
+                parsed_ = crlf + 2 - base;
+                scanned_ = parsed_;
+                processHeadersDone();
+                continue;
+            }
+            else
+            {
+                ok = processHeader(base, lineBegin, crlf);
+            }
+            if(!ok)
+            {
+                return false;
+            }
+            parsed_ = crlf + 2 - base;
+            scanned_ = parsed_;
+            if(parsed_ > kMaxHeaderSize)
+            {
+                return false;
+            }
+        }
+        else //kExpectBody
+        {
+            if(total - parsed_ < contentLength_)
+            {
+                return true; //body还没收全
+            }
+            body_.offset = parsed_;
+            body_.length = contentLength_;
+            parsed_ += contentLength_;
+            state_ = kGotAll;
+        }
+    }
+
+    fillRequest(base, receiveTime);
+    return true;
+}
+
+//偏移换成指向buffer的视图
+void HttpContext::fillRequest(const char *base, TimeStamp receiveTime)
+{
+    request_.receiveTime_ = receiveTime;
+    request_.path_ = StringPiece(base + path_.offset, path_.length);
+    request_.query_ = StringPiece(base + query_.offset, query_.length);
+    request_.body_ = StringPiece(base + body_.offset, body_.length);
+    request_.headers_.clear();
+    for(const auto &h : headers_)
+    {
+        request_.headers_.push_back(std::make_pair(
+            StringPiece(base + h.first.offset, h.first.length),
+            StringPiece(base + h.second.offset, h.second.length)));
+    }
+}
+
+void HttpContext::reset()
+{
+    state_ = kExpectRequestLine;
+    parsed_ = 0;
+    scanned_ = 0;
+    contentLength_ = 0;
+    headers_.clear();
+    request_.reset();
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "HttpRequest.h"
+#include "TimeStamp.h"
+
+#include <vector>
+#include <utility>
+#include <stddef.h>
+
+class Buffer;
+
+/**
+ * 每个连接一个的http请求解析器，增量的状态机
+ * 直接在Buffer::peek()上解析，不retrieve也不拷贝，只记录各字段相对peek()的偏移，
+ * 下一次数据到来时从上次解析到的位置继续；一个完整的请求到齐以后
+ * 再把偏移换成指向Buffer的视图交给HttpRequest
+*/
+class HttpContext
+{
+public:
+    enum HttpRequestParseState
+    {
+        kExpectRequestLine,
+        kExpectHeaders,
+        kExpectBody,
+        kGotAll,
+    };
+
+    static const size_t kMaxHeaderSize = 64 * 1024;       //请求行加头部最大64K
+    static const size_t kMaxBodySize = 16 * 1024 * 1024;  //body最大16M
+
+    HttpContext()
+        : state_(kExpectRequestLine)
+        , parsed_(0)
+        , scanned_(0)
+        , contentLength_(0)
+        , closing_(false)
+    {}
+
+    //返回false表示请求格式错误或者超过大小限制
+    bool parseRequest(Buffer *buf, TimeStamp receiveTime);
+
+    bool gotAll() const { return state_ == kGotAll; }
+
+    //完整请求在buf里占了多少字节，处理完以后retrieve这么多
+    size_t requestLength() const { return parsed_; }
+
+    //gotAll()以后才有效
+    const HttpRequest& request() const { return request_; }
+
+    //准备解析下一个请求（pipeline）
+    void reset();
+
+    //连接要关闭了（请求出错或者Connection: close），之后收到的数据都丢掉，reset不清除
+    void setClosing() { closing_ = true; }
+    bool closing() const { return closing_; }
+
+private:
+    //相对Buffer::peek()的偏移，buffer扩容挪动数据以后依然有效
+    struct Span
+    {
+        size_t offset;
+        size_t length;
+    };
+
+    bool processRequestLine(const char *base, const char *begin, const char *end);
+    bool processHeader(const char *base, const char *begin, const char *end);
+    void processHeadersDone();
+    void fillRequest(const char *base, TimeStamp receiveTime);
+
+    HttpRequestParseState state_;
+    size_t parsed_;  //已经解析完的字节数
+    size_t scanned_; //已经找过\r\n的位置，避免每次从头扫
+    size_t contentLength_;
+    bool closing_;
+
+    Span path_;
+    Span query_;
+    Span body_;
+    std::vector<std::pair<Span, Span>> headers_;
+    HttpRequest request_;
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "StringPiece.h"
+#include "TimeStamp.h"
+
+#include <vector>
+#include <utility>
+
+/**
+ * 解析出来的一个http请求
+ * 所有字段都是指向连接inputBuffer的视图，没有拷贝，只在HttpCallback里面有效
+*/
+class HttpRequest
+{
+public:
+    enum Method { kInvalid, kGet, kPost, kHead, kPut, kDelete };
+    enum Version { kUnknown, kHttp10, kHttp11 };
+
+    using Header = std::pair<StringPiece, StringPiece>;
+    using HeaderList = std::vector<Header>;
+
+    HttpRequest()
+        : method_(kInvalid)
+        , version_(kUnknown)
+    {}
+
+    Method method() const { return method_; }
+    Version version() const { return version_; }
+    StringPiece path() const { return path_; }
+    StringPiece query() const { return query_; }
+    StringPiece body() const { return body_; }
+    TimeStamp receiveTime() const { return receiveTime_; }
+    const HeaderList& headers() const { return headers_; }
+
+    const char* methodString() const
+    {
+        switch(method_)
+        {
+        case kGet: return "GET";
+        case kPost: return "POST";
+        case kHead: return "HEAD";
+        case kPut: return "PUT";
+        case kDelete: return "DELETE";
+        default: return "UNKNOWN";
+        }
+    }
+
+    //按字段名查找头部，不区分大小写，找不到返回空视图
+    StringPiece header(const StringPiece &field) const
+    {
+        for(const Header &h : headers_)
+        {
+            if(h.first.equalsIgnoreCase(field))
+            {
+                return h.second;
+            }
+        }
+        return StringPiece();
+    }
+
+    //解析完一个请求以后，把视图清空，vector的容量保留下来复用
+    void reset()
+    {
+        method_ = kInvalid;
+        version_ = kUnknown;
+        path_ = StringPiece();
+        query_ = StringPiece();
+        body_ = StringPiece();
+        headers_.clear();
+    }
+
+private:
+    friend class HttpContext;
+
+    Method method_;
+    Version version_;
+    StringPiece path_;
+    StringPiece query_;
+    StringPiece body_;
+    TimeStamp receiveTime_;
+    HeaderList headers_;
+};
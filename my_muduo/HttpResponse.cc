@@ -0,0 +1,37 @@
+#include "HttpResponse.h"
+#include "Buffer.h"
+
+#include <stdio.h>
+
+void HttpResponse::appendToBuffer(Buffer *output) const
+{
+    char buf[64];
+    int n = snprintf(buf, sizeof buf, "HTTP/1.1 %d ", statusCode_);
+    output->append(buf, n);
+    output->append(statusMessage_.data(), statusMessage_.size());
+    output->append("\r\n", 2);
+
+    if(closeConnection_)
+    {
+        static const char kClose[] = "Connection: close\r\n";
+        output->append(kClose, sizeof kClose - 1);
+    }
+    else
+    {
+        n = snprintf(buf, sizeof buf, "Content-Length: %zu\r\n", body_.size());
+        output->append(buf, n);
+        static const char kKeepAlive[] = "Connection: Keep-Alive\r\n";
+        output->append(kKeepAlive, sizeof kKeepAlive - 1);
+    }
+
+    for(const auto &header : headers_)
+    {
+        output->append(header.first.data(), header.first.size());
+        output->append(": ", 2);
+        output->append(header.second.data(), header.second.size());
+        output->append("\r\n", 2);
+    }
+
+    output->append("\r\n", 2);
+    output->append(body_.data(), body_.size());
+}
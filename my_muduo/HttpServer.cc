@@ -0,0 +1,100 @@
+#include "HttpServer.h"
+#include "HttpContext.h"
+#include "HttpRequest.h"
+#include "HttpResponse.h"
+#include "logger.h"
+
+#include <memory>
+
+//默认的回调，所有请求都返回404
+static void defaultHttpCallback(const HttpRequest&, HttpResponse *resp)
+{
+    resp->setStatusCode(HttpResponse::k404NotFound);
+    resp->setStatusMessage("Not Found");
+    resp->setCloseConnection(true);
+}
+
+HttpServer::HttpServer(EventLoop *loop,
+            const InetAddress &listenAddr,
+            const std::string &name,
+            TcpServer::Option option)
+    : server_(loop, listenAddr, name, option)
+    , httpCallback_(defaultHttpCallback)
+{
+    server_.setConnectionCallback(
+        std::bind(&HttpServer::onConnection,this,std::placeholders::_1));
+    server_.setMessageCallback(
+        std::bind(&HttpServer::onMessage,this,
+            std::placeholders::_1,std::placeholders::_2,std::placeholders::_3));
+}
+
+void HttpServer::start()
+{
+    LOG_INFO("HttpServer[%s] starts listening on %s \n",
+            server_.name().c_str(),server_.ipPort().c_str());
+    server_.start();
+}
+
+void HttpServer::onConnection(const TcpConnectionPtr &conn)
+{
+    if(conn->connected())
+    {
+        //每个连接一个解析器
+        conn->setContext(std::make_shared<HttpContext>());
+    }
+}
+
+void HttpServer::onMessage(const TcpConnectionPtr &conn, Buffer *buf, TimeStamp receiveTime)
+{
+    HttpContext *context = static_cast<HttpContext*>(conn->getContext().get());
+    if(context->closing())
+    {
+        //已经回了400或者最后一个应答，等对端关闭，后面的数据不再解析
+        buf->retrieveAll();
+        return;
+    }
+    bool close = false;
+
+    //pipeline：缓冲区里可能有好几个完整的请求
+    while(!close)
+    {
+        if(!context->parseRequest(buf, receiveTime))
+        {
+            static const char kBadRequest[] = "HTTP/1.1 400 Bad Request\r\nConnection: close\r\n\r\n";
+            conn->outputBuffer()->append(kBadRequest, sizeof kBadRequest - 1);
+            close = true;
+            break;
+        }
+        if(!context->gotAll())
+        {
+            break; //剩下的不是一个完整的请求，等更多数据
+        }
+
+        close = onRequest(conn, context->request());
+        buf->retrieve(context->requestLength());
+        context->reset();
+    }
+
+    conn->sendOutputBuffer();
+    if(close)
+    {
+        //出错时解析器停在半个请求上，要关闭的连接剩下的pipeline请求也不再处理
+        context->reset();
+        context->setClosing();
+        buf->retrieveAll();
+        conn->shutdown();
+    }
+}
+
+bool HttpServer::onRequest(const TcpConnectionPtr &conn, const HttpRequest &req)
+{
+    //http/1.1默认长连接，http/1.0默认短连接
+    StringPiece connection = req.header("Connection");
+    bool close = connection.equalsIgnoreCase("close")
+        || (req.version() == HttpRequest::kHttp10 && !connection.equalsIgnoreCase("Keep-Alive"));
+
+    HttpResponse response(close);
+    httpCallback_(req, &response);
+    response.appendToBuffer(conn->outputBuffer());
+    return response.closeConnection();
+}
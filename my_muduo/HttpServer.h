@@ -0,0 +1,46 @@
+#pragma once
+
+#include "TcpServer.h"
+#include "noncopyable.h"
+
+#include <functional>
+#include <string>
+
+class HttpRequest;
+class HttpResponse;
+
+/**
+ * 基于TcpServer的http/1.1服务器
+ * 支持keep-alive和pipeline：一次onMessage里把所有完整的请求都处理掉，
+ * 响应直接序列化进连接的输出缓冲区，最后一起发送
+ * 400和pipeline的应答可能在对端已经关闭以后才写出去，调用者需要忽略SIGPIPE：::signal(SIGPIPE, SIG_IGN)
+*/
+class HttpServer : noncopyable
+{
+public:
+    using HttpCallback = std::function<void (const HttpRequest&, HttpResponse*)>;
+
+    HttpServer(EventLoop *loop,
+            const InetAddress &listenAddr,
+            const std::string &name,
+            TcpServer::Option option = TcpServer::kNoReusePort);
+
+    EventLoop* getLoop() const { return server_.getLoop(); }
+
+    //处理请求的回调，request里面的字段都是视图，只在回调里有效
+    void setHttpCallback(const HttpCallback &cb) { httpCallback_ = cb; }
+
+    void setThreadNum(int numThreads) { server_.setThreadNum(numThreads); }
+    void setThreadInitCallback(const TcpServer::ThreadInitCallback &cb) { server_.setThreadInitCallback(cb); }
+
+    void start();
+
+private:
+    void onConnection(const TcpConnectionPtr &conn);
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, TimeStamp receiveTime);
+    //处理一个请求，返回是否需要关闭连接
+    bool onRequest(const TcpConnectionPtr &conn, const HttpRequest &req);
+
+    TcpServer server_;
+    HttpCallback httpCallback_;
+};
@@ -1,40 +1,174 @@
 #include "InetAddress.h"
+#include "logger.h"
 
 #include <strings.h>
 #include <string.h>
 #include <stdio.h>
+#include <errno.h>
+#include <algorithm>
 
 InetAddress::InetAddress(uint16_t port, std::string ip)
 {
-    bzero(&addr_, sizeof addr_);
+    if(ip.find(':') != std::string::npos)
+    {
+        bzero(&unix_, sizeof unix_);
+        addr6_.sin6_family = AF_INET6;
+        addr6_.sin6_port = htons(port);
+        if(::inet_pton(AF_INET6, ip.c_str(), &addr6_.sin6_addr) <= 0)
+        {
+            LOG_ERROR("InetAddress invalid ipv6 address %s \n", ip.c_str());
+        }
+        len_ = sizeof addr6_;
+        return;
+    }
+    bzero(&unix_, sizeof unix_);
     addr_.sin_family = AF_INET;
     addr_.sin_port = htons(port);//主机字节序到网络字节序
     addr_.sin_addr.s_addr = inet_addr(ip.c_str()); //字符串转成整型数据
+    len_ = sizeof addr_;
+}
+
+InetAddress InetAddress::unixPath(const std::string &path, bool abstract)
+{
+    sockaddr_un addr;
+    bzero(&addr, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    //抽象命名空间第一个字节是'\0'，后面的名字不需要结尾的'\0'
+    size_t offset = abstract ? 1 : 0;
+    size_t maxLen = sizeof addr.sun_path - offset - (abstract ? 0 : 1);
+    if(path.size() > maxLen)
+    {
+        LOG_ERROR("InetAddress unix path too long: %s \n", path.c_str());
+    }
+    size_t n = std::min(path.size(), maxLen);
+    memcpy(addr.sun_path + offset, path.data(), n);
+    socklen_t len = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + offset + n + (abstract ? 0 : 1));
+
+    InetAddress result;
+    result.setSockAddr(reinterpret_cast<const sockaddr*>(&addr), len);
+    return result;
+}
+
+InetAddress InetAddress::getLocalAddr(int sockfd)
+{
+    sockaddr_storage addr;
+    bzero(&addr, sizeof addr);
+    socklen_t addrlen = sizeof addr;
+    if(::getsockname(sockfd, (sockaddr*)&addr, &addrlen) < 0)
+    {
+        LOG_ERROR("sockets::getLocalAddr errno:%d \n", errno);
+    }
+    InetAddress result;
+    result.setSockAddr((sockaddr*)&addr, addrlen);
+    return result;
+}
+
+InetAddress InetAddress::getPeerAddr(int sockfd)
+{
+    sockaddr_storage addr;
+    bzero(&addr, sizeof addr);
+    socklen_t addrlen = sizeof addr;
+    if(::getpeername(sockfd, (sockaddr*)&addr, &addrlen) < 0)
+    {
+        LOG_ERROR("sockets::getPeerAddr errno:%d \n", errno);
+    }
+    InetAddress result;
+    result.setSockAddr((sockaddr*)&addr, addrlen);
+    return result;
+}
+
+void InetAddress::setSockAddr(const sockaddr *addr, socklen_t len)
+{
+    bzero(&unix_, sizeof unix_);
+    if(len > sizeof unix_)
+    {
+        len = sizeof unix_;
+    }
+    memcpy(&addr_, addr, len);
+    len_ = len;
+    //没有名字的Unix socket（比如客户端一端）内核只返回sun_family
+    if(len < sizeof(sa_family_t))
+    {
+        unix_.sun_family = AF_UNIX;
+        len_ = sizeof(sa_family_t);
+    }
 }
 
 std::string InetAddress::toIp() const
 {
     //addr_ 读取ip地址,转换成点分十进制
-    char buf[64] ={0};
-    ::inet_ntop(AF_INET,&addr_.sin_addr,buf,sizeof buf);
+    char buf[128] ={0};
+    switch(family())
+    {
+    case AF_INET6:
+        ::inet_ntop(AF_INET6,&addr6_.sin6_addr,buf,sizeof buf);
+        break;
+    case AF_UNIX:
+    {
+        size_t pathLen = len_ > offsetof(sockaddr_un, sun_path) ? len_ - offsetof(sockaddr_un, sun_path) : 0;
+        if(isAbstract())
+        {
+            return "@" + std::string(unix_.sun_path + 1, pathLen - 1);
+        }
+        return std::string(unix_.sun_path, strnlen(unix_.sun_path, pathLen));
+    }
+    default:
+        ::inet_ntop(AF_INET,&addr_.sin_addr,buf,sizeof buf);
+        break;
+    }
     return buf;
 }
     
 std::string InetAddress::toIpPort() const
 {
     //ip:port 
-    char buf[64] ={0};
-    ::inet_ntop(AF_INET,&addr_.sin_addr,buf,sizeof buf);
-    size_t end=strlen(buf); //ip的有效长度
-    uint16_t port = ntohs(addr_.sin_port);
-    sprintf(buf+end,":%u", port);
+    char buf[160] ={0};
+    switch(family())
+    {
+    case AF_INET6:
+        snprintf(buf, sizeof buf, "[%s]:%u", toIp().c_str(), toPort());
+        break;
+    case AF_UNIX:
+        snprintf(buf, sizeof buf, "unix:%s", toIp().c_str());
+        break;
+    default:
+        snprintf(buf, sizeof buf, "%s:%u", toIp().c_str(), toPort());
+        break;
+    }
     return buf;
 }
    
 uint16_t InetAddress::toPort() const
 {
-    return ntohs(addr_.sin_port);
+    switch(family())
+    {
+    case AF_INET6:
+        return ntohs(addr6_.sin6_port);
+    case AF_UNIX:
+        return 0;
+    default:
+        return ntohs(addr_.sin_port);
+    }
+}
 
+bool InetAddress::operator==(const InetAddress &rhs) const
+{
+    if(family() != rhs.family())
+    {
+        return false;
+    }
+    switch(family())
+    {
+    case AF_INET6:
+        return addr6_.sin6_port == rhs.addr6_.sin6_port
+            && memcmp(&addr6_.sin6_addr, &rhs.addr6_.sin6_addr, sizeof addr6_.sin6_addr) == 0
+            && addr6_.sin6_scope_id == rhs.addr6_.sin6_scope_id;
+    case AF_UNIX:
+        return len_ == rhs.len_ && memcmp(&unix_, &rhs.unix_, len_) == 0;
+    default:
+        return addr_.sin_port == rhs.addr_.sin_port
+            && addr_.sin_addr.s_addr == rhs.addr_.sin_addr.s_addr;
+    }
 }
 
 // #include <iostream>
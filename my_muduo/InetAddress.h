@@ -2,26 +2,65 @@
 
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <stddef.h>
 #include <string>
 
-//封装socket地址类型
+/**
+ * 封装socket地址类型，可以是IPv4、IPv6或者Unix域地址（文件路径或者抽象命名空间）
+ * family()决定用哪个成员，getSockAddr()/getSockAddrLen()直接交给bind/connect/sendto
+*/
 class InetAddress
 {
 private:
-    sockaddr_in addr_;
+    union
+    {
+        sockaddr_in addr_;
+        sockaddr_in6 addr6_;
+        sockaddr_un unix_;
+    };
+    socklen_t len_; //有效长度，抽象命名空间的Unix地址不带结尾的'\0'，只能按长度比较
 public:
+    //ip里带':'的按IPv6解析，比如 InetAddress(8080, "::1")
     explicit InetAddress(uint16_t port = 0, std::string ip="127.0.0.1");
     explicit InetAddress(const sockaddr_in &addr)
-        :addr_(addr)
-        {}
+        {
+            setSockAddr(addr);
+        }
+    explicit InetAddress(const sockaddr_in6 &addr)
+        {
+            setSockAddr(addr);
+        }
 
+    //Unix域地址：abstract为true时放在抽象命名空间（不在文件系统里创建文件，进程退出自动消失）
+    static InetAddress unixPath(const std::string &path, bool abstract = false);
+
+    //sockfd绑定的本端/对端地址
+    static InetAddress getLocalAddr(int sockfd);
+    static InetAddress getPeerAddr(int sockfd);
+
+    sa_family_t family() const { return addr_.sin_family; }
+    bool isUnix() const { return family() == AF_UNIX; }
+    //抽象命名空间的Unix地址
+    bool isAbstract() const { return isUnix() && len_ > offsetof(sockaddr_un, sun_path) && unix_.sun_path[0] == '\0'; }
+
+    //Unix域地址返回路径，抽象命名空间前面加'@'
     std::string toIp() const;
+    //IPv6是[ip]:port，Unix域是unix:路径
     std::string toIpPort() const;
+    //Unix域地址是0
     uint16_t toPort() const;
 
-    const sockaddr_in* getSockAddr() const {return &addr_;}
+    const sockaddr* getSockAddr() const { return reinterpret_cast<const sockaddr*>(&addr_); }
+    socklen_t getSockAddrLen() const { return len_; }
 
-    void setSockAddr(const sockaddr_in &addr) { addr_ = addr; }
+    void setSockAddr(const sockaddr_in &addr) { addr_ = addr; len_ = sizeof addr; }
+    void setSockAddr(const sockaddr_in6 &addr) { addr6_ = addr; len_ = sizeof addr; }
+    //accept/recvfrom/getsockname返回的任意地址，len是内核填的长度
+    void setSockAddr(const sockaddr *addr, socklen_t len);
 
+    //同一个地址族、长度和内容都一样
+    bool operator==(const InetAddress &rhs) const;
+    bool operator!=(const InetAddress &rhs) const { return !(*this == rhs); }
 };
-
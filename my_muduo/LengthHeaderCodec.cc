@@ -0,0 +1,57 @@
+#include "LengthHeaderCodec.h"
+#include "TcpConnection.h"
+#include "Buffer.h"
+#include "logger.h"
+
+const size_t LengthHeaderCodec::kHeaderLen;
+
+LengthHeaderCodec::LengthHeaderCodec(const FrameCallback &cb, size_t maxFrameSize)
+    : frameCallback_(cb)
+    , maxFrameSize_(maxFrameSize)
+{
+}
+
+void LengthHeaderCodec::onMessage(const TcpConnectionPtr &conn, Buffer *buf, TimeStamp receiveTime)
+{
+    //一批小帧在一次回调里全部解出来，每帧只是移动readerIndex_
+    while(buf->readableBytes() >= kHeaderLen)
+    {
+        const int32_t len = buf->peekInt32();
+        if(len < 0 || static_cast<size_t>(len) > maxFrameSize_)
+        {
+            LOG_ERROR("LengthHeaderCodec::onMessage [%s] invalid frame length %d \n",
+                    conn->name().c_str(),len);
+            conn->forceClose();
+            break;
+        }
+        if(buf->readableBytes() < kHeaderLen + len)
+        {
+            break; //半个帧，等后面的数据
+        }
+        frameCallback_(conn, buf->peek() + kHeaderLen, len, receiveTime);
+        buf->retrieve(kHeaderLen + len);
+    }
+}
+
+void LengthHeaderCodec::send(const TcpConnectionPtr &conn, Buffer *payload)
+{
+    int32_t len = static_cast<int32_t>(payload->readableBytes());
+    if(!payload->prependInt32(len))
+    {
+        //头部空间被占用了，退化成拷贝
+        Buffer frame;
+        frame.appendInt32(len);
+        frame.append(payload->peek(), payload->readableBytes());
+        payload->retrieveAll();
+        conn->send(&frame);
+        return;
+    }
+    conn->send(payload);
+}
+
+void LengthHeaderCodec::send(const TcpConnectionPtr &conn, const char *data, size_t len)
+{
+    Buffer frame;
+    frame.append(data, len);
+    send(conn, &frame);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+#include "TimeStamp.h"
+
+#include <functional>
+#include <stddef.h>
+#include <stdint.h>
+
+class Buffer;
+
+/**
+ * 长度头分帧的编解码器：每帧是4字节网络字节序的长度 + payload
+ * 解码：一次onMessage把缓冲区里所有完整的帧都交给上层，payload直接指向inputBuffer
+ * 编码：payload先写进Buffer，长度头写到kCheapPrepend的头部空间，payload不挪动
+*/
+class LengthHeaderCodec : noncopyable
+{
+public:
+    //收到一个完整帧，data指向inputBuffer里的payload，只在回调里有效
+    using FrameCallback = std::function<void (const TcpConnectionPtr&,
+                                            const char *data,
+                                            size_t len,
+                                            TimeStamp)>;
+
+    static const size_t kHeaderLen = sizeof(int32_t);
+
+    explicit LengthHeaderCodec(const FrameCallback &cb,
+                            size_t maxFrameSize = 64 * 1024 * 1024);
+
+    //注册给TcpServer/TcpClient的MessageCallback
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, TimeStamp receiveTime);
+
+    //payload里是要发送的数据，在前面补上长度头以后发送，发送完payload被清空
+    void send(const TcpConnectionPtr &conn, Buffer *payload);
+
+    //没有现成Buffer的时候用这个，会拷贝一次
+    void send(const TcpConnectionPtr &conn, const char *data, size_t len);
+
+private:
+    FrameCallback frameCallback_;
+    const size_t maxFrameSize_;
+};
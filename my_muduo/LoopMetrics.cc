@@ -0,0 +1,94 @@
+#include "LoopMetrics.h"
+
+#include <mutex>
+#include <vector>
+#include <algorithm>
+
+__thread const char *t_loopPhase = nullptr;
+__thread const char *t_loopActivity = nullptr;
+
+//全局的loop登记表，只在loop创建/销毁和汇总指标的时候加锁
+static std::mutex g_loopsMutex;
+static std::vector<EventLoop*> g_loops;
+
+static std::mutex g_serversMutex;
+static std::vector<ServerMetrics*> g_servers;
+
+LoopMetrics::LoopMetrics()
+    : pollWakeups(0)
+    , eventsDispatched(0)
+    , functorsRun(0)
+    , pollNanos(0)
+    , callbackNanos(0)
+    , connectionsAccepted(0)
+    , connectionsEstablished(0)
+    , connectionsClosed(0)
+    , bytesRead(0)
+    , bytesWritten(0)
+    , activitySeq(0)
+    , activityStart(0)
+    , activityName(nullptr)
+    , activityFd(-1)
+    , stalls(0)
+    , stallNanos(0)
+    , perfEnabled(false)
+{
+    for(int p = 0; p < kNumPerfPhases; ++p)
+    {
+        for(int c = 0; c < PerfCounters::kNumCounters; ++c)
+        {
+            perf[p][c].store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+const char* LoopMetrics::perfPhaseName(int phase)
+{
+    static const char *kNames[kNumPerfPhases] = {"poll", "dispatch", "functors"};
+    return kNames[phase];
+}
+
+void LoopMetrics::registerLoop(EventLoop *loop)
+{
+    std::lock_guard<std::mutex> lock(g_loopsMutex);
+    g_loops.push_back(loop);
+}
+
+void LoopMetrics::unregisterLoop(EventLoop *loop)
+{
+    std::lock_guard<std::mutex> lock(g_loopsMutex);
+    g_loops.erase(std::remove(g_loops.begin(), g_loops.end(), loop), g_loops.end());
+}
+
+void LoopMetrics::forEachLoop(const std::function<void(EventLoop*)> &cb)
+{
+    std::lock_guard<std::mutex> lock(g_loopsMutex);
+    for(EventLoop *loop : g_loops)
+    {
+        cb(loop);
+    }
+}
+
+ServerMetrics::ServerMetrics(const std::string &nameArg)
+    : name(nameArg)
+    , connectionsAccepted(0)
+    , activeConnections(0)
+{
+    std::lock_guard<std::mutex> lock(g_serversMutex);
+    g_servers.push_back(this);
+}
+
+ServerMetrics::~ServerMetrics()
+{
+    std::lock_guard<std::mutex> lock(g_serversMutex);
+    g_servers.erase(std::remove(g_servers.begin(), g_servers.end(), this), g_servers.end());
+}
+
+void ServerMetrics::forEachServer(const std::function<void(const ServerMetrics&)> &cb)
+{
+    std::lock_guard<std::mutex> lock(g_serversMutex);
+    for(ServerMetrics *server : g_servers)
+    {
+        cb(*server);
+    }
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Histogram.h"
+#include "PerfCounters.h"
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <stdint.h>
+
+class EventLoop;
+
+//loop线程当前所处的阶段（poll/handleEvent/pendingFunctors/flushFunctors）和正在执行的回调，非loop线程为nullptr
+//Profiler在信号处理函数里读，用initial-exec模型，读写不经过__tls_get_addr
+extern __thread const char *t_loopPhase __attribute__((tls_model("initial-exec")));
+extern __thread const char *t_loopActivity __attribute__((tls_model("initial-exec")));
+
+/**
+ * 每个EventLoop一份的运行时指标
+ * 只有loop线程写，计数器用relaxed的load/store累加，没有锁也没有原子RMW，
+ * 其他线程随时可以读；所有EventLoop登记在一张全局表里，需要的时候遍历汇总
+*/
+struct LoopMetrics : noncopyable
+{
+    LoopMetrics();
+
+    std::atomic<int64_t> pollWakeups;            //epoll_wait返回的次数
+    std::atomic<int64_t> eventsDispatched;       //分发的活跃channel数
+    std::atomic<int64_t> functorsRun;            //执行的pendingFunctors个数
+    std::atomic<int64_t> pollNanos;              //花在epoll_wait里的时间
+    std::atomic<int64_t> callbackNanos;          //处理事件和回调的时间
+    std::atomic<int64_t> connectionsAccepted;    //这个loop上的Acceptor接受的连接
+    std::atomic<int64_t> connectionsEstablished; //分配到这个loop上的连接
+    std::atomic<int64_t> connectionsClosed;
+    std::atomic<int64_t> bytesRead;              //这个loop上所有连接读到的字节
+    std::atomic<int64_t> bytesWritten;           //这个loop上所有连接写出去的字节
+
+    Histogram iterationNanos;    //每轮处理事件和回调的时间，不包括epoll_wait
+    Histogram functorQueueDepth; //每次doPendingFunctors取出的回调个数
+    Histogram pollBatchSize;     //每次epoll_wait返回的活跃channel数
+
+    //loop当前正在执行的回调，由LoopActivity写，StallWatchdog读
+    //activitySeq每进入/离开一个回调加一，watchdog用它判断是不是同一次回调、读到的几个字段是否一致
+    std::atomic<uint64_t> activitySeq;
+    std::atomic<int64_t> activityStart;          //回调开始的时间（steady_clock纳秒），0表示不在回调里
+    std::atomic<const char*> activityName;       //回调的名字，字符串常量
+    std::atomic<int> activityFd;                 //回调所属的fd，-1表示和fd无关
+
+    //卡顿统计，只有StallWatchdog线程写
+    std::atomic<int64_t> stalls;                 //超过阈值的回调次数
+    std::atomic<int64_t> stallNanos;             //这些回调一共卡了多久（watchdog观察到的时长）
+    Histogram stallDuration;                     //每次卡顿的时长
+
+    //硬件计数器按阶段累计，loop打开了PerfCounters才有，只有loop线程写
+    enum PerfPhase
+    {
+        kPerfPoll,     //epoll_wait以及两轮之间的杂事
+        kPerfDispatch, //分发活跃channel
+        kPerfFunctors, //pendingFunctors和flush回调
+        kNumPerfPhases,
+    };
+    std::atomic_bool perfEnabled;
+    std::atomic<int64_t> perf[kNumPerfPhases][PerfCounters::kNumCounters];
+    static const char* perfPhaseName(int phase);
+
+    //只能在loop线程调用
+    static void add(std::atomic<int64_t> &counter, int64_t delta)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+
+    //EventLoop构造和析构的时候登记/注销
+    static void registerLoop(EventLoop *loop);
+    static void unregisterLoop(EventLoop *loop);
+
+    //持锁遍历所有活着的EventLoop，回调里不能创建或销毁EventLoop
+    static void forEachLoop(const std::function<void(EventLoop*)> &cb);
+};
+
+/**
+ * 每个TcpServer一份的指标，只在TcpServer的baseloop线程写
+ * 和LoopMetrics一样登记在全局表里
+*/
+struct ServerMetrics : noncopyable
+{
+    explicit ServerMetrics(const std::string &nameArg);
+    ~ServerMetrics();
+
+    const std::string name;
+    std::atomic<int64_t> connectionsAccepted; //交给这个server的连接
+    std::atomic<int64_t> activeConnections;   //当前的连接数
+
+    //持锁遍历所有活着的TcpServer的指标，回调里不能创建或销毁TcpServer
+    static void forEachServer(const std::function<void(const ServerMetrics&)> &cb);
+};
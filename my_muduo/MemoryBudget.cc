@@ -0,0 +1,33 @@
+#include "MemoryBudget.h"
+
+MemoryBudget::Shard MemoryBudget::shards_[MemoryBudget::kNumShards];
+std::atomic<int> MemoryBudget::nextShard_(0);
+std::atomic<size_t> MemoryBudget::budget_(0);
+std::atomic<int> MemoryBudget::policies_(0);
+
+void MemoryBudget::setBudget(size_t maxBytes, int policies)
+{
+    policies_.store(policies, std::memory_order_relaxed);
+    budget_.store(maxBytes, std::memory_order_relaxed);
+}
+
+int64_t MemoryBudget::totalBytes()
+{
+    int64_t total = 0;
+    for(int i = 0; i < kNumShards; ++i)
+    {
+        total += shards_[i].bytes.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+bool MemoryBudget::exceeded()
+{
+    size_t maxBytes = budget();
+    return maxBytes > 0 && totalBytes() > static_cast<int64_t>(maxBytes);
+}
+
+int MemoryBudget::allocShard()
+{
+    return nextShard_.fetch_add(1, std::memory_order_relaxed) % kNumShards;
+}
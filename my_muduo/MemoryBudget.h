@@ -0,0 +1,60 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * 全进程连接缓冲区(inputBuffer_/outputBuffer_)的内存记账，记的是缓冲区的容量而不是里面的数据量：
+ * 数据发完/读完以后容量还在，按数据量记会在突发流量以后少算；读空的缓冲区超过64KiB时会缩回初始大小
+ * 每个连接空闲时也占两个初始缓冲区（约2KiB），预算要比 连接数*2KiB 大，否则没有流量也会一直超出预算
+ * 每个EventLoop分到一个分片，只在自己的loop线程里累加，互不竞争
+ * 需要总量的时候再把所有分片加起来
+*/
+class MemoryBudget : noncopyable
+{
+public:
+    //超出预算以后的处理策略，可以组合使用
+    enum Policy
+    {
+        kPauseReading = 1,     //暂停读，等总量降下来以后再恢复
+        kRejectConnection = 2, //Acceptor直接关闭新连接
+        kCloseLargest = 4,     //每个loop关闭自己缓冲最多的那个连接
+    };
+
+    //设置全局预算，maxBytes为0表示不限制
+    static void setBudget(size_t maxBytes, int policies);
+    static size_t budget() { return budget_.load(std::memory_order_relaxed); }
+    static bool hasPolicy(Policy policy) { return policies_.load(std::memory_order_relaxed) & policy; }
+
+    //所有分片求和，得到全进程缓冲区占用的内存
+    static int64_t totalBytes();
+
+    //是否超出了预算
+    static bool exceeded();
+
+    //EventLoop创建的时候分配一个分片
+    static int allocShard();
+
+    //对应分片累加delta字节
+    static void add(int shard, int64_t delta)
+    {
+        shards_[shard].bytes.fetch_add(delta, std::memory_order_relaxed);
+    }
+
+private:
+    static const int kNumShards = 64; //超过64个loop时多个loop共用一个分片
+
+    //每个分片独占一个cache line，避免不同loop线程之间的伪共享
+    struct alignas(64) Shard
+    {
+        std::atomic<int64_t> bytes;
+    };
+
+    static Shard shards_[kNumShards];
+    static std::atomic<int> nextShard_;
+    static std::atomic<size_t> budget_;
+    static std::atomic<int> policies_;
+};
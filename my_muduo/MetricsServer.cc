@@ -0,0 +1,414 @@
+#include "MetricsServer.h"
+#include "HttpRequest.h"
+#include "HttpResponse.h"
+#include "EventLoop.h"
+#include "MemoryBudget.h"
+#include "Tracer.h"
+#include "Profiler.h"
+#include "ComputePool.h"
+#include "Histogram.h"
+
+#include <vector>
+#include <memory>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+//汇总时先持锁把每个loop的值拷出来，生成文本的时候不再持锁
+struct LoopSnapshot
+{
+    pid_t tid;
+    int64_t counters[12];
+    int64_t bufferedBytes;
+    //每个直方图：p50 p90 p99 p99.9 sum count
+    int64_t histograms[4][6];
+    bool perfEnabled;
+    int64_t perf[LoopMetrics::kNumPerfPhases][PerfCounters::kNumCounters];
+};
+
+struct CounterFamily
+{
+    const char *name;
+    const char *help;
+    double scale; //纳秒的计数器换算成秒
+};
+
+static const CounterFamily kCounters[] = {
+    {"muduo_loop_poll_wakeups_total", "Number of times epoll_wait returned.", 1},
+    {"muduo_loop_events_total", "Active channels returned by epoll_wait.", 1},
+    {"muduo_loop_functors_total", "Pending functors run by the loop.", 1},
+    {"muduo_loop_poll_seconds_total", "Time spent blocked in epoll_wait.", 1e-9},
+    {"muduo_loop_callback_seconds_total", "Time spent dispatching events and running callbacks.", 1e-9},
+    {"muduo_loop_connections_accepted_total", "Connections accepted by acceptors on this loop.", 1},
+    {"muduo_loop_connections_established_total", "Connections established on this loop.", 1},
+    {"muduo_loop_connections_closed_total", "Connections destroyed on this loop.", 1},
+    {"muduo_loop_read_bytes_total", "Bytes read by connections on this loop.", 1},
+    {"muduo_loop_written_bytes_total", "Bytes written by connections on this loop.", 1},
+    {"muduo_loop_stalls_total", "Callbacks that ran longer than the stall watchdog threshold.", 1},
+    {"muduo_loop_stall_seconds_total", "Time spent in stalled callbacks, as observed by the watchdog.", 1e-9},
+};
+
+struct SummaryFamily
+{
+    const char *name;
+    const char *help;
+    double scale;
+};
+
+static const SummaryFamily kSummaries[] = {
+    {"muduo_loop_iteration_seconds", "Time per loop iteration spent on events and callbacks, excluding epoll_wait.", 1e-9},
+    {"muduo_loop_functor_queue_depth", "Functors taken per doPendingFunctors call.", 1},
+    {"muduo_loop_poll_batch_size", "Active channels per epoll_wait return.", 1},
+    {"muduo_loop_stall_duration_seconds", "Duration of each stalled callback.", 1e-9},
+};
+
+static const double kQuantiles[] = {0.5, 0.9, 0.99, 0.999};
+
+static void snapshotHistogram(const Histogram &h, int64_t *out)
+{
+    for(int i = 0; i < 4; ++i)
+    {
+        out[i] = h.percentile(kQuantiles[i] * 100);
+    }
+    out[4] = h.sum();
+    out[5] = h.count();
+}
+
+static LoopSnapshot snapshotLoop(EventLoop *loop)
+{
+    const LoopMetrics &m = loop->metrics();
+    LoopSnapshot s;
+    s.tid = loop->threadId();
+    s.counters[0] = m.pollWakeups.load(std::memory_order_relaxed);
+    s.counters[1] = m.eventsDispatched.load(std::memory_order_relaxed);
+    s.counters[2] = m.functorsRun.load(std::memory_order_relaxed);
+    s.counters[3] = m.pollNanos.load(std::memory_order_relaxed);
+    s.counters[4] = m.callbackNanos.load(std::memory_order_relaxed);
+    s.counters[5] = m.connectionsAccepted.load(std::memory_order_relaxed);
+    s.counters[6] = m.connectionsEstablished.load(std::memory_order_relaxed);
+    s.counters[7] = m.connectionsClosed.load(std::memory_order_relaxed);
+    s.counters[8] = m.bytesRead.load(std::memory_order_relaxed);
+    s.counters[9] = m.bytesWritten.load(std::memory_order_relaxed);
+    s.counters[10] = m.stalls.load(std::memory_order_relaxed);
+    s.counters[11] = m.stallNanos.load(std::memory_order_relaxed);
+    s.bufferedBytes = loop->bufferedBytes();
+    snapshotHistogram(m.iterationNanos, s.histograms[0]);
+    snapshotHistogram(m.functorQueueDepth, s.histograms[1]);
+    snapshotHistogram(m.pollBatchSize, s.histograms[2]);
+    snapshotHistogram(m.stallDuration, s.histograms[3]);
+    s.perfEnabled = m.perfEnabled.load(std::memory_order_relaxed);
+    for(int p = 0; p < LoopMetrics::kNumPerfPhases; ++p)
+    {
+        for(int c = 0; c < PerfCounters::kNumCounters; ++c)
+        {
+            s.perf[p][c] = m.perf[p][c].load(std::memory_order_relaxed);
+        }
+    }
+    return s;
+}
+
+static void appendf(std::string *out, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void appendf(std::string *out, const char *fmt, ...)
+{
+    char buf[512];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(buf, sizeof buf, fmt, args);
+    va_end(args);
+    if(n > 0)
+    {
+        out->append(buf, static_cast<size_t>(n) < sizeof buf ? n : sizeof buf - 1);
+    }
+}
+
+static void appendValue(std::string *out, int64_t value, double scale)
+{
+    if(scale == 1)
+    {
+        appendf(out, "%ld\n", static_cast<long>(value));
+    }
+    else
+    {
+        appendf(out, "%.9g\n", value * scale);
+    }
+}
+
+//硬件计数器：按阶段的累计值，每个阶段的IPC，平均每个事件的计数；只导出打开了计数器的loop
+static void appendPerf(std::string *out, const std::vector<LoopSnapshot> &loops)
+{
+    for(int c = 0; c < PerfCounters::kNumCounters; ++c)
+    {
+        const char *name = PerfCounters::name(static_cast<PerfCounters::Counter>(c));
+        appendf(out, "# HELP muduo_loop_perf_%s_total Hardware %s counted on the loop thread, by loop phase.\n"
+                    "# TYPE muduo_loop_perf_%s_total counter\n", name, name, name);
+        for(const LoopSnapshot &s : loops)
+        {
+            for(int p = 0; s.perfEnabled && p < LoopMetrics::kNumPerfPhases; ++p)
+            {
+                appendf(out, "muduo_loop_perf_%s_total{tid=\"%d\",phase=\"%s\"} %ld\n",
+                    name, s.tid, LoopMetrics::perfPhaseName(p), static_cast<long>(s.perf[p][c]));
+            }
+        }
+    }
+
+    appendf(out, "# HELP muduo_loop_perf_ipc Instructions per cycle since the counters were opened, by loop phase.\n"
+                "# TYPE muduo_loop_perf_ipc gauge\n");
+    for(const LoopSnapshot &s : loops)
+    {
+        for(int p = 0; s.perfEnabled && p < LoopMetrics::kNumPerfPhases; ++p)
+        {
+            int64_t cycles = s.perf[p][PerfCounters::kCycles];
+            appendf(out, "muduo_loop_perf_ipc{tid=\"%d\",phase=\"%s\"} %.4g\n", s.tid, LoopMetrics::perfPhaseName(p),
+                cycles > 0 ? static_cast<double>(s.perf[p][PerfCounters::kInstructions]) / cycles : 0.0);
+        }
+    }
+
+    //counters[1]是分发的活跃channel数
+    for(int c = 0; c < PerfCounters::kNumCounters; ++c)
+    {
+        const char *name = PerfCounters::name(static_cast<PerfCounters::Counter>(c));
+        appendf(out, "# HELP muduo_loop_perf_%s_per_event Hardware %s per dispatched event, all phases.\n"
+                    "# TYPE muduo_loop_perf_%s_per_event gauge\n", name, name, name);
+        for(const LoopSnapshot &s : loops)
+        {
+            if(!s.perfEnabled)
+            {
+                continue;
+            }
+            int64_t total = 0;
+            for(int p = 0; p < LoopMetrics::kNumPerfPhases; ++p)
+            {
+                total += s.perf[p][c];
+            }
+            appendf(out, "muduo_loop_perf_%s_per_event{tid=\"%d\"} %.6g\n", name, s.tid,
+                s.counters[1] > 0 ? static_cast<double>(total) / s.counters[1] : 0.0);
+        }
+    }
+}
+
+//计算线程池：队列深度、任务数、偷取次数，排队时间和执行时间的分位数；按pool名字打标签
+struct PoolSnapshot
+{
+    std::string name;
+    int64_t counters[3]; //submitted completed steals
+    int64_t queued;
+    int64_t histograms[2][6]; //排队时间、执行时间
+};
+
+static void appendComputePools(std::string *out)
+{
+    std::vector<PoolSnapshot> pools;
+    ComputePool::forEachPool([&pools](const ComputePool &pool) {
+        PoolSnapshot s;
+        s.name = pool.name();
+        s.counters[0] = pool.submitted();
+        s.counters[1] = pool.completed();
+        s.counters[2] = pool.steals();
+        s.queued = pool.queued();
+        std::unique_ptr<Histogram> h(new Histogram);
+        pool.mergeQueueLatency(h.get());
+        snapshotHistogram(*h, s.histograms[0]);
+        h->reset();
+        pool.mergeRunTime(h.get());
+        snapshotHistogram(*h, s.histograms[1]);
+        pools.push_back(s);
+    });
+    if(pools.empty())
+    {
+        return;
+    }
+
+    static const CounterFamily kPoolCounters[] = {
+        {"muduo_compute_tasks_submitted_total", "Tasks submitted to the compute pool.", 1},
+        {"muduo_compute_tasks_completed_total", "Tasks run to completion by the compute pool.", 1},
+        {"muduo_compute_steals_total", "Tasks a worker took from another worker's deque.", 1},
+    };
+    for(size_t c = 0; c < sizeof kPoolCounters / sizeof kPoolCounters[0]; ++c)
+    {
+        appendf(out, "# HELP %s %s\n# TYPE %s counter\n", kPoolCounters[c].name, kPoolCounters[c].help, kPoolCounters[c].name);
+        for(const PoolSnapshot &s : pools)
+        {
+            appendf(out, "%s{pool=\"%s\"} %ld\n", kPoolCounters[c].name, s.name.c_str(), static_cast<long>(s.counters[c]));
+        }
+    }
+    appendf(out, "# HELP muduo_compute_queue_depth Tasks waiting in the compute pool's deques.\n"
+                "# TYPE muduo_compute_queue_depth gauge\n");
+    for(const PoolSnapshot &s : pools)
+    {
+        appendf(out, "muduo_compute_queue_depth{pool=\"%s\"} %ld\n", s.name.c_str(), static_cast<long>(s.queued));
+    }
+
+    static const SummaryFamily kPoolSummaries[] = {
+        {"muduo_compute_queue_seconds", "Time from submit until a worker started the task.", 1e-9},
+        {"muduo_compute_run_seconds", "Time a worker spent running the task.", 1e-9},
+    };
+    for(size_t h = 0; h < sizeof kPoolSummaries / sizeof kPoolSummaries[0]; ++h)
+    {
+        const SummaryFamily &f = kPoolSummaries[h];
+        appendf(out, "# HELP %s %s\n# TYPE %s summary\n", f.name, f.help, f.name);
+        for(const PoolSnapshot &s : pools)
+        {
+            for(int q = 0; q < 4; ++q)
+            {
+                appendf(out, "%s{pool=\"%s\",quantile=\"%g\"} ", f.name, s.name.c_str(), kQuantiles[q]);
+                appendValue(out, s.histograms[h][q], f.scale);
+            }
+            appendf(out, "%s_sum{pool=\"%s\"} ", f.name, s.name.c_str());
+            appendValue(out, s.histograms[h][4], f.scale);
+            appendf(out, "%s_count{pool=\"%s\"} %ld\n", f.name, s.name.c_str(), static_cast<long>(s.histograms[h][5]));
+        }
+    }
+}
+
+//默认的管理接口，找不到path返回404
+static void notFound(HttpResponse *resp)
+{
+    resp->setStatusCode(HttpResponse::k404NotFound);
+    resp->setStatusMessage("Not Found");
+    resp->setContentType("text/plain");
+    resp->setBody("not found\n");
+}
+
+//从查询串里取一个整数参数，比如hz=99，没有时返回defaultValue
+static int queryInt(const HttpRequest &req, const char *key, int defaultValue)
+{
+    std::string query = req.query().toString();
+    size_t keyLen = strlen(key);
+    size_t pos = 0;
+    while(pos < query.size())
+    {
+        size_t end = query.find('&', pos);
+        if(end == std::string::npos)
+        {
+            end = query.size();
+        }
+        if(end - pos > keyLen && query.compare(pos, keyLen, key) == 0 && query[pos + keyLen] == '=')
+        {
+            return atoi(query.c_str() + pos + keyLen + 1);
+        }
+        pos = end + 1;
+    }
+    return defaultValue;
+}
+
+static void okText(HttpResponse *resp, const std::string &body)
+{
+    resp->setStatusCode(HttpResponse::k200Ok);
+    resp->setStatusMessage("OK");
+    resp->setContentType("text/plain");
+    resp->setBody(body);
+}
+
+MetricsServer::MetricsServer(EventLoop *loop, const InetAddress &listenAddr, const std::string &name)
+    : server_(loop, listenAddr, name)
+{
+    server_.setHttpCallback(
+        std::bind(&MetricsServer::onRequest,this,std::placeholders::_1,std::placeholders::_2));
+    handlers_["/metrics"] = [](const HttpRequest&, HttpResponse *resp) {
+        resp->setStatusCode(HttpResponse::k200Ok);
+        resp->setStatusMessage("OK");
+        resp->setContentType("text/plain; version=0.0.4");
+        resp->setBody(MetricsServer::prometheusText());
+    };
+    //事件循环的时间线：/trace/start开始记录，/trace导出Chrome trace json，/trace/stop停止
+    handlers_["/trace/start"] = [](const HttpRequest&, HttpResponse *resp) {
+        Tracer::enable();
+        okText(resp, "tracing enabled\n");
+    };
+    handlers_["/trace/stop"] = [](const HttpRequest&, HttpResponse *resp) {
+        Tracer::disable();
+        okText(resp, "tracing disabled\n");
+    };
+    handlers_["/trace"] = [](const HttpRequest&, HttpResponse *resp) {
+        resp->setStatusCode(HttpResponse::k200Ok);
+        resp->setStatusMessage("OK");
+        resp->setContentType("application/json");
+        resp->setBody(Tracer::dumpJson());
+    };
+    //CPU采样：/profile/start?hz=99开始，/profile导出folded格式（flamegraph.pl可以直接读），/profile/stop停止
+    handlers_["/profile/start"] = [](const HttpRequest &req, HttpResponse *resp) {
+        int hz = queryInt(req, "hz", 99);
+        okText(resp, Profiler::start(hz) ? "profiling started\n" : "profiler already running\n");
+    };
+    handlers_["/profile/stop"] = [](const HttpRequest&, HttpResponse *resp) {
+        Profiler::stop();
+        okText(resp, "profiling stopped\n");
+    };
+    handlers_["/profile"] = [](const HttpRequest&, HttpResponse *resp) {
+        okText(resp, Profiler::foldedStacks());
+    };
+}
+
+void MetricsServer::addHandler(const std::string &path, const Handler &handler)
+{
+    handlers_[path] = handler;
+}
+
+void MetricsServer::start()
+{
+    server_.start();
+}
+
+void MetricsServer::onRequest(const HttpRequest &req, HttpResponse *resp)
+{
+    auto it = handlers_.find(req.path().toString());
+    if(it == handlers_.end())
+    {
+        notFound(resp);
+        return;
+    }
+    it->second(req, resp);
+}
+
+std::string MetricsServer::prometheusText()
+{
+    std::vector<LoopSnapshot> loops;
+    LoopMetrics::forEachLoop([&loops](EventLoop *loop) {
+        loops.push_back(snapshotLoop(loop));
+    });
+
+    std::string out;
+    out.reserve(4096);
+    for(size_t c = 0; c < sizeof kCounters / sizeof kCounters[0]; ++c)
+    {
+        appendf(&out, "# HELP %s %s\n# TYPE %s counter\n", kCounters[c].name, kCounters[c].help, kCounters[c].name);
+        for(const LoopSnapshot &s : loops)
+        {
+            appendf(&out, "%s{tid=\"%d\"} ", kCounters[c].name, s.tid);
+            appendValue(&out, s.counters[c], kCounters[c].scale);
+        }
+    }
+
+    appendf(&out, "# HELP muduo_loop_buffered_bytes Memory allocated for connection buffers on this loop.\n"
+                "# TYPE muduo_loop_buffered_bytes gauge\n");
+    for(const LoopSnapshot &s : loops)
+    {
+        appendf(&out, "muduo_loop_buffered_bytes{tid=\"%d\"} %ld\n", s.tid, static_cast<long>(s.bufferedBytes));
+    }
+    appendf(&out, "# HELP muduo_buffered_bytes Memory allocated for connection buffers in the whole process.\n"
+                "# TYPE muduo_buffered_bytes gauge\n"
+                "muduo_buffered_bytes %ld\n", static_cast<long>(MemoryBudget::totalBytes()));
+
+    for(size_t h = 0; h < sizeof kSummaries / sizeof kSummaries[0]; ++h)
+    {
+        const SummaryFamily &f = kSummaries[h];
+        appendf(&out, "# HELP %s %s\n# TYPE %s summary\n", f.name, f.help, f.name);
+        for(const LoopSnapshot &s : loops)
+        {
+            for(int q = 0; q < 4; ++q)
+            {
+                appendf(&out, "%s{tid=\"%d\",quantile=\"%g\"} ", f.name, s.tid, kQuantiles[q]);
+                appendValue(&out, s.histograms[h][q], f.scale);
+            }
+            appendf(&out, "%s_sum{tid=\"%d\"} ", f.name, s.tid);
+            appendValue(&out, s.histograms[h][4], f.scale);
+            appendf(&out, "%s_count{tid=\"%d\"} %ld\n", f.name, s.tid, static_cast<long>(s.histograms[h][5]));
+        }
+    }
+
+    appendPerf(&out, loops);
+    appendComputePools(&out);
+    return out;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "HttpServer.h"
+#include "noncopyable.h"
+
+#include <map>
+#include <string>
+#include <functional>
+
+/**
+ * 管理端口：基于HttpServer，GET /metrics 返回所有EventLoop指标的Prometheus文本格式，
+ * /trace/start、/trace/stop、/trace 控制和导出事件循环的时间线（Chrome trace json），
+ * /profile/start?hz=N、/profile/stop、/profile 控制和导出CPU采样（folded格式）
+ * 可以用addHandler挂别的管理接口；一般放在base loop或者单独的EventLoopThread上
+*/
+class MetricsServer : noncopyable
+{
+public:
+    using Handler = HttpServer::HttpCallback;
+
+    MetricsServer(EventLoop *loop,
+                const InetAddress &listenAddr,
+                const std::string &name = "MetricsServer");
+
+    //按path精确匹配，需要在start之前调用
+    void addHandler(const std::string &path, const Handler &handler);
+
+    void start();
+
+    //遍历所有活着的EventLoop，生成Prometheus文本，可以在任意线程调用
+    static std::string prometheusText();
+
+private:
+    void onRequest(const HttpRequest &req, HttpResponse *resp);
+
+    HttpServer server_;
+    std::map<std::string, Handler> handlers_;
+};
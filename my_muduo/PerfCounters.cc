@@ -0,0 +1,136 @@
+#include "PerfCounters.h"
+#include "logger.h"
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <atomic>
+
+static const uint64_t kConfigs[PerfCounters::kNumCounters] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES,
+};
+
+static const char *kNames[PerfCounters::kNumCounters] = {
+    "cycles",
+    "instructions",
+    "cache_misses",
+    "branch_misses",
+};
+
+static bool initEnabled()
+{
+    const char *env = ::getenv("MUDUO_PERF_COUNTERS");
+    return env && env[0] != '\0' && strcmp(env, "0") != 0;
+}
+
+static std::atomic_bool g_enabledForLoops(initEnabled());
+
+//打不开只在第一次打一条日志，之后每个loop线程都会失败，不用重复报
+static std::atomic_bool g_warned(false);
+
+static int perfEventOpen(uint64_t config, int groupFd)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof attr);
+    attr.size = sizeof attr;
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    //组长先停着，整组打开以后一起开始计数
+    attr.disabled = groupFd < 0 ? 1 : 0;
+    return static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, PERF_FLAG_FD_CLOEXEC));
+}
+
+PerfCounters::PerfCounters()
+    : leaderFd_(-1)
+    , numOpened_(0)
+{
+    for(int i = 0; i < kNumCounters; ++i)
+    {
+        fds_[i] = -1;
+        order_[i] = -1;
+    }
+}
+
+PerfCounters::~PerfCounters()
+{
+    for(int i = 0; i < kNumCounters; ++i)
+    {
+        if(fds_[i] >= 0)
+        {
+            ::close(fds_[i]);
+        }
+    }
+}
+
+bool PerfCounters::open()
+{
+    int lastErrno = 0;
+    for(int i = 0; i < kNumCounters; ++i)
+    {
+        int fd = perfEventOpen(kConfigs[i], leaderFd_);
+        if(fd < 0)
+        {
+            lastErrno = errno;
+            continue;
+        }
+        if(leaderFd_ < 0)
+        {
+            leaderFd_ = fd;
+        }
+        fds_[i] = fd;
+        order_[numOpened_++] = i;
+    }
+
+    if(leaderFd_ < 0)
+    {
+        if(!g_warned.exchange(true))
+        {
+            LOG_ERROR("PerfCounters unavailable, perf_event_open errno:%d \n", lastErrno);
+        }
+        return false;
+    }
+    ::ioctl(leaderFd_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ::ioctl(leaderFd_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return true;
+}
+
+bool PerfCounters::read(Values *values) const
+{
+    //PERF_FORMAT_GROUP的格式：{ nr, value[nr] }
+    uint64_t buf[1 + kNumCounters];
+    ssize_t n = ::read(leaderFd_, buf, sizeof buf);
+    if(n < static_cast<ssize_t>(sizeof(uint64_t)) || static_cast<int>(buf[0]) != numOpened_)
+    {
+        return false;
+    }
+    for(int i = 0; i < numOpened_; ++i)
+    {
+        values->v[order_[i]] = static_cast<int64_t>(buf[1 + i]);
+    }
+    return true;
+}
+
+const char* PerfCounters::name(Counter c)
+{
+    return kNames[c];
+}
+
+void PerfCounters::setEnabledForLoops(bool on)
+{
+    g_enabledForLoops.store(on, std::memory_order_relaxed);
+}
+
+bool PerfCounters::enabledForLoops()
+{
+    return g_enabledForLoops.load(std::memory_order_relaxed);
+}
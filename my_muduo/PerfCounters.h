@@ -0,0 +1,53 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <stdint.h>
+
+/**
+ * 当前线程的硬件性能计数器，基于perf_event_open
+ * 几个计数器开成一组，一次read系统调用读出全部；内核不支持、权限不够或者在虚拟机里拿不到某个计数器时
+ * 只是少了那一项，一个都打不开时open返回false，调用者就当没有计数器
+ * 只统计用户态(exclude_kernel)，perf_event_paranoid=2的机器上普通用户也能打开
+*/
+class PerfCounters : noncopyable
+{
+public:
+    enum Counter
+    {
+        kCycles,
+        kInstructions,
+        kCacheMisses,
+        kBranchMisses,
+        kNumCounters,
+    };
+
+    struct Values
+    {
+        Values() : v() {}
+        int64_t v[kNumCounters]; //打不开的计数器一直是0
+    };
+
+    PerfCounters();
+    ~PerfCounters();
+
+    //给调用线程打开计数器并开始计数，至少打开一个返回true
+    bool open();
+    bool valid() const { return leaderFd_ >= 0; }
+    bool available(Counter c) const { return fds_[c] >= 0; }
+
+    //读出从open开始的累计值
+    bool read(Values *values) const;
+
+    static const char* name(Counter c);
+
+    //EventLoop::loop开始时是否自动打开计数器，默认看环境变量MUDUO_PERF_COUNTERS
+    static void setEnabledForLoops(bool on);
+    static bool enabledForLoops();
+
+private:
+    int leaderFd_;
+    int fds_[kNumCounters];
+    int order_[kNumCounters]; //分组读出来的第i个值是哪个计数器
+    int numOpened_;
+};
@@ -0,0 +1,455 @@
+#include "PreforkSupervisor.h"
+#include "LoopMetrics.h"
+#include "EventLoop.h"
+#include "Thread.h"
+#include "logger.h"
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <atomic>
+
+//每个worker一条，worker的采样线程写，supervisor读；seqlock和StatsShmLayout.h一样
+struct PreforkSupervisor::Slot
+{
+    std::atomic<uint64_t> seq;
+    std::atomic<int64_t> connectionsAccepted;
+    std::atomic<int64_t> activeConnections;
+    std::atomic<int64_t> bytesRead;
+    std::atomic<int64_t> bytesWritten;
+    std::atomic<int64_t> eventsDispatched;
+    std::atomic<int64_t> callbackNanos;
+    std::atomic<int64_t> stalls;
+};
+
+static const int64_t kNanosPerSecond = 1000 * 1000 * 1000;
+//启动不到这么久就退出算崩溃风暴，重启的间隔从kMinBackoff开始翻倍，最多kMaxBackoff
+static const int64_t kCrashLoopNanos = kNanosPerSecond;
+static const int64_t kMinBackoffNanos = kNanosPerSecond / 10;
+static const int64_t kMaxBackoffNanos = 30 * kNanosPerSecond;
+
+static int s_workerIndex = -1;
+
+static int64_t monotonicNanos()
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * kNanosPerSecond + ts.tv_nsec;
+}
+
+static int64_t get(const std::atomic<int64_t> &field)
+{
+    return field.load(std::memory_order_relaxed);
+}
+
+//seqlock读重试：先空转几次，再让出cpu，最后短暂睡眠，写的一方只是几条store
+static void backoff(int retry)
+{
+    if(retry < 10)
+    {
+        return;
+    }
+    if(retry < 50)
+    {
+        ::sched_yield();
+        return;
+    }
+    struct timespec ts = { 0, 100 * 1000 };
+    ::nanosleep(&ts, nullptr);
+}
+
+static void set(std::atomic<int64_t> &field, int64_t value)
+{
+    field.store(value, std::memory_order_relaxed);
+}
+
+PreforkSupervisor::PreforkSupervisor(const InetAddress &listenAddr, int numWorkers)
+    : listenAddr_(listenAddr)
+    , numWorkers_(numWorkers > 0 ? numWorkers : 1)
+    , bindFd_(-1)
+    , cpuAffinity_(false)
+    , statsInterval_(1.0)
+    , shutdownTimeout_(10.0)
+    , workers_(numWorkers_)
+    , slots_(nullptr)
+{
+    if(listenAddr.isUnix())
+    {
+        LOG_FATAL("PreforkSupervisor needs an inet address for SO_REUSEPORT, got %s \n", listenAddr.toIpPort().c_str());
+    }
+    //先占住端口，端口被占用马上就能发现；这个socket不listen，不会分到连接
+    bindFd_ = ::socket(listenAddr.family(), SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int on = 1;
+    ::setsockopt(bindFd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof on);
+    ::setsockopt(bindFd_, SOL_SOCKET, SO_REUSEPORT, &on, sizeof on);
+    if(bindFd_ < 0 || ::bind(bindFd_, listenAddr.getSockAddr(), listenAddr.getSockAddrLen()) < 0)
+    {
+        LOG_FATAL("PreforkSupervisor bind %s fail, errno:%d \n", listenAddr.toIpPort().c_str(), errno);
+    }
+    listenAddr_ = InetAddress::getLocalAddr(bindFd_);
+
+    //fork之前映射，worker和supervisor看到的是同一块内存
+    size_t bytes = sizeof(Slot) * numWorkers_;
+    void *addr = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if(addr == MAP_FAILED)
+    {
+        LOG_FATAL("PreforkSupervisor mmap stats error:%d \n", errno);
+    }
+    slots_ = static_cast<Slot*>(addr); //匿名映射全是0
+
+    for(Worker &w : workers_)
+    {
+        memset(&w, 0, sizeof w);
+    }
+
+    //worker可以用的cpu，按supervisor自己的affinity来
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if(::sched_getaffinity(0, sizeof set, &set) == 0)
+    {
+        for(int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        {
+            if(CPU_ISSET(cpu, &set))
+            {
+                cpus_.push_back(cpu);
+            }
+        }
+    }
+}
+
+PreforkSupervisor::~PreforkSupervisor()
+{
+    ::munmap(slots_, sizeof(Slot) * numWorkers_);
+    ::close(bindFd_);
+}
+
+int PreforkSupervisor::workerIndex()
+{
+    return s_workerIndex;
+}
+
+int PreforkSupervisor::run(const WorkerFunc &worker)
+{
+    worker_ = worker;
+
+    //SIGCHLD/SIGTERM/SIGINT都阻塞住，用sigtimedwait同步处理，不需要异步信号处理函数
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGINT);
+    ::pthread_sigmask(SIG_BLOCK, &mask, &oldMask_);
+
+    LOG_INFO("PreforkSupervisor starting %d workers on %s \n", numWorkers_, listenAddr_.toIpPort().c_str());
+    for(int i = 0; i < numWorkers_; ++i)
+    {
+        spawn(i);
+    }
+
+    int64_t nextReport = monotonicNanos() + static_cast<int64_t>(statsInterval_ * kNanosPerSecond);
+    for(;;)
+    {
+        //最多睡到下一次汇总或者下一个worker该重启的时候
+        int64_t now = monotonicNanos();
+        int64_t wakeAt = statsCallback_ ? nextReport : now + kNanosPerSecond;
+        for(const Worker &w : workers_)
+        {
+            if(w.restartAtNanos > 0)
+            {
+                wakeAt = std::min(wakeAt, w.restartAtNanos);
+            }
+        }
+        int64_t waitNanos = std::max<int64_t>(wakeAt - now, 1000 * 1000);
+        struct timespec timeout;
+        timeout.tv_sec = waitNanos / kNanosPerSecond;
+        timeout.tv_nsec = waitNanos % kNanosPerSecond;
+
+        int sig = ::sigtimedwait(&mask, nullptr, &timeout);
+        if(sig == SIGTERM || sig == SIGINT)
+        {
+            LOG_INFO("PreforkSupervisor got signal %d, stopping workers \n", sig);
+            shutdown();
+            break;
+        }
+        reapChildren();
+        restartDue();
+        if(statsCallback_ && monotonicNanos() >= nextReport)
+        {
+            reportStats();
+            nextReport += static_cast<int64_t>(statsInterval_ * kNanosPerSecond);
+        }
+    }
+
+    ::pthread_sigmask(SIG_SETMASK, &oldMask_, nullptr);
+    return 0;
+}
+
+void PreforkSupervisor::spawn(int index)
+{
+    Worker &w = workers_[index];
+    pid_t pid = ::fork();
+    if(pid < 0)
+    {
+        //fork失败当成一次立即退出，按退避的间隔再试
+        LOG_ERROR("PreforkSupervisor fork worker %d error:%d \n", index, errno);
+        w.backoffNanos = std::min(std::max(w.backoffNanos * 2, kMinBackoffNanos), kMaxBackoffNanos);
+        w.restartAtNanos = monotonicNanos() + w.backoffNanos;
+        return;
+    }
+    if(pid == 0)
+    {
+        runWorker(index); //不会返回
+    }
+    w.pid = pid;
+    w.startNanos = monotonicNanos();
+    w.restartAtNanos = 0;
+    LOG_INFO("PreforkSupervisor worker %d started, pid %d \n", index, pid);
+}
+
+void PreforkSupervisor::runWorker(int index)
+{
+    s_workerIndex = index;
+    ::pthread_sigmask(SIG_SETMASK, &oldMask_, nullptr);
+    ::prctl(PR_SET_PDEATHSIG, SIGTERM); //supervisor没了worker也跟着退出
+    ::close(bindFd_);
+
+    if(cpuAffinity_ && !cpus_.empty())
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpus_[index % cpus_.size()], &set);
+        if(::sched_setaffinity(0, sizeof set, &set) < 0)
+        {
+            LOG_ERROR("PreforkSupervisor worker %d sched_setaffinity error:%d \n", index, errno);
+        }
+    }
+
+    //采样线程：定期把这个进程里所有loop和server的计数器加起来写进自己的slot
+    if(statsCallback_)
+    {
+        Slot *slot = &slots_[index];
+        useconds_t interval = static_cast<useconds_t>(statsInterval_ * 1000 * 1000 / 2);
+        Thread *sampler = new Thread([slot, interval]() {
+            for(;;)
+            {
+                ::usleep(interval);
+                int64_t events = 0, callbackNanos = 0, bytesRead = 0, bytesWritten = 0, stalls = 0;
+                LoopMetrics::forEachLoop([&](EventLoop *loop) {
+                    const LoopMetrics &m = loop->metrics();
+                    events += get(m.eventsDispatched);
+                    callbackNanos += get(m.callbackNanos);
+                    bytesRead += get(m.bytesRead);
+                    bytesWritten += get(m.bytesWritten);
+                    stalls += get(m.stalls);
+                });
+                int64_t accepted = 0, active = 0;
+                ServerMetrics::forEachServer([&](const ServerMetrics &m) {
+                    accepted += get(m.connectionsAccepted);
+                    active += get(m.activeConnections);
+                });
+
+                uint64_t s = slot->seq.load(std::memory_order_relaxed) + 1;
+                slot->seq.store(s, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_release);
+                set(slot->connectionsAccepted, accepted);
+                set(slot->activeConnections, active);
+                set(slot->bytesRead, bytesRead);
+                set(slot->bytesWritten, bytesWritten);
+                set(slot->eventsDispatched, events);
+                set(slot->callbackNanos, callbackNanos);
+                set(slot->stalls, stalls);
+                slot->seq.store(s + 1, std::memory_order_release);
+            }
+        }, "PreforkStats");
+        sampler->start();
+    }
+
+    worker_(index);
+    //采样线程还在跑，不走exit的静态析构
+    ::_exit(0);
+}
+
+void PreforkSupervisor::reapChildren()
+{
+    int status;
+    pid_t pid;
+    while((pid = ::waitpid(-1, &status, WNOHANG)) > 0)
+    {
+        auto it = std::find_if(workers_.begin(), workers_.end(), [pid](const Worker &w) { return w.pid == pid; });
+        if(it == workers_.end())
+        {
+            continue;
+        }
+        Worker &w = *it;
+        int index = static_cast<int>(it - workers_.begin());
+        w.pid = 0;
+
+        //进程没了，最后一次采样的累计值并到carried里，slot清零给下一个进程用
+        Slot &slot = slots_[index];
+        w.carried.connectionsAccepted += get(slot.connectionsAccepted);
+        w.carried.bytesRead += get(slot.bytesRead);
+        w.carried.bytesWritten += get(slot.bytesWritten);
+        w.carried.eventsDispatched += get(slot.eventsDispatched);
+        w.carried.callbackNanos += get(slot.callbackNanos);
+        w.carried.stalls += get(slot.stalls);
+        //进程可能死在写到一半，seq停在奇数上，先补成偶数，否则清零以后seq一直是奇数，之后的读写都反了
+        uint64_t s = (slot.seq.load(std::memory_order_relaxed) + 1) & ~static_cast<uint64_t>(1);
+        slot.seq.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        set(slot.connectionsAccepted, 0);
+        set(slot.activeConnections, 0);
+        set(slot.bytesRead, 0);
+        set(slot.bytesWritten, 0);
+        set(slot.eventsDispatched, 0);
+        set(slot.callbackNanos, 0);
+        set(slot.stalls, 0);
+        slot.seq.store(s + 2, std::memory_order_release);
+        memset(&w.sampled, 0, sizeof w.sampled);
+
+        if(WIFEXITED(status) && WEXITSTATUS(status) == 0)
+        {
+            LOG_INFO("PreforkSupervisor worker %d pid %d exited normally \n", index, pid);
+            continue;
+        }
+        if(WIFSIGNALED(status))
+        {
+            LOG_ERROR("PreforkSupervisor worker %d pid %d killed by signal %d \n", index, pid, WTERMSIG(status));
+        }
+        else
+        {
+            LOG_ERROR("PreforkSupervisor worker %d pid %d exited with status %d \n", index, pid, WEXITSTATUS(status));
+        }
+
+        //跑了一阵子才退出的马上重启，刚启动就退出的按指数退避
+        int64_t now = monotonicNanos();
+        if(now - w.startNanos < kCrashLoopNanos)
+        {
+            w.backoffNanos = std::min(std::max(w.backoffNanos * 2, kMinBackoffNanos), kMaxBackoffNanos);
+        }
+        else
+        {
+            w.backoffNanos = 0;
+        }
+        w.restartAtNanos = now + w.backoffNanos;
+        if(w.backoffNanos > 0)
+        {
+            LOG_ERROR("PreforkSupervisor worker %d restarting in %.1fs \n", index, w.backoffNanos / 1e9);
+        }
+    }
+}
+
+void PreforkSupervisor::restartDue()
+{
+    int64_t now = monotonicNanos();
+    for(int i = 0; i < numWorkers_; ++i)
+    {
+        Worker &w = workers_[i];
+        if(w.pid == 0 && w.restartAtNanos > 0 && w.restartAtNanos <= now)
+        {
+            ++w.restarts;
+            spawn(i);
+        }
+    }
+}
+
+void PreforkSupervisor::shutdown()
+{
+    for(Worker &w : workers_)
+    {
+        w.restartAtNanos = 0;
+        if(w.pid > 0)
+        {
+            ::kill(w.pid, SIGTERM);
+        }
+    }
+
+    int64_t deadline = monotonicNanos() + static_cast<int64_t>(shutdownTimeout_ * kNanosPerSecond);
+    for(;;)
+    {
+        int status;
+        pid_t pid;
+        while((pid = ::waitpid(-1, &status, WNOHANG)) > 0)
+        {
+            for(Worker &w : workers_)
+            {
+                if(w.pid == pid)
+                {
+                    w.pid = 0;
+                }
+            }
+        }
+        bool running = std::any_of(workers_.begin(), workers_.end(), [](const Worker &w) { return w.pid > 0; });
+        if(!running)
+        {
+            break;
+        }
+        if(monotonicNanos() >= deadline)
+        {
+            for(Worker &w : workers_)
+            {
+                if(w.pid > 0)
+                {
+                    LOG_ERROR("PreforkSupervisor worker pid %d did not exit in time, killing \n", w.pid);
+                    ::kill(w.pid, SIGKILL);
+                    ::waitpid(w.pid, &status, 0);
+                    w.pid = 0;
+                }
+            }
+            break;
+        }
+        ::usleep(10 * 1000);
+    }
+    LOG_INFO("PreforkSupervisor all workers stopped \n");
+}
+
+void PreforkSupervisor::reportStats()
+{
+    std::vector<WorkerStats> stats(numWorkers_);
+    for(int i = 0; i < numWorkers_; ++i)
+    {
+        Worker &w = workers_[i];
+        const Slot &slot = slots_[i];
+        WorkerStats &out = stats[i];
+        //seqlock读，worker正在写就退避以后重读；一直读不到一致的值就沿用上一次的
+        for(int retry = 0; retry < 100; backoff(++retry))
+        {
+            uint64_t before = slot.seq.load(std::memory_order_acquire);
+            if(before & 1)
+            {
+                continue;
+            }
+            WorkerStats sample;
+            memset(&sample, 0, sizeof sample);
+            sample.connectionsAccepted = get(slot.connectionsAccepted);
+            sample.activeConnections = get(slot.activeConnections);
+            sample.bytesRead = get(slot.bytesRead);
+            sample.bytesWritten = get(slot.bytesWritten);
+            sample.eventsDispatched = get(slot.eventsDispatched);
+            sample.callbackNanos = get(slot.callbackNanos);
+            sample.stalls = get(slot.stalls);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if(slot.seq.load(std::memory_order_relaxed) == before)
+            {
+                w.sampled = sample;
+                break;
+            }
+        }
+        out = w.sampled;
+        out.index = i;
+        out.pid = w.pid;
+        out.restarts = w.restarts;
+        out.connectionsAccepted += w.carried.connectionsAccepted;
+        out.bytesRead += w.carried.bytesRead;
+        out.bytesWritten += w.carried.bytesWritten;
+        out.eventsDispatched += w.carried.eventsDispatched;
+        out.callbackNanos += w.carried.callbackNanos;
+        out.stalls += w.carried.stalls;
+    }
+    statsCallback_(stats);
+}
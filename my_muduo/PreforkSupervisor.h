@@ -0,0 +1,103 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "InetAddress.h"
+
+#include <functional>
+#include <vector>
+#include <sys/types.h>
+#include <signal.h>
+#include <stdint.h>
+
+/**
+ * 多进程prefork模式：supervisor先按listenAddr绑定一个SO_REUSEPORT socket占住端口（不listen），
+ * 然后fork出numWorkers个worker进程，每个worker里运行用户的WorkerFunc：
+ * 自己的EventLoop、自己的 TcpServer(..., TcpServer::kReusePort)（内核在各个worker的监听socket之间分流），
+ * 可以再开subloop；进程之间什么都不共享，没有跨线程的分配器和锁竞争
+ *
+ * fork必须在创建任何EventLoop和线程之前，所以不是TcpServer的一个开关，而是包在main外面：
+ *     PreforkSupervisor supervisor(InetAddress(8000), 4);
+ *     return supervisor.run([&](int index) { EventLoop loop; TcpServer server(&loop, supervisor.listenAddress(), ...); ... loop.loop(); });
+ *
+ * supervisor：worker异常退出时重新fork（刚启动就退出的按指数退避，避免崩溃风暴）；
+ * 收到SIGTERM/SIGINT转发给所有worker，等它们退出（超时SIGKILL）以后run返回；
+ * 每个worker里有一个采样线程把LoopMetrics/ServerMetrics的总数写进fork之前映射的共享内存，
+ * supervisor定期汇总交给StatsCallback
+*/
+class PreforkSupervisor : noncopyable
+{
+public:
+    //worker进程里调用，index从0开始；返回以后worker进程退出（退出码0，不会被重启）
+    using WorkerFunc = std::function<void(int index)>;
+
+    struct WorkerStats
+    {
+        int index;
+        pid_t pid;          //0表示当前没有在运行（正在等待重启）
+        int restarts;
+        int64_t connectionsAccepted;
+        int64_t activeConnections;
+        int64_t bytesRead;
+        int64_t bytesWritten;
+        int64_t eventsDispatched;
+        int64_t callbackNanos;  //worker所有loop处理事件和回调的时间
+        int64_t stalls;
+    };
+    using StatsCallback = std::function<void(const std::vector<WorkerStats>&)>;
+
+    PreforkSupervisor(const InetAddress &listenAddr, int numWorkers);
+    ~PreforkSupervisor();
+
+    //worker i绑定到第 i % n 个可用的cpu上
+    void setCpuAffinity(bool on) { cpuAffinity_ = on; }
+    //每隔seconds秒在supervisor里调用一次cb，需要在run之前设置
+    void setStatsCallback(const StatsCallback &cb, double seconds = 1.0)
+    {
+        statsCallback_ = cb;
+        statsInterval_ = seconds;
+    }
+    //停止时等worker退出的时间，超时SIGKILL
+    void setShutdownTimeout(double seconds) { shutdownTimeout_ = seconds; }
+
+    //实际绑定的地址，listenAddr端口为0时是内核分配的端口；worker用它创建TcpServer
+    const InetAddress& listenAddress() const { return listenAddr_; }
+
+    //fork出worker并一直监督，收到SIGTERM/SIGINT以后返回0；只在supervisor里返回
+    int run(const WorkerFunc &worker);
+
+    //worker进程里是自己的index，supervisor进程里是-1
+    static int workerIndex();
+
+private:
+    struct Slot; //共享内存里每个worker一条统计记录
+    struct Worker
+    {
+        pid_t pid;
+        int restarts;
+        int64_t startNanos;
+        int64_t restartAtNanos; //>0表示等到这个时间重新fork
+        int64_t backoffNanos;
+        WorkerStats carried; //之前退出的进程留下的累计值，重启以后接着加
+        WorkerStats sampled; //上一次从slot读到的一致的值，读不到一致的值时用它
+    };
+
+    void spawn(int index);
+    void runWorker(int index);
+    void reapChildren();
+    void restartDue();
+    void shutdown();
+    void reportStats();
+
+    InetAddress listenAddr_;
+    const int numWorkers_;
+    int bindFd_;
+    bool cpuAffinity_;
+    StatsCallback statsCallback_;
+    double statsInterval_;
+    double shutdownTimeout_;
+    WorkerFunc worker_;
+    std::vector<Worker> workers_;
+    std::vector<int> cpus_;
+    Slot *slots_;
+    sigset_t oldMask_; //run之前的信号掩码，fork出来的worker恢复成这个
+};
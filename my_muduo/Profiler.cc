@@ -0,0 +1,383 @@
+#include "Profiler.h"
+#include "EventLoop.h"
+#include "LoopMetrics.h"
+#include "CurrentThread.h"
+#include "logger.h"
+
+#include <atomic>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <memory>
+#include <algorithm>
+#include <execinfo.h>
+#include <dlfcn.h>
+#include <cxxabi.h>
+#include <signal.h>
+#include <time.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+static const int kMaxDepth = 48;
+static const int kMaxThreads = 256;
+//信号处理函数和内核的信号跳板
+static const int kSkipFrames = 2;
+
+struct Sample
+{
+    const char *phase;
+    const char *activity;
+    int depth;
+    void *pcs[kMaxDepth];
+};
+
+/**
+ * 每个线程一个环形缓冲区，只有这个线程的信号处理函数写
+ * 和Tracer一样写完槽位再递增written，导出时读完再检查一次，被覆盖的槽位丢弃
+*/
+struct SampleBuffer
+{
+    explicit SampleBuffer(size_t capacity)
+        : samples(capacity)
+        , written(0)
+    {}
+
+    std::vector<Sample> samples;
+    std::atomic<uint64_t> written;
+};
+
+struct ThreadSlot
+{
+    ThreadSlot() : tid(0), buffer(nullptr), timerCreated(false) {}
+
+    std::atomic<int> tid; //0表示空槽位，信号处理函数按tid找自己的缓冲区
+    std::atomic<SampleBuffer*> buffer;
+    pthread_t thread;
+    std::string name;
+    timer_t timer;
+    bool timerCreated;
+};
+
+struct WorkerThread
+{
+    int tid;
+    pthread_t thread;
+    std::string name;
+};
+
+//g_mutex保护除了信号处理函数以外的所有访问
+static std::mutex g_mutex;
+static bool g_running = false;
+static bool g_handlerInstalled = false;
+static ThreadSlot g_slots[kMaxThreads];
+static std::atomic<int> g_slotCount(0);
+static std::vector<WorkerThread> g_workers;
+
+//不加锁不分配内存，只写本线程的缓冲区
+static void profHandler(int, siginfo_t*, void*)
+{
+    int savedErrno = errno;
+    int tid = static_cast<int>(::syscall(SYS_gettid));
+    int count = g_slotCount.load(std::memory_order_acquire);
+    for(int i = 0; i < count; ++i)
+    {
+        if(g_slots[i].tid.load(std::memory_order_relaxed) != tid)
+        {
+            continue;
+        }
+        SampleBuffer *buffer = g_slots[i].buffer.load(std::memory_order_acquire);
+        if(buffer)
+        {
+            uint64_t w = buffer->written.load(std::memory_order_relaxed);
+            Sample &sample = buffer->samples[w % buffer->samples.size()];
+            sample.phase = t_loopPhase;
+            sample.activity = t_loopActivity;
+            sample.depth = ::backtrace(sample.pcs, kMaxDepth);
+            buffer->written.store(w + 1, std::memory_order_release);
+        }
+        break;
+    }
+    errno = savedErrno;
+}
+
+//SIGPROF的默认动作是终止进程，装上以后就不再卸载，stop以后还在路上的信号也不会出问题
+static bool installHandler()
+{
+    if(g_handlerInstalled)
+    {
+        return true;
+    }
+    //backtrace第一次调用会加载libgcc，先在这里调用一次
+    void *warmup[1];
+    ::backtrace(warmup, 1);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof sa);
+    sa.sa_sigaction = profHandler;
+    sa.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    if(::sigaction(SIGPROF, &sa, nullptr) < 0)
+    {
+        LOG_ERROR("Profiler sigaction error:%d \n", errno);
+        return false;
+    }
+    g_handlerInstalled = true;
+    return true;
+}
+
+static bool armTimer(ThreadSlot *slot, int hz)
+{
+    clockid_t clock;
+    if(::pthread_getcpuclockid(slot->thread, &clock) != 0)
+    {
+        return false;
+    }
+    struct sigevent sev;
+    memset(&sev, 0, sizeof sev);
+    sev.sigev_notify = SIGEV_THREAD_ID;
+    sev.sigev_signo = SIGPROF;
+    sev.sigev_notify_thread_id = slot->tid.load(std::memory_order_relaxed);
+    if(::timer_create(clock, &sev, &slot->timer) < 0)
+    {
+        LOG_ERROR("Profiler timer_create error:%d \n", errno);
+        return false;
+    }
+    slot->timerCreated = true;
+
+    long intervalNanos = 1000L * 1000 * 1000 / hz;
+    struct itimerspec its;
+    its.it_interval.tv_sec = intervalNanos / (1000L * 1000 * 1000);
+    its.it_interval.tv_nsec = intervalNanos % (1000L * 1000 * 1000);
+    its.it_value = its.it_interval;
+    if(::timer_settime(slot->timer, 0, &its, nullptr) < 0)
+    {
+        LOG_ERROR("Profiler timer_settime error:%d \n", errno);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * 槽位从头重新分配；缓冲区容量没变就复用，否则换一个新的，
+ * 旧的不释放，上一次采样还在路上的信号可能正在写它
+*/
+static void assignSlot(int index, int tid, pthread_t thread, const std::string &name, size_t capacity)
+{
+    ThreadSlot &slot = g_slots[index];
+    slot.thread = thread;
+    slot.name = name;
+    slot.timerCreated = false;
+    SampleBuffer *buffer = slot.buffer.load(std::memory_order_relaxed);
+    if(buffer && buffer->samples.size() == capacity)
+    {
+        buffer->written.store(0, std::memory_order_relaxed);
+    }
+    else
+    {
+        slot.buffer.store(new SampleBuffer(capacity), std::memory_order_release);
+    }
+    slot.tid.store(tid, std::memory_order_relaxed);
+}
+
+bool Profiler::start(int hz, size_t samplesPerThread)
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if(g_running || hz <= 0 || !installHandler())
+    {
+        return false;
+    }
+    if(samplesPerThread == 0)
+    {
+        samplesPerThread = 1;
+    }
+
+    g_slotCount.store(0, std::memory_order_release);
+    int count = 0;
+    //持着登记表的锁，loop线程不会在这期间退出
+    LoopMetrics::forEachLoop([&](EventLoop *loop) {
+        if(count < kMaxThreads)
+        {
+            char name[32];
+            snprintf(name, sizeof name, "loop-%d", loop->threadId());
+            assignSlot(count++, loop->threadId(), loop->pthreadId(), name, samplesPerThread);
+        }
+    });
+    for(const WorkerThread &worker : g_workers)
+    {
+        if(count < kMaxThreads)
+        {
+            assignSlot(count++, worker.tid, worker.thread, worker.name, samplesPerThread);
+        }
+    }
+    g_slotCount.store(count, std::memory_order_release);
+
+    for(int i = 0; i < count; ++i)
+    {
+        armTimer(&g_slots[i], hz);
+    }
+    g_running = true;
+    return true;
+}
+
+void Profiler::stop()
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if(!g_running)
+    {
+        return;
+    }
+    int count = g_slotCount.load(std::memory_order_relaxed);
+    for(int i = 0; i < count; ++i)
+    {
+        if(g_slots[i].timerCreated)
+        {
+            ::timer_delete(g_slots[i].timer);
+            g_slots[i].timerCreated = false;
+        }
+    }
+    g_running = false;
+}
+
+bool Profiler::running()
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    return g_running;
+}
+
+void Profiler::registerThread(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    WorkerThread worker;
+    worker.tid = CurrentThread::tid();
+    worker.thread = ::pthread_self();
+    worker.name = name;
+    g_workers.push_back(worker);
+}
+
+void Profiler::unregisterThread()
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    int tid = CurrentThread::tid();
+    g_workers.erase(std::remove_if(g_workers.begin(), g_workers.end(),
+        [tid](const WorkerThread &w) { return w.tid == tid; }), g_workers.end());
+    //正在采样的话停掉这个线程的定时器
+    int count = g_slotCount.load(std::memory_order_relaxed);
+    for(int i = 0; i < count; ++i)
+    {
+        if(g_slots[i].tid.load(std::memory_order_relaxed) == tid && g_slots[i].timerCreated)
+        {
+            ::timer_delete(g_slots[i].timer);
+            g_slots[i].timerCreated = false;
+        }
+    }
+}
+
+//地址转成函数名，找不到符号就用模块名+偏移
+static std::string symbolize(void *pc)
+{
+    Dl_info info;
+    if(::dladdr(pc, &info) == 0)
+    {
+        char buf[32];
+        snprintf(buf, sizeof buf, "%p", pc);
+        return buf;
+    }
+    if(info.dli_sname)
+    {
+        int status = 0;
+        char *demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        std::string name(status == 0 && demangled ? demangled : info.dli_sname);
+        ::free(demangled);
+        return name;
+    }
+    const char *module = info.dli_fname ? info.dli_fname : "?";
+    const char *slash = strrchr(module, '/');
+    char buf[256];
+    snprintf(buf, sizeof buf, "%s+0x%lx", slash ? slash + 1 : module,
+        static_cast<unsigned long>(static_cast<char*>(pc) - static_cast<char*>(info.dli_fbase)));
+    return buf;
+}
+
+std::string Profiler::foldedStacks()
+{
+    std::map<std::string, int64_t> stacks;
+    std::map<void*, std::string> symbols;
+    std::vector<Sample> copy;
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+    int count = g_slotCount.load(std::memory_order_acquire);
+    for(int i = 0; i < count; ++i)
+    {
+        ThreadSlot &slot = g_slots[i];
+        SampleBuffer *buffer = slot.buffer.load(std::memory_order_acquire);
+        if(buffer == nullptr)
+        {
+            continue;
+        }
+        const uint64_t capacity = buffer->samples.size();
+        uint64_t end = buffer->written.load(std::memory_order_acquire);
+        uint64_t begin = end > capacity ? end - capacity : 0;
+        copy.assign(end - begin, Sample());
+        for(uint64_t k = begin; k < end; ++k)
+        {
+            copy[k - begin] = buffer->samples[k % capacity];
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t after = buffer->written.load(std::memory_order_relaxed);
+        //拷贝的过程中被信号处理函数覆盖的槽位不要，逻辑序号after - capacity的槽位可能正写到一半，也不要
+        uint64_t valid = after >= capacity ? after - capacity + 1 : 0;
+
+        for(uint64_t k = std::max(begin, valid); k < end; ++k)
+        {
+            const Sample &sample = copy[k - begin];
+            std::string key = slot.name;
+            if(sample.phase)
+            {
+                key += ';';
+                key += sample.phase;
+            }
+            if(sample.activity)
+            {
+                key += ';';
+                key += sample.activity;
+            }
+            //backtrace是从内往外的，folded格式要从外往内
+            for(int f = sample.depth - 1; f >= kSkipFrames; --f)
+            {
+                //除了被打断的那一帧，其余都是返回地址，减一才落在call指令所在的函数里
+                void *pc = sample.pcs[f];
+                if(f > kSkipFrames)
+                {
+                    pc = static_cast<char*>(pc) - 1;
+                }
+                auto it = symbols.find(pc);
+                if(it == symbols.end())
+                {
+                    it = symbols.insert(std::make_pair(pc, symbolize(pc))).first;
+                }
+                key += ';';
+                key += it->second;
+            }
+            ++stacks[key];
+        }
+    }
+
+    std::string out;
+    char buf[32];
+    for(const auto &stack : stacks)
+    {
+        out += stack.first;
+        snprintf(buf, sizeof buf, " %ld\n", static_cast<long>(stack.second));
+        out += buf;
+    }
+    return out;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <string>
+#include <stddef.h>
+
+/**
+ * 采样式CPU profiler，线上可以随时打开
+ * 每个被采样的线程一个CPU时间定时器(timer_create + SIGEV_THREAD_ID)，线程真正在跑的时候才会收到SIGPROF，
+ * 信号处理函数抓调用栈写进该线程自己的环形缓冲区，不加锁也不分配内存；
+ * 每个样本带上loop当时所处的阶段（poll/handleEvent/pendingFunctors/flushFunctors）和正在执行的回调，
+ * 导出成flamegraph.pl可以直接读的folded格式：线程;阶段;回调;最外层函数;...;最内层函数 次数
+ *
+ * 调用栈用backtrace()展开，可执行文件需要-rdynamic才能看到符号名
+ * （glibc 2.35以后展开时查找FDE不再加锁，在信号处理函数里调用是安全的）
+*/
+class Profiler : noncopyable
+{
+public:
+    //给当前所有EventLoop线程和registerThread登记过的线程开始采样，清掉上一次的样本
+    //hz是每个线程每秒CPU时间采样多少次，samplesPerThread是每个线程缓冲区的样本数，满了以后覆盖最早的
+    //之后新创建的EventLoop不会被采样；已经在采样时返回false
+    static bool start(int hz = 99, size_t samplesPerThread = 8192);
+    static void stop();
+    static bool running();
+
+    //在非loop的工作线程里调用，之后start的时候也会采样这个线程，name是导出时的线程名
+    static void registerThread(const std::string &name);
+    static void unregisterThread();
+
+    //把所有线程的样本导出成folded格式，可以在采样过程中调用
+    static std::string foldedStacks();
+};
@@ -7,6 +7,7 @@
 #include <sys/socket.h>
 #include <strings.h>
 #include <netinet/tcp.h>
+#include <errno.h>
 
 
 Socket::~Socket()
@@ -17,9 +18,9 @@ Socket::~Socket()
 
 void Socket::bindAddress(const InetAddress &localaddr)
 {
-    if(0 != ::bind(sockfd_,(sockaddr*)localaddr.getSockAddr(),sizeof(sockaddr_in)))
+    if(0 != ::bind(sockfd_,localaddr.getSockAddr(),localaddr.getSockAddrLen()))
     {
-        LOG_FATAL("bind sockfd:%d fail\n",sockfd_);
+        LOG_FATAL("bind sockfd:%d to %s fail, errno:%d\n",sockfd_,localaddr.toIpPort().c_str(),errno);
     }
 }
 
@@ -39,13 +40,13 @@ int Socket::accept(InetAddress *peeraddr)
      * Reactor 模型 one loop per thread 
      * poller + non-blocking IO
     */
-    sockaddr_in addr;
+    sockaddr_storage addr; //IPv4、IPv6、Unix域地址都放得下
     socklen_t len = sizeof addr;
     bzero(&addr,sizeof addr);
     int connfd = ::accept4(sockfd_,(sockaddr*)&addr,&len, SOCK_NONBLOCK | SOCK_CLOEXEC);
     if(connfd >= 0)
     {
-        peeraddr->setSockAddr(addr); //把客户端地址传出去
+        peeraddr->setSockAddr((sockaddr*)&addr,len); //把客户端地址传出去
     }
     return connfd;
 }
@@ -84,3 +85,18 @@ void Socket::setKeepAlive(bool on)
     int optval = on ? 1 : 0;
     ::setsockopt(sockfd_,SOL_SOCKET, SO_KEEPALIVE, &optval, sizeof optval);
 }
+
+void Socket::setBusyPoll(int usec)
+{
+    if(::setsockopt(sockfd_,SOL_SOCKET, SO_BUSY_POLL, &usec, sizeof usec) < 0)
+    {
+        LOG_ERROR("setBusyPoll sockfd:%d fail\n",sockfd_);
+    }
+}
+
+bool Socket::getTcpInfo(struct tcp_info *info) const
+{
+    socklen_t len = sizeof(*info);
+    ::bzero(info,len);
+    return ::getsockopt(sockfd_,SOL_TCP,TCP_INFO,info,&len) == 0;
+}
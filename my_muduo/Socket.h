@@ -3,6 +3,7 @@
 #include "noncopyable.h"
 
 class InetAddress;
+struct tcp_info;
 
 //封装socket fd
 class Socket : noncopyable
@@ -32,6 +33,12 @@ public:
 
     void setKeepAlive(bool on);
 
+    //内核收包时忙等usec微秒，配合loop的spin模式降低延迟
+    void setBusyPoll(int usec);
+
+    //读取内核的TCP_INFO（rtt、拥塞窗口、重传等），失败返回false
+    bool getTcpInfo(struct tcp_info *info) const;
+
 private:
     const  int sockfd_;
 
@@ -0,0 +1,250 @@
+#include "StallWatchdog.h"
+#include "logger.h"
+
+#include <execinfo.h>
+#include <signal.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+std::atomic_int StallWatchdog::active_(0);
+
+static const int kBacktraceSignal = SIGUSR2;
+static const int kMaxFrames = 64;
+static const int kBacktraceWaitMs = 50;
+
+//信号处理函数把调用栈写到这里，同一时间只有一次抓取
+static std::mutex g_captureMutex;
+static void *g_frames[kMaxFrames];
+static std::atomic<int> g_frameCount(-1);
+
+static void backtraceHandler(int)
+{
+    int savedErrno = errno;
+    int n = ::backtrace(g_frames, kMaxFrames);
+    g_frameCount.store(n, std::memory_order_release);
+    errno = savedErrno;
+}
+
+static void installBacktraceHandler()
+{
+    //backtrace第一次调用会加载libgcc，先在这里调用一次，信号处理函数里就不会再分配内存
+    void *warmup[1];
+    ::backtrace(warmup, 1);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof sa);
+    sa.sa_handler = backtraceHandler;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    if(::sigaction(kBacktraceSignal, &sa, nullptr) < 0)
+    {
+        LOG_ERROR("StallWatchdog sigaction error:%d \n", errno);
+    }
+}
+
+//给loop线程发信号，等它把调用栈写回来，超时返回空
+static std::vector<std::string> captureBacktrace(pthread_t thread)
+{
+    std::vector<std::string> frames;
+    std::lock_guard<std::mutex> lock(g_captureMutex);
+    g_frameCount.store(-1, std::memory_order_relaxed);
+    if(::pthread_kill(thread, kBacktraceSignal) != 0)
+    {
+        return frames;
+    }
+
+    int n = -1;
+    for(int i = 0; i < kBacktraceWaitMs; ++i)
+    {
+        n = g_frameCount.load(std::memory_order_acquire);
+        if(n >= 0)
+        {
+            break;
+        }
+        ::usleep(1000);
+    }
+    if(n <= 0)
+    {
+        return frames;
+    }
+
+    char **symbols = ::backtrace_symbols(g_frames, n);
+    if(symbols)
+    {
+        //前两帧是信号处理函数和内核的信号跳板
+        for(int i = 2; i < n; ++i)
+        {
+            frames.push_back(symbols[i]);
+        }
+        ::free(symbols);
+    }
+    return frames;
+}
+
+//按seqlock读loop当前的回调，读的过程中被改写了返回false
+static bool readActivity(const LoopMetrics &m, uint64_t *seq, int64_t *start, const char **name, int *fd)
+{
+    uint64_t before = m.activitySeq.load(std::memory_order_acquire);
+    if(before & 1)
+    {
+        return false;
+    }
+    *start = m.activityStart.load(std::memory_order_relaxed);
+    *name = m.activityName.load(std::memory_order_relaxed);
+    *fd = m.activityFd.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    *seq = m.activitySeq.load(std::memory_order_relaxed);
+    return *seq == before;
+}
+
+static void defaultStallCallback(const StallWatchdog::StallInfo &info)
+{
+    LOG_ERROR("EventLoop stall: tid=%d %s fd=%d blocked %.1f ms \n",
+        info.tid, info.name ? info.name : "?", info.fd, info.durationNanos / 1e6);
+    for(const std::string &frame : info.backtrace)
+    {
+        LOG_ERROR("    %s \n", frame.c_str());
+    }
+}
+
+StallWatchdog::StallWatchdog(double thresholdSeconds)
+    : thresholdNanos_(static_cast<int64_t>(thresholdSeconds * 1e9))
+    , checkIntervalNanos_(thresholdNanos_ / 4)
+    , backtrace_(false)
+    , stallCallback_(defaultStallCallback)
+    , running_(false)
+{
+}
+
+StallWatchdog::~StallWatchdog()
+{
+    stop();
+}
+
+void StallWatchdog::start()
+{
+    if(running_)
+    {
+        return;
+    }
+    if(checkIntervalNanos_ < 1000 * 1000)
+    {
+        checkIntervalNanos_ = 1000 * 1000;
+    }
+    if(backtrace_)
+    {
+        installBacktraceHandler();
+    }
+    running_ = true;
+    active_.fetch_add(1, std::memory_order_relaxed);
+    thread_.reset(new Thread(std::bind(&StallWatchdog::threadFunc, this), "StallWatchdog"));
+    thread_->start();
+}
+
+void StallWatchdog::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(!running_)
+        {
+            return;
+        }
+        running_ = false;
+    }
+    cond_.notify_one();
+    thread_->join();
+    thread_.reset();
+    active_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void StallWatchdog::threadFunc()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while(running_)
+    {
+        cond_.wait_for(lock, std::chrono::nanoseconds(checkIntervalNanos_));
+        if(!running_)
+        {
+            break;
+        }
+        lock.unlock();
+        check();
+        lock.lock();
+    }
+}
+
+/**
+ * 一次扫描：同一次回调（activitySeq不变）只算一次卡顿，
+ * 回调结束（seq变了）以后把最后观察到的时长记进直方图，精度是扫描间隔
+*/
+void StallWatchdog::check()
+{
+    std::vector<StallInfo> stalls;
+    std::map<EventLoop*, Tracking> next;
+    int64_t now = LoopActivity::nowNanos();
+
+    //持着登记表的锁，loop析构时会先等在注销上，给loop线程发信号是安全的
+    LoopMetrics::forEachLoop([&](EventLoop *loop) {
+        LoopMetrics &m = loop->metrics();
+        Tracking t;
+        auto it = tracking_.find(loop);
+        if(it != tracking_.end())
+        {
+            t = it->second;
+        }
+
+        uint64_t seq;
+        int64_t start;
+        const char *name;
+        int fd;
+        if(!readActivity(m, &seq, &start, &name, &fd))
+        {
+            next[loop] = t; //正在切换回调，下次再看
+            return;
+        }
+
+        if(t.stalled && t.seq != seq)
+        {
+            LoopMetrics::add(m.stallNanos, t.elapsed);
+            m.stallDuration.record(t.elapsed);
+            t.stalled = false;
+        }
+        if(t.stalled)
+        {
+            t.elapsed = now - start;
+        }
+        else if(start != 0 && now - start >= thresholdNanos_)
+        {
+            t.stalled = true;
+            t.seq = seq;
+            t.elapsed = now - start;
+            LoopMetrics::add(m.stalls, 1);
+
+            StallInfo info;
+            info.tid = loop->threadId();
+            info.name = name;
+            info.fd = fd;
+            info.durationNanos = t.elapsed;
+            if(backtrace_)
+            {
+                info.backtrace = captureBacktrace(loop->pthreadId());
+                //抓的过程中回调已经结束了，调用栈不是卡住的地方
+                uint64_t after;
+                if(!readActivity(m, &after, &start, &name, &fd) || after != seq)
+                {
+                    info.backtrace.clear();
+                }
+            }
+            stalls.push_back(std::move(info));
+        }
+        next[loop] = t;
+    });
+    tracking_.swap(next);
+
+    for(const StallInfo &info : stalls)
+    {
+        stallCallback_(info);
+    }
+}
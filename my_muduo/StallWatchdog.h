@@ -0,0 +1,135 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "EventLoop.h"
+#include "Thread.h"
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+
+/**
+ * 事件循环卡顿检测
+ * 一个messageCallback或者pendingFunctor跑太久，同一个subloop上的所有连接都要等它，
+ * loop自己发现不了。loop在进入/离开每个回调时（LoopActivity）把回调名字、fd、开始时间
+ * 写进LoopMetrics，watchdog线程定期扫描所有loop，发现一个回调超过阈值就记一次卡顿，
+ * 可选给loop线程发信号抓调用栈（可执行文件需要-rdynamic才能看到符号名）
+ *
+ * 卡顿次数和时长记在每个loop的LoopMetrics里，/metrics会导出；一个进程只开一个watchdog
+*/
+class StallWatchdog : noncopyable
+{
+public:
+    struct StallInfo
+    {
+        pid_t tid;                          //卡住的loop线程
+        const char *name;                   //卡住的回调
+        int fd;                             //回调所属的fd，-1表示和fd无关
+        int64_t durationNanos;              //发现时已经卡了多久
+        std::vector<std::string> backtrace; //没有开启或者没抓到时为空
+    };
+    using StallCallback = std::function<void(const StallInfo&)>;
+
+    //回调超过thresholdSeconds算一次卡顿
+    explicit StallWatchdog(double thresholdSeconds = 0.1);
+    ~StallWatchdog();
+
+    //扫描间隔，默认是阈值的1/4，需要在start之前设置
+    void setCheckInterval(double seconds) { checkIntervalNanos_ = static_cast<int64_t>(seconds * 1e9); }
+    //发现卡顿时用信号(SIGUSR2)抓loop线程的调用栈，默认关闭，需要在start之前设置
+    //信号会打断loop线程里正在阻塞的系统调用（比如sleep），建议只在排查问题时打开
+    void setBacktrace(bool on) { backtrace_ = on; }
+    //每次发现卡顿时在watchdog线程里调用，默认打一条ERROR日志
+    void setStallCallback(StallCallback cb) { stallCallback_ = std::move(cb); }
+
+    void start();
+    void stop();
+
+    //有watchdog在运行时LoopActivity才记录
+    static bool active() { return active_.load(std::memory_order_relaxed) > 0; }
+
+private:
+    //每个loop正在跟踪的卡顿
+    struct Tracking
+    {
+        Tracking() : stalled(false), seq(0), elapsed(0) {}
+        bool stalled;
+        uint64_t seq;    //卡住的那次回调
+        int64_t elapsed; //最近一次观察到的时长
+    };
+
+    void threadFunc();
+    void check();
+
+    const int64_t thresholdNanos_;
+    int64_t checkIntervalNanos_;
+    bool backtrace_;
+    StallCallback stallCallback_;
+
+    bool running_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::unique_ptr<Thread> thread_;
+    std::map<EventLoop*, Tracking> tracking_; //只在watchdog线程访问
+
+    static std::atomic_int active_;
+};
+
+/**
+ * 作用域内标记loop正在执行的回调，只能在loop线程使用
+ * 回调名字总是写进t_loopActivity（Profiler用）；有watchdog运行时才发布到LoopMetrics，
+ * 嵌套时（handleEvent里的messageCallback）内层结束以后恢复外层的名字，开始时间从恢复时算起
+*/
+class LoopActivity : noncopyable
+{
+public:
+    LoopActivity(EventLoop *loop, const char *name, int fd = -1)
+        : metrics_(StallWatchdog::active() ? &loop->metrics() : nullptr)
+        , prevActivity_(t_loopActivity)
+    {
+        t_loopActivity = name;
+        if(metrics_)
+        {
+            prevName_ = metrics_->activityName.load(std::memory_order_relaxed);
+            prevFd_ = metrics_->activityFd.load(std::memory_order_relaxed);
+            publish(name, fd, nowNanos());
+        }
+    }
+
+    ~LoopActivity()
+    {
+        t_loopActivity = prevActivity_;
+        if(metrics_)
+        {
+            publish(prevName_, prevFd_, prevName_ ? nowNanos() : 0);
+        }
+    }
+
+    static int64_t nowNanos()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+private:
+    //seqlock：写的过程中activitySeq是奇数，读的一方前后两次seq不一致就丢弃
+    void publish(const char *name, int fd, int64_t start)
+    {
+        uint64_t seq = metrics_->activitySeq.load(std::memory_order_relaxed);
+        metrics_->activitySeq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        metrics_->activityName.store(name, std::memory_order_relaxed);
+        metrics_->activityFd.store(fd, std::memory_order_relaxed);
+        metrics_->activityStart.store(start, std::memory_order_relaxed);
+        metrics_->activitySeq.store(seq + 2, std::memory_order_release);
+    }
+
+    LoopMetrics *metrics_; //nullptr表示没有watchdog在运行
+    const char *prevActivity_;
+    const char *prevName_;
+    int prevFd_;
+};
@@ -0,0 +1,192 @@
+#include "StatsPublisher.h"
+#include "StatsShmLayout.h"
+#include "EventLoop.h"
+#include "logger.h"
+
+#include <future>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <stdio.h>
+
+static std::string shmNameForPid(pid_t pid)
+{
+    char buf[64];
+    snprintf(buf, sizeof buf, "/muduo-stats.%d", pid);
+    return buf;
+}
+
+static int64_t monotonicNanos()
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000 * 1000 * 1000 + ts.tv_nsec;
+}
+
+//seqlock写：奇数表示正在写
+static uint64_t beginWrite(std::atomic<uint64_t> &seq)
+{
+    uint64_t s = seq.load(std::memory_order_relaxed) + 1;
+    seq.store(s, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return s;
+}
+
+static void endWrite(std::atomic<uint64_t> &seq, uint64_t s)
+{
+    seq.store(s + 1, std::memory_order_release);
+}
+
+static void set(std::atomic<int64_t> &field, int64_t value)
+{
+    field.store(value, std::memory_order_relaxed);
+}
+
+StatsPublisher::StatsPublisher(EventLoop *loop, double intervalSeconds)
+    : loop_(loop)
+    , interval_(intervalSeconds)
+    , shmName_(shmNameForPid(::getpid()))
+    , segment_(nullptr)
+{
+}
+
+StatsPublisher::~StatsPublisher()
+{
+    if(!segment_)
+    {
+        return;
+    }
+    if(loop_->isInLoopThread())
+    {
+        stopInLoop();
+    }
+    else
+    {
+        //cancel只是排进loop，定时器可能已经到期、publish已经在排队，等loop里取消完再返回
+        std::promise<void> done;
+        loop_->runInLoop([this, &done]() {
+            stopInLoop();
+            done.set_value();
+        });
+        done.get_future().wait();
+    }
+    ::shm_unlink(shmName_.c_str());
+}
+
+//在loop线程取消定时器再解除映射，之后不会再有publish写这个段
+void StatsPublisher::stopInLoop()
+{
+    loop_->cancel(timerId_);
+    ::munmap(segment_, sizeof(StatsShmSegment));
+    segment_ = nullptr;
+}
+
+bool StatsPublisher::start()
+{
+    if(!loop_->isInLoopThread())
+    {
+        LOG_ERROR("StatsPublisher::start called outside its loop thread \n");
+        return false;
+    }
+    //同名的旧段（上一个同pid的进程留下的）可能还被muduo-top映射着，O_TRUNC截断它会让读的一方SIGBUS，
+    //先删掉名字再新建，已经映射的一方继续读旧的那一份
+    ::shm_unlink(shmName_.c_str());
+    int fd = ::shm_open(shmName_.c_str(), O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0644);
+    if(fd < 0)
+    {
+        LOG_ERROR("StatsPublisher shm_open %s error:%d \n", shmName_.c_str(), errno);
+        return false;
+    }
+    if(::ftruncate(fd, sizeof(StatsShmSegment)) < 0)
+    {
+        LOG_ERROR("StatsPublisher ftruncate error:%d \n", errno);
+        ::close(fd);
+        ::shm_unlink(shmName_.c_str());
+        return false;
+    }
+    void *addr = ::mmap(nullptr, sizeof(StatsShmSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(addr == MAP_FAILED)
+    {
+        LOG_ERROR("StatsPublisher mmap error:%d \n", errno);
+        ::shm_unlink(shmName_.c_str());
+        return false;
+    }
+
+    //ftruncate出来的段全是0，atomic的初值也就是0
+    segment_ = static_cast<StatsShmSegment*>(addr);
+    StatsShmHeader &h = segment_->header;
+    h.version = kStatsShmVersion;
+    h.headerSize = sizeof(StatsShmHeader);
+    h.loopRecordSize = sizeof(StatsShmLoop);
+    h.serverRecordSize = sizeof(StatsShmServer);
+    h.maxLoops = kStatsShmMaxLoops;
+    h.maxServers = kStatsShmMaxServers;
+    h.pid = ::getpid();
+    h.intervalNanos = static_cast<int64_t>(interval_ * 1e9);
+    //magic最后写，读的一方看到magic就说明其余的头部字段已经填好了
+    std::atomic_thread_fence(std::memory_order_release);
+    h.magic = kStatsShmMagic;
+
+    publish();
+    timerId_ = loop_->runEvery(interval_, [this]() { publish(); });
+    return true;
+}
+
+void StatsPublisher::publish()
+{
+    int numLoops = 0;
+    LoopMetrics::forEachLoop([this, &numLoops](EventLoop *loop) {
+        if(numLoops >= kStatsShmMaxLoops)
+        {
+            return;
+        }
+        const LoopMetrics &m = loop->metrics();
+        StatsShmLoop &r = segment_->loops[numLoops++];
+        uint64_t s = beginWrite(r.seq);
+        set(r.tid, loop->threadId());
+        set(r.pollWakeups, m.pollWakeups.load(std::memory_order_relaxed));
+        set(r.eventsDispatched, m.eventsDispatched.load(std::memory_order_relaxed));
+        set(r.functorsRun, m.functorsRun.load(std::memory_order_relaxed));
+        set(r.pollNanos, m.pollNanos.load(std::memory_order_relaxed));
+        set(r.callbackNanos, m.callbackNanos.load(std::memory_order_relaxed));
+        set(r.connectionsAccepted, m.connectionsAccepted.load(std::memory_order_relaxed));
+        set(r.connectionsEstablished, m.connectionsEstablished.load(std::memory_order_relaxed));
+        set(r.connectionsClosed, m.connectionsClosed.load(std::memory_order_relaxed));
+        set(r.bytesRead, m.bytesRead.load(std::memory_order_relaxed));
+        set(r.bytesWritten, m.bytesWritten.load(std::memory_order_relaxed));
+        set(r.bufferedBytes, loop->bufferedBytes());
+        set(r.stalls, m.stalls.load(std::memory_order_relaxed));
+        set(r.functorQueueP99, m.functorQueueDepth.percentile(99));
+        set(r.functorQueueMax, m.functorQueueDepth.max());
+        set(r.iterationP99Nanos, m.iterationNanos.percentile(99));
+        endWrite(r.seq, s);
+    });
+
+    int numServers = 0;
+    ServerMetrics::forEachServer([this, &numServers](const ServerMetrics &m) {
+        if(numServers >= kStatsShmMaxServers)
+        {
+            return;
+        }
+        StatsShmServer &r = segment_->servers[numServers++];
+        uint64_t s = beginWrite(r.seq);
+        strncpy(r.name, m.name.c_str(), kStatsShmNameLen - 1);
+        r.name[kStatsShmNameLen - 1] = '\0';
+        set(r.connectionsAccepted, m.connectionsAccepted.load(std::memory_order_relaxed));
+        set(r.activeConnections, m.activeConnections.load(std::memory_order_relaxed));
+        endWrite(r.seq, s);
+    });
+
+    StatsShmHeader &h = segment_->header;
+    uint64_t s = beginWrite(h.seq);
+    h.publishNanos.store(monotonicNanos(), std::memory_order_relaxed);
+    h.numLoops.store(numLoops, std::memory_order_relaxed);
+    h.numServers.store(numServers, std::memory_order_relaxed);
+    endWrite(h.seq, s);
+}
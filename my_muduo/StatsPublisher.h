@@ -0,0 +1,37 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "TimerId.h"
+
+#include <string>
+
+class EventLoop;
+struct StatsShmSegment;
+
+/**
+ * 把LoopMetrics/ServerMetrics定期发布到共享内存段（布局见StatsShmLayout.h），给外部的muduo-top读
+ * 读的一方不经过任何socket，也不会让写的一方等待；发布在loop的定时器里做，每次只是拷几十个计数器
+*/
+class StatsPublisher : noncopyable
+{
+public:
+    StatsPublisher(EventLoop *loop, double intervalSeconds = 1.0);
+    //删除共享内存段，进程被信号杀掉时段会留在/dev/shm里，同一个pid下次start会先删掉再新建
+    //定时器的取消和munmap在loop线程里同步做完；在别的线程析构时会等loop执行完，loop必须还在运行
+    ~StatsPublisher();
+
+    //创建 /muduo-stats.<pid> 并开始定期发布，失败返回false；在loop线程调用（比如loop.loop()之前）
+    bool start();
+
+    const std::string& shmName() const { return shmName_; }
+
+private:
+    void publish();
+    void stopInLoop();
+
+    EventLoop *loop_;
+    const double interval_;
+    const std::string shmName_;
+    StatsShmSegment *segment_;
+    TimerId timerId_;
+};
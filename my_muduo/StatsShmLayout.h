@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+/**
+ * 共享内存统计段的二进制布局，进程里的StatsPublisher写，外部的muduo-top只读映射
+ * 段名是 /muduo-stats.<pid>（/dev/shm下面），布局改了就要递增kStatsShmVersion
+ *
+ * 每条记录一个seqlock：写的时候seq先变成奇数，写完变成偶数；
+ * 读的一方seq是奇数或者前后两次不一致就重读，写的一方从来不等读的一方
+ * 计数字段都是无锁的std::atomic；StatsShmServer::name是普通char数组，每次发布都在seqlock里重写，
+ * 读的一方拷贝它时可能和写并发（严格说是数据竞争），读到写了一半的名字时seq对不上，整条记录会被丢弃重读
+*/
+
+const uint32_t kStatsShmMagic = 0x4154534d; //"MSTA"
+const uint32_t kStatsShmVersion = 1;
+const int kStatsShmMaxLoops = 64;
+const int kStatsShmMaxServers = 16;
+const int kStatsShmNameLen = 32;
+
+struct StatsShmLoop
+{
+    std::atomic<uint64_t> seq;
+    std::atomic<int64_t> tid;
+    std::atomic<int64_t> pollWakeups;
+    std::atomic<int64_t> eventsDispatched;
+    std::atomic<int64_t> functorsRun;
+    std::atomic<int64_t> pollNanos;
+    std::atomic<int64_t> callbackNanos;
+    std::atomic<int64_t> connectionsAccepted;
+    std::atomic<int64_t> connectionsEstablished;
+    std::atomic<int64_t> connectionsClosed;
+    std::atomic<int64_t> bytesRead;
+    std::atomic<int64_t> bytesWritten;
+    std::atomic<int64_t> bufferedBytes;
+    std::atomic<int64_t> stalls;
+    std::atomic<int64_t> functorQueueP99;    //每次doPendingFunctors取出的回调个数
+    std::atomic<int64_t> functorQueueMax;
+    std::atomic<int64_t> iterationP99Nanos;  //每轮处理事件和回调的时间
+};
+
+struct StatsShmServer
+{
+    std::atomic<uint64_t> seq;
+    char name[kStatsShmNameLen];           //不是atomic，靠seqlock发现读到一半被改写的情况
+    std::atomic<int64_t> connectionsAccepted;
+    std::atomic<int64_t> activeConnections;
+};
+
+struct StatsShmHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t headerSize;       //读的一方用这几个大小检查布局是否一致
+    uint32_t loopRecordSize;
+    uint32_t serverRecordSize;
+    uint32_t maxLoops;
+    uint32_t maxServers;
+    int32_t pid;
+    int64_t intervalNanos;     //发布间隔
+
+    std::atomic<uint64_t> seq; //保护下面三个字段
+    std::atomic<int64_t> publishNanos; //最近一次发布的时间（CLOCK_MONOTONIC），读的一方用它算速率
+    std::atomic<int32_t> numLoops;
+    std::atomic<int32_t> numServers;
+};
+
+struct StatsShmSegment
+{
+    StatsShmHeader header;
+    StatsShmLoop loops[kStatsShmMaxLoops];
+    StatsShmServer servers[kStatsShmMaxServers];
+};
+
+static_assert(sizeof(std::atomic<int64_t>) == sizeof(int64_t), "atomic<int64_t> must be plain 8 bytes");
@@ -0,0 +1,70 @@
+#include "Strand.h"
+#include "EventLoop.h"
+#include "ComputePool.h"
+#include "LoopMetrics.h"
+
+Strand::Strand(EventLoop *loop, ComputePool *pool)
+    : loop_(loop)
+    , pool_(pool)
+    , scheduled_(false)
+    , completed_(0)
+{
+}
+
+void Strand::post(Functor work, Functor continuation)
+{
+    Item item;
+    item.work = std::move(work);
+    item.continuation = std::move(continuation);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(std::move(item));
+        if(scheduled_)
+        {
+            //前面的任务执行完会接着调度
+            return;
+        }
+        scheduled_ = true;
+    }
+    ComputePool *pool = pool_ ? pool_ : loop_->computePool();
+    StrandPtr self = shared_from_this();
+    pool->submit([self]() { self->runNext(); });
+}
+
+//在计算线程里执行队头的任务，每次只执行一个再重新submit，一个很忙的strand不会一直占着worker：
+//重新提交用submitFifo放进先进先出的注入队列，和别的strand、外部提交的任务轮流执行
+void Strand::runNext()
+{
+    Item item;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        item = std::move(queue_.front());
+    }
+
+    item.work();
+    //同一个strand的continuation按执行顺序进pendingFunctors_，在loop线程里也是按顺序执行
+    if(item.continuation)
+    {
+        loop_->queueInLoop(std::move(item.continuation));
+    }
+    LoopMetrics::add(completed_, 1);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.pop_front();
+        if(queue_.empty())
+        {
+            scheduled_ = false;
+            return;
+        }
+    }
+    ComputePool *pool = pool_ ? pool_ : loop_->computePool();
+    StrandPtr self = shared_from_this();
+    pool->submitFifo([self]() { self->runNext(); });
+}
+
+size_t Strand::pending() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.size();
+}
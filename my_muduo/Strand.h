@@ -0,0 +1,69 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <functional>
+#include <memory>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <type_traits>
+#include <stdint.h>
+
+class EventLoop;
+class ComputePool;
+
+/**
+ * 串行执行器：post到同一个strand的任务按提交顺序一个接一个地在计算线程池里执行（不一定是同一个worker），
+ * 不同strand之间并行；每个任务的continuation回到loop线程，顺序和提交顺序一致
+ * 流水线协议（一个连接上连续发来多个请求）可以把请求并行地交给线程池，又不用自己给应答重新排序，也不用给连接加锁
+ *
+ * 同一个strand的前一个任务happens-before后一个任务，任务之间共享的状态不需要再加锁
+ * 必须用shared_ptr持有（排队中的任务持有strand），通常用 TcpConnection::strand()：
+ *     conn->strand()->postResult([req]() { return handle(req); }, [conn](std::string resp) { conn->send(resp); });
+*/
+class Strand : noncopyable, public std::enable_shared_from_this<Strand>
+{
+public:
+    using Functor = std::function<void()>;
+
+    //continuation在loop线程中执行；pool为nullptr表示用loop->computePool()
+    explicit Strand(EventLoop *loop, ComputePool *pool = nullptr);
+
+    //可以在任意线程调用，continuation可以为空
+    void post(Functor work, Functor continuation = Functor());
+
+    //work的返回值移动给continuation，和 EventLoop::offloadResult 一样
+    template<typename Work, typename Continuation>
+    void postResult(Work work, Continuation continuation)
+    {
+        using Result = typename std::result_of<Work()>::type;
+        std::shared_ptr<std::unique_ptr<Result>> result = std::make_shared<std::unique_ptr<Result>>();
+        post([work, result]() { result->reset(new Result(work())); },
+             [continuation, result]() { continuation(std::move(**result)); });
+    }
+
+    EventLoop* getLoop() const { return loop_; }
+    //还没执行完的任务数（包括正在执行的），可以在任意线程读取
+    size_t pending() const;
+    int64_t completed() const { return completed_.load(std::memory_order_relaxed); }
+
+private:
+    struct Item
+    {
+        Functor work;
+        Functor continuation;
+    };
+
+    void runNext();
+
+    EventLoop *loop_;
+    ComputePool *pool_;
+
+    mutable std::mutex mutex_;
+    std::deque<Item> queue_; //队头是正在执行或者下一个要执行的任务
+    bool scheduled_; //线程池里是否已经有这个strand的任务，保证同一时刻最多一个
+    std::atomic<int64_t> completed_;
+};
+
+using StrandPtr = std::shared_ptr<Strand>;
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string.h>
+#include <strings.h>
+#include <string>
+
+/**
+ * 不拥有内存的字符串视图，指向别人的缓冲区（比如Buffer），不做拷贝
+ * 被指向的缓冲区变化以后就失效了，使用的时候要注意生命周期
+*/
+class StringPiece
+{
+public:
+    StringPiece()
+        : ptr_(nullptr)
+        , length_(0)
+    {}
+    StringPiece(const char *str)
+        : ptr_(str)
+        , length_(strlen(str))
+    {}
+    StringPiece(const char *str, size_t len)
+        : ptr_(str)
+        , length_(len)
+    {}
+    StringPiece(const std::string &str)
+        : ptr_(str.data())
+        , length_(str.size())
+    {}
+
+    const char* data() const { return ptr_; }
+    size_t size() const { return length_; }
+    bool empty() const { return length_ == 0; }
+    const char* begin() const { return ptr_; }
+    const char* end() const { return ptr_ + length_; }
+    char operator[](size_t i) const { return ptr_[i]; }
+
+    std::string toString() const { return std::string(ptr_, length_); }
+
+    bool operator==(const StringPiece &x) const
+    {
+        return length_ == x.length_ && memcmp(ptr_, x.ptr_, length_) == 0;
+    }
+    bool operator!=(const StringPiece &x) const { return !(*this == x); }
+
+    //忽略大小写比较，http的头部字段名不区分大小写
+    bool equalsIgnoreCase(const StringPiece &x) const
+    {
+        return length_ == x.length_ && strncasecmp(ptr_, x.ptr_, length_) == 0;
+    }
+
+private:
+    const char *ptr_;
+    size_t length_;
+};
@@ -0,0 +1,146 @@
+#include "TcpClient.h"
+#include "Connector.h"
+#include "EventLoop.h"
+#include "logger.h"
+
+#include <functional>
+#include <sys/socket.h>
+#include <strings.h>
+#include <stdio.h>
+
+static EventLoop *CheckLoopNotNull(EventLoop* loop)
+{
+    if(loop == nullptr)
+    {
+        LOG_FATAL("%s:%s:%d TcpClient loop is null! \n",__FILE__,__FUNCTION__,__LINE__);
+    }
+    return loop;
+}
+
+//TcpClient析构以后，连接断开时直接销毁连接，不能再回调到TcpClient
+static void removeConnectionAfterClient(EventLoop *loop, const TcpConnectionPtr &conn)
+{
+    loop->queueInLoop(std::bind(&TcpConnection::connectDestroyed,conn));
+}
+
+//用户没有设置回调时的默认操作
+static void defaultConnectionCallback(const TcpConnectionPtr &conn)
+{
+    LOG_INFO("TcpClient connection [%s] is %s \n",
+            conn->name().c_str(),conn->connected() ? "UP" : "DOWN");
+}
+
+static void defaultMessageCallback(const TcpConnectionPtr&, Buffer *buf, TimeStamp)
+{
+    buf->retrieveAll();
+}
+
+TcpClient::TcpClient(EventLoop *loop,
+            const InetAddress &serverAddr,
+            const std::string &nameArg)
+    : loop_(CheckLoopNotNull(loop))
+    , connector_(new Connector(loop,serverAddr))
+    , name_(nameArg)
+    , connectionCallback_(defaultConnectionCallback)
+    , messageCallback_(defaultMessageCallback)
+    , retry_(false)
+    , connect_(true)
+    , nextConnId_(1)
+{
+    connector_->setNewConnectionCallback(
+        std::bind(&TcpClient::newConnection,this,std::placeholders::_1));
+}
+
+TcpClient::~TcpClient()
+{
+    TcpConnectionPtr conn;
+    bool unique = false;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        unique = connection_.unique();
+        conn = connection_;
+    }
+    if(conn)
+    {
+        //连接还活着，把关闭回调换掉
+        CloseCallback cb = std::bind(&removeConnectionAfterClient,loop_,std::placeholders::_1);
+        loop_->runInLoop(std::bind(&TcpConnection::setCloseCallback,conn,cb));
+        if(unique)
+        {
+            conn->forceClose();
+        }
+    }
+    else
+    {
+        connector_->stop();
+    }
+}
+
+void TcpClient::connect()
+{
+    LOG_INFO("TcpClient::connect [%s] - connecting to %s \n",
+            name_.c_str(),connector_->serverAddress().toIpPort().c_str());
+    connect_ = true;
+    connector_->start();
+}
+
+void TcpClient::disconnect()
+{
+    connect_ = false;
+    std::unique_lock<std::mutex> lock(mutex_);
+    if(connection_)
+    {
+        connection_->shutdown();
+    }
+}
+
+void TcpClient::stop()
+{
+    connect_ = false;
+    connector_->stop();
+}
+
+void TcpClient::newConnection(int sockfd)
+{
+    InetAddress peerAddr(InetAddress::getPeerAddr(sockfd));
+    InetAddress localAddr(InetAddress::getLocalAddr(sockfd));
+
+    char buf[256] = {0}; //Unix域地址的路径最长108字节
+    snprintf(buf,sizeof buf,":%s#%d",peerAddr.toIpPort().c_str(),nextConnId_);
+    ++nextConnId_;
+    std::string connName = name_ + buf;
+
+    TcpConnectionPtr conn(new TcpConnection(
+        loop_,
+        connName,
+        sockfd,
+        localAddr,
+        peerAddr));
+
+    conn->setConnectionCallback(connectionCallback_);
+    conn->setMessageCallback(messageCallback_);
+    conn->setWriteCompleteCallback(writeCompleteCallback_);
+    conn->setCloseCallback(
+        std::bind(&TcpClient::removeConnection,this,std::placeholders::_1));
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        connection_ = conn;
+    }
+    conn->connectEstablished();
+}
+
+void TcpClient::removeConnection(const TcpConnectionPtr &conn)
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        connection_.reset();
+    }
+
+    loop_->queueInLoop(std::bind(&TcpConnection::connectDestroyed,conn));
+    if(retry_ && connect_)
+    {
+        LOG_INFO("TcpClient::connect [%s] - Reconnecting to %s \n",
+                name_.c_str(),connector_->serverAddress().toIpPort().c_str());
+        connector_->restart();
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "InetAddress.h"
+#include "Callbacks.h"
+#include "TcpConnection.h"
+
+#include <string>
+#include <memory>
+#include <mutex>
+
+class Connector;
+class EventLoop;
+using ConnectorPtr = std::shared_ptr<Connector>;
+
+/**
+ * 用户使用muduo库编写客户端程序
+ * 通过Connector发起非阻塞连接，连上以后和TcpServer一样打包成TcpConnection
+*/
+class TcpClient : noncopyable
+{
+public:
+    TcpClient(EventLoop *loop,
+            const InetAddress &serverAddr,
+            const std::string &nameArg);
+    ~TcpClient();
+
+    void connect();    //发起连接
+    void disconnect(); //关闭已经建立的连接
+    void stop();       //停止正在进行的连接
+
+    TcpConnectionPtr connection() const
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return connection_;
+    }
+
+    EventLoop* getLoop() const { return loop_; }
+    const std::string& name() const { return name_; }
+
+    //连接断开以后是否自动重连
+    bool retry() const { return retry_; }
+    void enableRetry() { retry_ = true; }
+
+    void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
+    void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
+    void setWriteCompleteCallback(const WriteCompleteCallback &cb) { writeCompleteCallback_ = cb; }
+
+private:
+    void newConnection(int sockfd); //Connector连接成功的回调
+    void removeConnection(const TcpConnectionPtr &conn);
+
+    EventLoop *loop_;
+    ConnectorPtr connector_;
+    const std::string name_;
+
+    ConnectionCallback connectionCallback_;
+    MessageCallback messageCallback_;
+    WriteCompleteCallback writeCompleteCallback_;
+
+    std::atomic_bool retry_;
+    std::atomic_bool connect_;
+    int nextConnId_; //只在loop线程中访问
+    mutable std::mutex mutex_;
+    TcpConnectionPtr connection_; //被mutex_保护
+};
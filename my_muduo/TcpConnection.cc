@@ -3,6 +3,11 @@
 #include "Socket.h"
 #include "Channel.h"
 #include "EventLoop.h"
+#include "MemoryBudget.h"
+#include "Histogram.h"
+#include "Tracer.h"
+#include "StallWatchdog.h"
+#include "Strand.h"
 
 #include <functional>
 #include <errno.h>
@@ -12,6 +17,18 @@
 #include <strings.h>
 #include <netinet/tcp.h>
 #include <string>
+#include <unordered_set>
+#include <time.h>
+
+//当前loop线程上所有已建立的连接，one loop per thread，所以线程局部就是loop局部
+//超出内存预算时用来找缓冲最多的连接
+static thread_local std::unordered_set<TcpConnection*> t_loopConnections;
+
+//每轮事件循环每个loop最多强制关闭一个连接
+static thread_local uint64_t t_lastCloseIteration = 0;
+
+//这个loop上是否已经启动了TCP_INFO采样的定时器
+static thread_local bool t_tcpInfoSampling = false;
 
 static EventLoop *CheckLoopNotNull(EventLoop* loop)
 {
@@ -22,6 +39,14 @@ static EventLoop *CheckLoopNotNull(EventLoop* loop)
     return loop;
 }
 
+//只在loop设置了messageHistogram时才取时间，不设置没有额外开销
+static int64_t monotonicNanos()
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
 TcpConnection::TcpConnection(EventLoop *loop,
             const std::string &nameArg,
             int sockfd,
@@ -36,6 +61,15 @@ TcpConnection::TcpConnection(EventLoop *loop,
         , localAddr_(localAddr)
         , peerAddr_(peerAddr)
         , highWaterMark_(64*1024*1024) //64M
+        , corked_(false)
+        , flushPending_(false)
+        , backpressureHigh_(0)
+        , backpressureLow_(0)
+        , backpressureOnPeer_(false)
+        , backpressurePaused_(false)
+        , accountedBytes_(0)
+        , budgetPaused_(false)
+        , inHighWater_(false)
         {
             //下面给channel设置相应的回调函数
             //poller给channel通知感兴趣的事件发生了
@@ -70,14 +104,43 @@ void TcpConnection::send(const std::string &buf) //直接引用buffer
         }
         else
         {
-            loop_->runInLoop(std::bind(&TcpConnection::sendInLoop
-                                , this
-                                , buf.c_str()
-                                , buf.size()
+            //buf属于调用方，等loop线程执行的时候可能已经析构了，所以要拷贝一份
+            loop_->runInLoop(std::bind(&TcpConnection::sendStringInLoop
+                                , shared_from_this()
+                                , buf
+            ));
+        }
+    }
+}
+
+void TcpConnection::setTcpNoDelay(bool on)
+{
+    socket_->setTcpNoDelay(on);
+}
+
+void TcpConnection::send(Buffer *buf)
+{
+    if(state_ == kConnected)
+    {
+        if(loop_->isInLoopThread())
+        {
+            sendInLoop(buf->peek(),buf->readableBytes());
+            buf->retrieveAll();
+        }
+        else
+        {
+            loop_->runInLoop(std::bind(&TcpConnection::sendStringInLoop
+                                , shared_from_this()
+                                , buf->retrieveAllAsString()
             ));
         }
     }
 }
+
+void TcpConnection::sendStringInLoop(const std::string &message)
+{
+    sendInLoop(message.data(),message.size());
+}
 /**
  * 发送数据，应用写得快，内核发送数据慢，
  * 需要把待发送的数据写入缓冲区
@@ -95,13 +158,17 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
         LOG_ERROR("disconnected,give up writing!");
         return ;
     }
+    ++stats_.messagesSent;
 
     //channel 第一次开始写数据，且缓冲区没有待发送数据
-    if(!channel_->isWriting() && outputBuffer_.readableBytes() == 0)
+    //cork模式下不直接写，先攒到outputBuffer_里面，本轮事件循环结束时统一发送
+    if(!corked_ && !channel_->isWriting() && outputBuffer_.readableBytes() == 0)
     {
         nwrote = ::write(channel_->fd(),data,len);
         if(nwrote >= 0)
         {
+            stats_.bytesWritten += nwrote;
+            LoopMetrics::add(loop_->metrics().bytesWritten, nwrote);
             remaining = len - nwrote;
             if(remaining == 0 && writeCompleteCallback_)
             {
@@ -113,7 +180,11 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
         else
         {
             nwrote = 0;
-            if(errno != EWOULDBLOCK) //用于非阻塞模式，不需要重新读或者写
+            if(errno == EWOULDBLOCK)
+            {
+                ++stats_.writeEagain;
+            }
+            else //用于非阻塞模式，不需要重新读或者写
             {
                 LOG_ERROR("TcpConnection::sendInLoop");
                 if(errno == EPIPE || errno == ECONNRESET) //SIGPIPE RESET
@@ -135,17 +206,65 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
         size_t oldlen = outputBuffer_.readableBytes();
         if(oldlen + remaining >= highWaterMark_ 
             && oldlen < highWaterMark_
-            && highWaterMark_)
+            && highWaterMark_
+            && highWaterMarkCallback_)
             {
                 loop_->queueInLoop(
                     std::bind(highWaterMarkCallback_,shared_from_this(),oldlen + remaining)
                 );
             }
             outputBuffer_.append((char*)data + nwrote,remaining);
-            if(!channel_->isWriting())
+            pauseSourceIfNeeded();
+            if(channel_->isWriting())
+            {
+                //已经在等epollout了，handleWrite会把新追加的数据一起发出去
+            }
+            else if(corked_)
+            {
+                //本轮只注册一次flush，后面的send只追加数据
+                if(!flushPending_)
+                {
+                    flushPending_ = true;
+                    loop_->queueFlush(
+                        std::bind(&TcpConnection::flushInLoop,shared_from_this()));
+                }
+            }
+            else
             {
                 channel_->enableWriting(); //注册channel写事件，否则poller不会向channel通知epollout
             }
+            trackOutputBuffer();
+            updateBufferAccounting();
+    }
+}
+
+//用户直接往outputBuffer_里追加了数据，按sendInLoop的规则把它发出去
+void TcpConnection::sendOutputBuffer()
+{
+    if(state_ == kDisconnected || outputBuffer_.readableBytes() == 0)
+    {
+        return;
+    }
+    ++stats_.messagesSent;
+    pauseSourceIfNeeded();
+    trackOutputBuffer();
+    updateBufferAccounting();
+    if(channel_->isWriting())
+    {
+        return; //handleWrite会发送
+    }
+    if(corked_)
+    {
+        if(!flushPending_)
+        {
+            flushPending_ = true;
+            loop_->queueFlush(
+                std::bind(&TcpConnection::flushInLoop,shared_from_this()));
+        }
+    }
+    else
+    {
+        flushInLoop();
     }
 }
 
@@ -155,9 +274,26 @@ void TcpConnection::handleRead(TimeStamp receiveTime)
     ssize_t n = inputBuffer_.readFd(channel_->fd(),&savedErrno);
     if(n > 0)
     {
+        stats_.bytesRead += n;
+        LoopMetrics::add(loop_->metrics().bytesRead, n);
+        ++stats_.messagesRead;
+        loop_->consumeReadBudget(n); //计入本轮事件循环的读预算
         //已建立连接的用户，有可读事件发生了，调用用户传入的回调操作onMessage
         //shared_from_this()获取了当前TcpConnection对象的智能指针
-        messageCallback_(shared_from_this(),&inputBuffer_,receiveTime);
+        TraceSpan span("messageCallback", channel_->fd());
+        LoopActivity activity(loop_, "messageCallback", channel_->fd());
+        Histogram *histogram = loop_->messageHistogram();
+        if(histogram)
+        {
+            int64_t start = monotonicNanos();
+            messageCallback_(shared_from_this(),&inputBuffer_,receiveTime);
+            histogram->record(monotonicNanos() - start);
+        }
+        else
+        {
+            messageCallback_(shared_from_this(),&inputBuffer_,receiveTime);
+        }
+        updateBufferAccounting();
     }
     else if(n==0) //客户端断开
     {
@@ -165,6 +301,10 @@ void TcpConnection::handleRead(TimeStamp receiveTime)
     } 
     else
     {
+        if(savedErrno == EAGAIN)
+        {
+            ++stats_.readEagain;
+        }
         errno = savedErrno;
         LOG_ERROR("TcpConnection::hanleRead");
         handleError();
@@ -180,7 +320,12 @@ void TcpConnection::handleWrite()
         ssize_t n = outputBuffer_.writeFd(channel_->fd(),&savedErrno);
         if(n > 0)
         {
+            stats_.bytesWritten += n;
+            LoopMetrics::add(loop_->metrics().bytesWritten, n);
             outputBuffer_.retrieve(n); //处理了n个
+            resumeSourceIfNeeded();
+            trackOutputBuffer();
+            updateBufferAccounting();
             if(outputBuffer_.readableBytes() == 0) //发送完成
             {
                 channel_->disableWriting(); //不可写了
@@ -199,6 +344,10 @@ void TcpConnection::handleWrite()
         }
         else
         {
+            if(savedErrno == EAGAIN)
+            {
+                ++stats_.writeEagain;
+            }
             LOG_ERROR("TcpConnection::handleWrite");
         }
     }
@@ -214,9 +363,25 @@ void TcpConnection::handleClose()
     LOG_INFO("TcpConnection::handleClose fd=%d state=%d \n",channel_->fd(),(int)state_);
     setState(kDisconnected);
     channel_->disableAll();
+    releaseBufferAccounting();
+
+    //连接没了，被它暂停读的对端要恢复，否则对端永远不会再读
+    if(backpressurePaused_ && backpressureOnPeer_)
+    {
+        backpressurePaused_ = false;
+        TcpConnectionPtr source = backpressurePeer_.lock();
+        if(source)
+        {
+            source->startRead();
+        }
+    }
 
     TcpConnectionPtr connPtr(shared_from_this());
-    connectionCallback_(connPtr); //执行连接关闭的回调
+    {
+        TraceSpan span("connectionCallback", channel_->fd());
+        LoopActivity activity(loop_, "connectionCallback", channel_->fd());
+        connectionCallback_(connPtr); //执行连接关闭的回调
+    }
     closeCallback_(connPtr); //关闭连接的回调 TcpServer => TcpServer::removeConnection
 }
 
@@ -252,21 +417,387 @@ void TcpConnection::shutdown()
 
 void TcpConnection::shutdownInLoop()
 {
-    if(!channel_->isWriting()) //说明当前outputBuffer中的数据已经全部发送完成
+    //说明当前outputBuffer中的数据已经全部发送完成
+    //cork模式下还有数据等着本轮末尾flush，由flushInLoop发送完以后再关闭写端
+    if(!channel_->isWriting() && !flushPending_)
     {
         socket_->shutdowmWrite(); // 关闭写端
 
     }
 }
 
+void TcpConnection::startRead()
+{
+    loop_->runInLoop(std::bind(&TcpConnection::startReadInLoop,shared_from_this()));
+}
+
+void TcpConnection::stopRead()
+{
+    loop_->runInLoop(std::bind(&TcpConnection::stopReadInLoop,shared_from_this()));
+}
+
+void TcpConnection::startReadInLoop()
+{
+    if(state_ == kDisconnected)
+    {
+        return;
+    }
+    if(!reading_ || !channel_->isReading())
+    {
+        channel_->enableReading();
+        reading_ = true;
+    }
+}
+
+void TcpConnection::stopReadInLoop()
+{
+    if(state_ == kDisconnected)
+    {
+        return;
+    }
+    if(reading_ || channel_->isReading())
+    {
+        channel_->disableReading();
+        reading_ = false;
+    }
+}
+
+void TcpConnection::setReadBackpressure(size_t highWaterMark, size_t lowWaterMark,
+                        const TcpConnectionPtr &source)
+{
+    backpressureHigh_ = highWaterMark;
+    backpressureLow_ = lowWaterMark < highWaterMark ? lowWaterMark : highWaterMark / 2;
+    backpressureOnPeer_ = source && source.get() != this;
+    backpressurePeer_ = backpressureOnPeer_ ? source : TcpConnectionPtr();
+}
+
+TcpConnectionPtr TcpConnection::backpressureSource()
+{
+    return backpressureOnPeer_ ? backpressurePeer_.lock() : shared_from_this();
+}
+
+//下游消费太慢，outputBuffer_越堆越多，先停掉数据的来源
+void TcpConnection::pauseSourceIfNeeded()
+{
+    if(backpressureHigh_ > 0
+        && !backpressurePaused_
+        && outputBuffer_.readableBytes() >= backpressureHigh_)
+    {
+        TcpConnectionPtr source = backpressureSource();
+        if(source)
+        {
+            backpressurePaused_ = true;
+            source->stopRead();
+        }
+    }
+}
+
+//outputBuffer_发到低水位以下了，恢复数据来源的读
+void TcpConnection::resumeSourceIfNeeded()
+{
+    if(backpressurePaused_ && outputBuffer_.readableBytes() <= backpressureLow_)
+    {
+        backpressurePaused_ = false;
+        TcpConnectionPtr source = backpressureSource();
+        //自己还因为全局内存预算暂停着，等预算恢复的时候再读
+        if(source && (backpressureOnPeer_ || !budgetPaused_))
+        {
+            source->startRead();
+        }
+    }
+}
+
+void TcpConnection::forceClose()
+{
+    if(state_ == kConnected || state_ == kDisconnecting)
+    {
+        setState(kDisconnecting);
+        loop_->queueInLoop(std::bind(&TcpConnection::forceCloseInLoop,shared_from_this()));
+    }
+}
+
+void TcpConnection::forceCloseInLoop()
+{
+    if(state_ == kConnected || state_ == kDisconnecting)
+    {
+        handleClose(); //和对端关闭一样处理
+    }
+}
+
+void TcpConnection::trackOutputBuffer()
+{
+    size_t bytes = outputBuffer_.readableBytes();
+    if(bytes > stats_.maxOutputBufferBytes)
+    {
+        stats_.maxOutputBufferBytes = bytes;
+    }
+    bool above = highWaterMark_ > 0 && bytes >= highWaterMark_;
+    if(above != inHighWater_)
+    {
+        //只在越过高水位的时候取一次时间
+        TimeStamp now(TimeStamp::now());
+        if(above)
+        {
+            highWaterSince_ = now;
+        }
+        else
+        {
+            stats_.highWaterMicros += now.microSecondsSinceEpoch() - highWaterSince_.microSecondsSinceEpoch();
+        }
+        inHighWater_ = above;
+    }
+}
+
+const std::shared_ptr<Strand>& TcpConnection::strand()
+{
+    if(!strand_)
+    {
+        strand_ = std::make_shared<Strand>(loop_);
+    }
+    return strand_;
+}
+
+ConnectionStats TcpConnection::stats() const
+{
+    ConnectionStats result(stats_);
+    result.name = name_;
+    result.peer = peerAddr_.toIpPort();
+    result.outputBufferBytes = outputBuffer_.readableBytes();
+    if(inHighWater_)
+    {
+        result.highWaterMicros += TimeStamp::now().microSecondsSinceEpoch() - highWaterSince_.microSecondsSinceEpoch();
+    }
+    return result;
+}
+
+void TcpConnection::sampleTcpInfo()
+{
+    struct tcp_info info;
+    if(!socket_->getTcpInfo(&info))
+    {
+        return;
+    }
+    stats_.tcpInfoTime = TimeStamp::now();
+    stats_.rttMicros = info.tcpi_rtt;
+    stats_.rttVarMicros = info.tcpi_rttvar;
+    stats_.sendCwnd = info.tcpi_snd_cwnd;
+    stats_.unacked = info.tcpi_unacked;
+    stats_.lost = info.tcpi_lost;
+    stats_.retransmits = info.tcpi_retransmits;
+    stats_.totalRetrans = info.tcpi_total_retrans;
+}
+
+void TcpConnection::forEachConnection(EventLoop *loop, const std::function<void(const TcpConnectionPtr&)> &cb)
+{
+    if(!loop->isInLoopThread())
+    {
+        LOG_ERROR("%s:%s:%d forEachConnection called outside its loop thread \n",__FILE__,__FUNCTION__,__LINE__);
+        return;
+    }
+    //先拿到所有连接的引用再回调，回调里关闭连接不会影响遍历
+    std::vector<TcpConnectionPtr> conns;
+    conns.reserve(t_loopConnections.size());
+    for(TcpConnection *conn : t_loopConnections)
+    {
+        conns.push_back(conn->shared_from_this());
+    }
+    for(const TcpConnectionPtr &conn : conns)
+    {
+        cb(conn);
+    }
+}
+
+void TcpConnection::collectStats(EventLoop *loop, const StatsCallback &done)
+{
+    loop->runInLoop([loop, done]() {
+        std::vector<ConnectionStats> result;
+        result.reserve(t_loopConnections.size());
+        for(TcpConnection *conn : t_loopConnections)
+        {
+            result.push_back(conn->stats());
+        }
+        done(std::move(result));
+    });
+}
+
+void TcpConnection::startTcpInfoSampling(EventLoop *loop, double interval)
+{
+    loop->runInLoop([loop, interval]() {
+        if(t_tcpInfoSampling)
+        {
+            return;
+        }
+        t_tcpInfoSampling = true;
+        loop->runEvery(interval, []() {
+            for(TcpConnection *conn : t_loopConnections)
+            {
+                conn->sampleTcpInfo();
+            }
+        });
+    });
+}
+
+//缓冲区读空以后，底层内存超过这个值才缩回去，小的缓冲区留着复用，避免每次突发都重新分配
+static const size_t kShrinkThreshold = 64 * 1024;
+
+static void shrinkIfDrained(Buffer *buf)
+{
+    if(buf->readableBytes() == 0 && buf->internalCapacity() > kShrinkThreshold)
+    {
+        buf->shrinkIfEmpty();
+    }
+}
+
+//把两个缓冲区实际占用内存的变化量记到loop的账上；数据发完/读完以后容量还在，按容量记才是真实的内存
+void TcpConnection::updateBufferAccounting()
+{
+    shrinkIfDrained(&inputBuffer_);
+    shrinkIfDrained(&outputBuffer_);
+    int64_t bytes = static_cast<int64_t>(inputBuffer_.internalCapacity() + outputBuffer_.internalCapacity());
+    if(bytes != accountedBytes_)
+    {
+        loop_->addBufferedBytes(bytes - accountedBytes_);
+        accountedBytes_ = bytes;
+    }
+    if(loop_->overMemoryBudget())
+    {
+        enforceMemoryBudget();
+    }
+}
+
+//连接关闭以后不再占预算
+void TcpConnection::releaseBufferAccounting()
+{
+    if(accountedBytes_ != 0)
+    {
+        loop_->addBufferedBytes(-accountedBytes_);
+        accountedBytes_ = 0;
+    }
+}
+
+//全局缓冲超出预算了，按策略处理
+void TcpConnection::enforceMemoryBudget()
+{
+    if(state_ != kConnected)
+    {
+        return;
+    }
+
+    if(MemoryBudget::hasPolicy(MemoryBudget::kPauseReading) && !budgetPaused_)
+    {
+        budgetPaused_ = true;
+        stopReadInLoop();
+        std::weak_ptr<TcpConnection> weakConn(shared_from_this());
+        loop_->runWhenUnderBudget([weakConn]()
+        {
+            TcpConnectionPtr conn = weakConn.lock();
+            if(conn && conn->budgetPaused_)
+            {
+                conn->budgetPaused_ = false;
+                //还因为自己的背压暂停着就继续等输出缓冲降下来
+                if(!conn->backpressurePaused_ || conn->backpressureOnPeer_)
+                {
+                    conn->startReadInLoop();
+                }
+            }
+        });
+    }
+
+    if(MemoryBudget::hasPolicy(MemoryBudget::kCloseLargest)
+        && t_lastCloseIteration != loop_->iteration())
+    {
+        t_lastCloseIteration = loop_->iteration();
+        TcpConnection *largest = nullptr;
+        for(TcpConnection *conn : t_loopConnections)
+        {
+            if(largest == nullptr || conn->accountedBytes_ > largest->accountedBytes_)
+            {
+                largest = conn;
+            }
+        }
+        if(largest != nullptr && largest->accountedBytes_ > 0)
+        {
+            LOG_ERROR("TcpConnection::enforceMemoryBudget close [%s] buffered %ld bytes, total %ld \n",
+                largest->name_.c_str(),(long)largest->accountedBytes_,(long)MemoryBudget::totalBytes());
+            largest->forceClose();
+        }
+    }
+}
+
+/**
+ * cork模式下，本轮事件循环里所有的send都只追加到了outputBuffer_，
+ * 这里在loop末尾用一次write把它们一起发出去，没发完的再注册epollout
+*/
+void TcpConnection::flushInLoop()
+{
+    flushPending_ = false;
+    if(state_ == kDisconnected || channel_->isWriting())
+    {
+        //连接已经断开，或者已经在等epollout由handleWrite负责发送
+        return;
+    }
+
+    int savedErrno = 0;
+    ssize_t n = outputBuffer_.writeFd(channel_->fd(),&savedErrno);
+    if(n > 0)
+    {
+        stats_.bytesWritten += n;
+        LoopMetrics::add(loop_->metrics().bytesWritten, n);
+        outputBuffer_.retrieve(n);
+        resumeSourceIfNeeded();
+        trackOutputBuffer();
+        updateBufferAccounting();
+    }
+    else if(n < 0 && savedErrno == EWOULDBLOCK)
+    {
+        ++stats_.writeEagain;
+    }
+    else if(n < 0)
+    {
+        errno = savedErrno;
+        LOG_ERROR("TcpConnection::flushInLoop");
+        if(savedErrno == EPIPE || savedErrno == ECONNRESET)
+        {
+            return;
+        }
+    }
+
+    if(outputBuffer_.readableBytes() == 0)
+    {
+        if(writeCompleteCallback_)
+        {
+            loop_->queueInLoop(
+                std::bind(writeCompleteCallback_,shared_from_this()));
+        }
+        if(state_ == kDisconnecting)
+        {
+            shutdownInLoop();
+        }
+    }
+    else
+    {
+        channel_->enableWriting(); //一次没写完，剩下的交给handleWrite
+    }
+}
+
 //建立连接
 void TcpConnection::connectEstablished()
 {
     setState(kConnected);
+    stats_.established = TimeStamp::now();
+    if(loop_->busyPollMicros() > 0)
+    {
+        socket_->setBusyPoll(loop_->busyPollMicros());
+    }
     channel_->tie(shared_from_this());
     channel_->enableReading(); //向poller注册channel的epollin事件
+    t_loopConnections.insert(this);
+    LoopMetrics::add(loop_->metrics().connectionsEstablished, 1);
+    updateBufferAccounting(); //空闲连接的两个初始缓冲区也占内存
 
     //新连接建立 执行回调
+    TraceSpan span("connectionCallback", channel_->fd());
+    LoopActivity activity(loop_, "connectionCallback", channel_->fd());
     connectionCallback_(shared_from_this());
 }
 
@@ -279,5 +810,8 @@ void TcpConnection::connectDestroyed()
         channel_->disableAll(); //把channel所有感兴趣的事件，从poller中del掉
         connectionCallback_(shared_from_this());
     }
+    releaseBufferAccounting();
+    t_loopConnections.erase(this);
+    LoopMetrics::add(loop_->metrics().connectionsClosed, 1);
     channel_->remove();//把channel从poller中删除掉
 }
\ No newline at end of file
@@ -5,14 +5,18 @@
 #include "Callbacks.h"
 #include "Buffer.h"
 #include "TimeStamp.h"
+#include "ConnectionStats.h"
 
 #include <memory>
 #include <string>
 #include <atomic>
+#include <vector>
+#include <functional>
 
 class Channel;
 class EventLoop;
 class Socket;
+class Strand;
 
 /**
  * TcpServer 通过Acceptor 有一个新用户连接，通过accept函数拿到connfd
@@ -39,10 +43,25 @@ public:
 
     //发送数据
     void send(const std::string &buf);
+    //发送buf里的可读数据，发送以后buf被清空
+    void send(Buffer *buf);
+
+    //直接把数据序列化到输出缓冲区，省掉一次中间拷贝，追加完以后调用sendOutputBuffer
+    //这两个都只能在loop线程中调用
+    Buffer* outputBuffer() { return &outputBuffer_; }
+    void sendOutputBuffer();
 
     //关闭连接
     void shutdown();
 
+    //不等数据发完，直接关闭连接
+    void forceClose();
+
+    //暂停/恢复读，暂停期间数据留在内核接收缓冲区，由tcp的滑动窗口限制对端发送速度
+    void startRead();
+    void stopRead();
+    bool isReading() const { return reading_; }
+
     void setConnectionCallback(const ConnectionCallback& cb)
     {
         connectionCallback_ = cb;
@@ -69,6 +88,47 @@ public:
         closeCallback_ = cb;
     }
 
+    //cork模式：loop线程内的send只追加到outputBuffer_，
+    //等到本轮事件循环结束时统一写一次，减少小包的系统调用次数
+    void setCorked(bool on) { corked_ = on; }
+    bool corked() const { return corked_; }
+
+    //关闭Nagle算法，小消息的请求应答（比如pingpong）不用等ack
+    void setTcpNoDelay(bool on);
+
+    //读背压：outputBuffer_超过highWaterMark时暂停source的读，降到lowWaterMark以下时恢复
+    //source为空表示暂停自己的读；代理场景下传入对端连接，本连接的输出就是对端的输入
+    //highWaterMark为0表示关闭，需要在loop线程中设置（比如connectionCallback里）
+    void setReadBackpressure(size_t highWaterMark, size_t lowWaterMark,
+                        const TcpConnectionPtr &source = TcpConnectionPtr());
+
+    //用户给连接保存的上下文，比如协议解析器的状态
+    void setContext(const std::shared_ptr<void> &context) { context_ = context; }
+    const std::shared_ptr<void>& getContext() const { return context_; }
+
+    //连接的串行执行器，第一次调用时创建，continuation回到这个连接的loop；只在loop线程中调用
+    //同一个连接上的请求post进去按顺序在计算线程池里执行，应答按请求顺序发出
+    const std::shared_ptr<Strand>& strand();
+
+    //两个缓冲区一共占用多少内存（容量，最近一次记账的值），只在loop线程中调用
+    int64_t bufferedBytes() const { return accountedBytes_; }
+
+    //流量统计的快照，只在loop线程中调用
+    ConnectionStats stats() const;
+    //立刻采样一次TCP_INFO，只在loop线程中调用
+    void sampleTcpInfo();
+
+    //遍历loop上所有已建立的连接（包括TcpServer和TcpClient的），只在这个loop线程中调用
+    static void forEachConnection(EventLoop *loop, const std::function<void(const TcpConnectionPtr&)> &cb);
+
+    //在loop线程里生成所有连接的快照，再在loop线程里调用done，可以在任意线程调用
+    //每个loop各自生成，不需要停住别的loop
+    using StatsCallback = std::function<void(std::vector<ConnectionStats>&&)>;
+    static void collectStats(EventLoop *loop, const StatsCallback &done);
+
+    //在loop上启动定时器，每隔interval秒给所有连接采样一次TCP_INFO，同一个loop只启动一次
+    static void startTcpInfoSampling(EventLoop *loop, double interval);
+
     //建立连接
     void connectEstablished();
 
@@ -87,9 +147,30 @@ private:
     void handleError();
 
     void sendInLoop(const void* message, size_t len);
+    void sendStringInLoop(const std::string &message); //跨线程发送时数据拷贝一份带过来
 
     void shutdownInLoop();
 
+    void flushInLoop(); //cork模式下，本轮事件循环末尾把outputBuffer_一次性写出去
+
+    void startReadInLoop();
+    void stopReadInLoop();
+
+    //outputBuffer_变大/变小以后检查读背压
+    void pauseSourceIfNeeded();
+    void resumeSourceIfNeeded();
+    TcpConnectionPtr backpressureSource();
+
+    void forceCloseInLoop();
+
+    //outputBuffer_变化以后更新最大深度和高水位时间
+    void trackOutputBuffer();
+
+    //缓冲区大小变化以后更新所属loop的内存记账，超出全局预算时按策略处理
+    void updateBufferAccounting();
+    void releaseBufferAccounting();
+    void enforceMemoryBudget();
+
     EventLoop *loop_; //绝对不是baseloop，因为TcpConnetion都是在subloop中管理的
     const std::string name_;
     std::atomic_int state_;
@@ -107,10 +188,29 @@ private:
     HighWaterMarkCallback highWaterMarkCallback_;
 
     size_t highWaterMark_;
+
+    bool corked_; //是否开启cork模式
+    bool flushPending_; //已经向loop注册了本轮的flush回调
+
+    size_t backpressureHigh_; //读背压的高水位，0表示关闭
+    size_t backpressureLow_; //读背压的低水位
+    bool backpressureOnPeer_; //暂停的是不是对端连接
+    std::weak_ptr<TcpConnection> backpressurePeer_; //代理场景下被暂停读的对端连接
+    bool backpressurePaused_; //当前是否因为背压暂停了读
+
+    int64_t accountedBytes_; //已经记到loop账上的缓冲区容量
+    bool budgetPaused_; //当前是否因为全局内存预算暂停了读
+
+    ConnectionStats stats_; //流量统计，name和peer在取快照的时候才填
+    bool inHighWater_; //outputBuffer_当前是否在高水位以上
+    TimeStamp highWaterSince_; //这一次越过高水位的时间
     
     Buffer inputBuffer_; //接受数据的缓冲区
     Buffer outputBuffer_; //发送数据的缓冲区
 
+    std::shared_ptr<void> context_;
+    std::shared_ptr<Strand> strand_;
+
 
 
 
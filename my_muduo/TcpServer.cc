@@ -5,6 +5,9 @@
 
 #include <functional>
 #include <strings.h>
+#include <mutex>
+#include <vector>
+#include <iterator>
 
 static EventLoop *CheckLoopNotNull(EventLoop* loop)
 {
@@ -27,14 +30,45 @@ TcpServer::TcpServer(EventLoop *loop,
             , threadPool_(new EventLoopThreadPool(loop,name_))
             , connectionCallback_()
             , messageCallback_()
-            , nextConnId_(1)
+            , highWaterMark_(64*1024*1024)
             , started_(0)
+            , metrics_(nameArg)
+            , nextConnId_(1)
+            , corked_(false)
+            , backpressureHigh_(0)
+            , backpressureLow_(0)
+            , tcpInfoInterval_(0)
+            , draining_(false)
 {
     //当新用户连接时，会执行TcpServer::newConnection回调
     acceptor_->setNewConnetionCallback(std::bind(&TcpServer::newConnection, this,
         std::placeholders::_1,std::placeholders::_2));
 }
 
+TcpServer::TcpServer(EventLoop *loop,
+            int listenFd,
+            const std::string &nameArg)
+            : loop_(CheckLoopNotNull(loop))
+            , ipPort_(InetAddress::getLocalAddr(listenFd).toIpPort())
+            , name_(nameArg)
+            , acceptor_(new Acceptor(loop,listenFd))
+            , threadPool_(new EventLoopThreadPool(loop,name_))
+            , connectionCallback_()
+            , messageCallback_()
+            , highWaterMark_(64*1024*1024)
+            , started_(0)
+            , metrics_(nameArg)
+            , nextConnId_(1)
+            , corked_(false)
+            , backpressureHigh_(0)
+            , backpressureLow_(0)
+            , tcpInfoInterval_(0)
+            , draining_(false)
+{
+    acceptor_->setNewConnetionCallback(std::bind(&TcpServer::newConnection, this,
+        std::placeholders::_1,std::placeholders::_2));
+}
+
 
 TcpServer::~TcpServer()
 {
@@ -56,7 +90,7 @@ void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
 {
     //轮询算法，选择一个subloop，来管理channel
     EventLoop *ioLoop = threadPool_->getNextLoop();
-    char buf[64] = {0};
+    char buf[256] = {0}; //Unix域地址的路径最长108字节
     snprintf(buf, sizeof buf,"-%s#%d",ipPort_.c_str(),nextConnId_);
     ++nextConnId_;
     std::string connName = name_ + buf;
@@ -65,14 +99,7 @@ void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
                 name_.c_str(),connName.c_str(),peerAddr.toIpPort().c_str());
 
     //通过socket获取其绑定的本机的ip地址和端口信息
-    sockaddr_in local;
-    ::bzero(&local,sizeof local);
-    socklen_t addrlen = sizeof local;
-    if(::getsockname(sockfd,(sockaddr*) &local,&addrlen) < 0)
-    {
-        LOG_ERROR("sockets::getLocalAddr");
-    }
-    InetAddress localAddr(local);
+    InetAddress localAddr(InetAddress::getLocalAddr(sockfd));
 
     //根据连接成功的sockfd，创建 TcpConnection连接对象conn
     TcpConnectionPtr conn(new TcpConnection(
@@ -84,9 +111,20 @@ void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
 
     //下面的回调都是用户设置给TcpServer=>TcpConnection=>Channel=>Poller=>notify channel调用回调
     connections_[connName] = conn;
+    LoopMetrics::add(metrics_.connectionsAccepted, 1);
+    LoopMetrics::add(metrics_.activeConnections, 1);
     conn->setConnectionCallback(connectionCallback_);
     conn->setMessageCallback(messageCallback_);
     conn->setWriteCompleteCallback(writeCompleteCallback_);
+    conn->setCorked(corked_);
+    if(highWaterMarkCallback_)
+    {
+        conn->setHighWaterMarkCallback(highWaterMarkCallback_,highWaterMark_);
+    }
+    if(backpressureHigh_ > 0)
+    {
+        conn->setReadBackpressure(backpressureHigh_,backpressureLow_);
+    }
 
     //设置了如何关闭连接的回调 conn->shutdown
     conn->setCloseCallback(
@@ -111,10 +149,100 @@ void TcpServer::start()
     if(started_++ == 0) //防止一个TcpServer对象被start多次
     {
         threadPool_->start(threadInitCallback_);
+        if(tcpInfoInterval_ > 0)
+        {
+            for(EventLoop *ioLoop : threadPool_->getAllLoops())
+            {
+                TcpConnection::startTcpInfoSampling(ioLoop,tcpInfoInterval_);
+            }
+        }
         loop_->runInLoop(std::bind(&Acceptor::listen,acceptor_.get()));
     }
 }
 
+void TcpServer::stopAccepting()
+{
+    loop_->runInLoop(std::bind(&Acceptor::stopListening,acceptor_.get()));
+}
+
+void TcpServer::drain(double deadlineSeconds, const std::function<void()> &done)
+{
+    loop_->runInLoop(std::bind(&TcpServer::drainInLoop,this,deadlineSeconds,done));
+}
+
+void TcpServer::drainInLoop(double deadlineSeconds, const std::function<void()> &done)
+{
+    acceptor_->stopListening();
+    if(draining_)
+    {
+        return;
+    }
+    draining_ = true;
+    drainCallback_ = done;
+    LOG_INFO("TcpServer::drain [%s] - %d connections, deadline %.1fs \n",
+        name_.c_str(),(int)connections_.size(),deadlineSeconds);
+    if(connections_.empty())
+    {
+        drainFinished();
+        return;
+    }
+    drainTimer_ = loop_->runAfter(deadlineSeconds, std::bind(&TcpServer::drainDeadline,this));
+}
+
+//到期还没关的连接强制关闭，关闭完成以后removeConnectionInLoop会调用drainFinished
+void TcpServer::drainDeadline()
+{
+    LOG_INFO("TcpServer::drain [%s] - deadline reached, force closing %d connections \n",
+        name_.c_str(),(int)connections_.size());
+    drainTimer_ = TimerId();
+    for(auto &item : connections_)
+    {
+        item.second->forceClose();
+    }
+}
+
+void TcpServer::drainFinished()
+{
+    loop_->cancel(drainTimer_);
+    std::function<void()> done;
+    done.swap(drainCallback_);
+    if(done)
+    {
+        done();
+    }
+}
+
+void TcpServer::collectConnectionStats(const TcpConnection::StatsCallback &done)
+{
+    //几个loop并发地往同一个结果里追加，最后一个完成的负责回调
+    struct Collector
+    {
+        std::mutex mutex;
+        std::vector<ConnectionStats> stats;
+        size_t remaining;
+    };
+    std::vector<EventLoop*> loops = threadPool_->getAllLoops();
+    std::shared_ptr<Collector> collector = std::make_shared<Collector>();
+    collector->remaining = loops.size();
+    for(EventLoop *ioLoop : loops)
+    {
+        TcpConnection::collectStats(ioLoop, [collector, done](std::vector<ConnectionStats> &&stats) {
+            std::vector<ConnectionStats> all;
+            {
+                std::lock_guard<std::mutex> lock(collector->mutex);
+                collector->stats.insert(collector->stats.end(),
+                    std::make_move_iterator(stats.begin()),std::make_move_iterator(stats.end()));
+                if(--collector->remaining > 0)
+                {
+                    return;
+                }
+                all.swap(collector->stats);
+            }
+            done(std::move(all));
+        });
+    }
+}
+
 
 void TcpServer::removeConnection(const TcpConnectionPtr &conn)
 {
@@ -130,9 +258,14 @@ void TcpServer::removeConnectionInLoop(const TcpConnectionPtr &conn)
         name_.c_str(),conn->name().c_str());
 
     connections_.erase(conn->name()); //从map表中删除
+    LoopMetrics::add(metrics_.activeConnections, -1);
     EventLoop *ioLoop = conn->getLoop();
     ioLoop->queueInLoop(
         std::bind(&TcpConnection::connectDestroyed,conn)
     );
+    if(draining_ && connections_.empty())
+    {
+        drainFinished();
+    }
 
 }
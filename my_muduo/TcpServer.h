@@ -36,24 +36,66 @@ public:
             const InetAddress &listenAddr,
             const std::string  &nameArg,
             Option option = kNoReusePort);
+    //热重启：接管旧进程交过来的监听fd（见HotRestart），地址就是这个fd绑定的地址
+    TcpServer(EventLoop *loop,
+            int listenFd,
+            const std::string &nameArg);
 
     ~TcpServer();
 
+    const std::string& ipPort() const { return ipPort_; }
+    const std::string& name() const { return name_; }
+    const ServerMetrics& metrics() const { return metrics_; }
+    EventLoop* getLoop() const { return loop_; }
+    int listenFd() const { return acceptor_->fd(); }
+
     void setThreadInitCallback(const ThreadInitCallback &cb) { threadInitCallback_ = cb;}
     void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb;}
     void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb;}
     void setWriteCompleteCallback(const WriteCompleteCallback &cb) {writeCompleteCallback_ = cb;}
 
+    void setHighWaterMarkCallback(const HighWaterMarkCallback &cb, size_t highWaterMark)
+    {
+        highWaterMarkCallback_ = cb;
+        highWaterMark_ = highWaterMark;
+    }
+
+    //所有连接开启读背压：outputBuffer超过highWaterMark暂停读，降到lowWaterMark以下恢复
+    void setReadBackpressure(size_t highWaterMark, size_t lowWaterMark)
+    {
+        backpressureHigh_ = highWaterMark;
+        backpressureLow_ = lowWaterMark;
+    }
+
+    //新连接是否开启cork模式（合并同一轮事件循环里的多次send）
+    void setCorked(bool on) { corked_ = on; }
+
+    //每隔seconds秒给所有连接采样一次TCP_INFO，0表示不采样，需要在start之前设置
+    void setTcpInfoInterval(double seconds) { tcpInfoInterval_ = seconds; }
+
+    //收集所有io loop上连接的流量统计，每个loop在自己的线程里生成快照，
+    //全部收齐以后在最后一个完成的loop线程里调用done；可以在任意线程调用，需要在start之后
+    void collectConnectionStats(const TcpConnection::StatsCallback &done);
+
     //设置subloop的个数
     void setThreadNum (int numThreads);
 
     //开始服务器监听
     void start();
 
+    //停止接收新连接，已有的连接不受影响；可以在任意线程调用
+    void stopAccepting();
+    //停止接收新连接，等已有的连接自己关闭，deadline秒以后还没关的强制关闭；
+    //连接全部关掉以后在baseloop里调用done。可以在任意线程调用
+    void drain(double deadlineSeconds, const std::function<void()> &done);
+
 private:
     void newConnection(int sockfd, const InetAddress &peerAddr);
     void removeConnection(const TcpConnectionPtr &conn);
     void removeConnectionInLoop(const TcpConnectionPtr &conn);
+    void drainInLoop(double deadlineSeconds, const std::function<void()> &done);
+    void drainDeadline();
+    void drainFinished();
 
     using ConnectionMap = std::unordered_map<std::string,TcpConnectionPtr>;
 
@@ -69,13 +111,24 @@ private:
     ConnectionCallback connectionCallback_; //有新连接时的回调
     MessageCallback messageCallback_; //有读写消息时的回调
     WriteCompleteCallback writeCompleteCallback_; //消息发送完成以后的回调
+    HighWaterMarkCallback highWaterMarkCallback_; //发送缓冲区超过高水位的回调
+    size_t highWaterMark_;
 
     ThreadInitCallback threadInitCallback_; //LOOP线程初始化的回调 std::function类型 调用者，调用回调函数
 
     std::atomic_int started_;
 
+    ServerMetrics metrics_; //登记在全局表里，StatsPublisher会发布
     int nextConnId_;
+    bool corked_;
+    size_t backpressureHigh_; //读背压的高水位，0表示关闭
+    size_t backpressureLow_;
+    double tcpInfoInterval_; //TCP_INFO采样间隔，0表示不采样
     ConnectionMap connections_; //保存所有的连接
 
+    bool draining_;
+    std::function<void()> drainCallback_; //连接全部关掉以后调用
+    TimerId drainTimer_;
+
 };
 
@@ -1,6 +1,7 @@
 #include "TimeStamp.h"
 #include <time.h>
 #include <stdio.h>
+#include <sys/time.h>
 
 TimeStamp::TimeStamp():microSecondsSinceEpoch_(0) {}// 默认构造
 
@@ -11,13 +12,17 @@ TimeStamp::TimeStamp(int64_t microSecondsSinceEpoch)
 
 TimeStamp TimeStamp::now()
 {
-    return TimeStamp(time(NULL));    //获取当前时间
+    //获取当前时间，精确到微秒，定时器需要比秒更细的精度
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return TimeStamp(static_cast<int64_t>(tv.tv_sec) * kMicroSecondsPerSecond + tv.tv_usec);
 }
 
 std::string TimeStamp::toString() const
 {
     char buf[128]={0};
-    tm *tm_time = localtime(&microSecondsSinceEpoch_);
+    time_t seconds = static_cast<time_t>(microSecondsSinceEpoch_ / kMicroSecondsPerSecond);
+    tm *tm_time = localtime(&seconds);
     snprintf(buf, 128, "%4d/%02d/%02d %02d:%02d:%02d",
     tm_time->tm_year+1900,
     tm_time->tm_mon+1,
@@ -13,5 +13,35 @@ public:
     TimeStamp(); //默认构造
     explicit TimeStamp(int64_t microSecondsSinceEpoch); //带参构造
     static TimeStamp now();
+    static TimeStamp invalid() { return TimeStamp(); }
     std::string toString() const; 
+
+    bool valid() const { return microSecondsSinceEpoch_ > 0; }
+    int64_t microSecondsSinceEpoch() const { return microSecondsSinceEpoch_; }
+
+    static const int kMicroSecondsPerSecond = 1000 * 1000;
 };
+
+inline bool operator<(TimeStamp lhs, TimeStamp rhs)
+{
+    return lhs.microSecondsSinceEpoch() < rhs.microSecondsSinceEpoch();
+}
+
+inline bool operator==(TimeStamp lhs, TimeStamp rhs)
+{
+    return lhs.microSecondsSinceEpoch() == rhs.microSecondsSinceEpoch();
+}
+
+//两个时间点相差多少秒
+inline double timeDifference(TimeStamp high, TimeStamp low)
+{
+    int64_t diff = high.microSecondsSinceEpoch() - low.microSecondsSinceEpoch();
+    return static_cast<double>(diff) / TimeStamp::kMicroSecondsPerSecond;
+}
+
+//在timestamp上加seconds秒
+inline TimeStamp addTime(TimeStamp timestamp, double seconds)
+{
+    int64_t delta = static_cast<int64_t>(seconds * TimeStamp::kMicroSecondsPerSecond);
+    return TimeStamp(timestamp.microSecondsSinceEpoch() + delta);
+}
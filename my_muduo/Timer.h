@@ -0,0 +1,40 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "TimeStamp.h"
+#include "Callbacks.h"
+
+#include <atomic>
+
+//定时器，记录到期时间、回调以及是否重复
+class Timer : noncopyable
+{
+public:
+    Timer(TimerCallback cb, TimeStamp when, double interval)
+        : callback_(std::move(cb))
+        , expiration_(when)
+        , interval_(interval)
+        , repeat_(interval > 0.0)
+        , sequence_(++s_numCreated_)
+    {}
+
+    void run() const { callback_(); }
+
+    TimeStamp expiration() const { return expiration_; }
+    bool repeat() const { return repeat_; }
+    int64_t sequence() const { return sequence_; }
+
+    //重复的定时器，以now为起点计算下一次到期时间
+    void restart(TimeStamp now);
+
+    static int64_t numCreated() { return s_numCreated_; }
+
+private:
+    const TimerCallback callback_;
+    TimeStamp expiration_;
+    const double interval_; //重复的间隔，单位秒
+    const bool repeat_;
+    const int64_t sequence_; //全局唯一的序号，区分地址相同的不同定时器
+
+    static std::atomic<int64_t> s_numCreated_;
+};
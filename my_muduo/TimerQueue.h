@@ -0,0 +1,59 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "TimeStamp.h"
+#include "Callbacks.h"
+#include "Channel.h"
+
+#include <set>
+#include <vector>
+#include <memory>
+
+class EventLoop;
+class Timer;
+class TimerId;
+
+/**
+ * 定时器队列，用一个timerfd把定时事件也变成poller上的读事件
+ * timerfd总是设置成最早到期的那个定时器的时间
+*/
+class TimerQueue : noncopyable
+{
+public:
+    explicit TimerQueue(EventLoop *loop);
+    ~TimerQueue();
+
+    //可以跨线程调用
+    TimerId addTimer(TimerCallback cb, TimeStamp when, double interval);
+
+    void cancel(TimerId timerId);
+
+private:
+    using Entry = std::pair<TimeStamp, Timer*>;
+    using TimerList = std::set<Entry>;
+    using ActiveTimer = std::pair<Timer*, int64_t>;
+    using ActiveTimerSet = std::set<ActiveTimer>;
+
+    void addTimerInLoop(Timer *timer);
+    void cancelInLoop(TimerId timerId);
+
+    //timerfd可读了，处理所有到期的定时器
+    void handleRead();
+
+    //取出所有到期的定时器
+    std::vector<Entry> getExpired(TimeStamp now);
+    //重复的定时器重新插入
+    void reset(const std::vector<Entry> &expired, TimeStamp now);
+
+    bool insert(Timer *timer);
+
+    EventLoop *loop_;
+    const int timerfd_;
+    Channel timerfdChannel_;
+
+    TimerList timers_; //按到期时间排序
+
+    ActiveTimerSet activeTimers_; //按地址排序，用于cancel
+    bool callingExpiredTimers_;
+    ActiveTimerSet cancelingTimers_; //在回调里取消的重复定时器
+};
@@ -0,0 +1,163 @@
+#include "Tracer.h"
+#include "CurrentThread.h"
+
+#include <vector>
+#include <mutex>
+#include <memory>
+#include <stdio.h>
+#include <unistd.h>
+
+std::atomic_bool Tracer::enabled_(false);
+std::atomic<size_t> Tracer::capacity_(64 * 1024);
+
+struct Span
+{
+    const char *name;
+    int64_t start;
+    int64_t end;
+    int fd;
+    int value;
+};
+
+/**
+ * 每个线程一个环形缓冲区，只有所属线程写
+ * 写完一个槽位以后才递增written，导出的线程读完槽位再检查一次written，
+ * 读的过程中被覆盖掉的槽位丢弃
+*/
+struct ThreadBuffer
+{
+    explicit ThreadBuffer(size_t capacity)
+        : tid(CurrentThread::tid())
+        , spans(capacity)
+        , written(0)
+    {}
+
+    const int tid;
+    std::vector<Span> spans;
+    std::atomic<uint64_t> written;
+};
+
+//线程退出以后缓冲区也保留，导出时还能看到它最后做了什么
+static std::mutex g_buffersMutex;
+static std::vector<std::unique_ptr<ThreadBuffer>> g_buffers;
+
+static __thread ThreadBuffer *t_buffer = nullptr;
+
+static ThreadBuffer* threadBuffer(size_t capacity)
+{
+    if(t_buffer == nullptr)
+    {
+        ThreadBuffer *buffer = new ThreadBuffer(capacity);
+        std::lock_guard<std::mutex> lock(g_buffersMutex);
+        g_buffers.emplace_back(buffer);
+        t_buffer = buffer;
+    }
+    return t_buffer;
+}
+
+void Tracer::enable(size_t spansPerThread)
+{
+    capacity_.store(spansPerThread > 0 ? spansPerThread : 1, std::memory_order_relaxed);
+    enabled_.store(true, std::memory_order_relaxed);
+}
+
+void Tracer::disable()
+{
+    enabled_.store(false, std::memory_order_relaxed);
+}
+
+void Tracer::record(const char *name, int64_t startNanos, int64_t endNanos, int fd, int value)
+{
+    ThreadBuffer *buffer = threadBuffer(capacity_.load(std::memory_order_relaxed));
+    uint64_t n = buffer->written.load(std::memory_order_relaxed);
+    Span &span = buffer->spans[n % buffer->spans.size()];
+    span.name = name;
+    span.start = startNanos;
+    span.end = endNanos;
+    span.fd = fd;
+    span.value = value;
+    buffer->written.store(n + 1, std::memory_order_release);
+}
+
+std::string Tracer::dumpJson()
+{
+    std::string out;
+    out.reserve(1024 * 1024);
+    out.append("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    const int pid = ::getpid();
+    bool first = true;
+    char buf[256];
+
+    std::lock_guard<std::mutex> lock(g_buffersMutex);
+    for(const std::unique_ptr<ThreadBuffer> &buffer : g_buffers)
+    {
+        const size_t capacity = buffer->spans.size();
+        uint64_t end = buffer->written.load(std::memory_order_acquire);
+        uint64_t begin = end > capacity ? end - capacity : 0;
+        std::vector<Span> copy;
+        copy.reserve(end - begin);
+        for(uint64_t i = begin; i < end; ++i)
+        {
+            copy.push_back(buffer->spans[i % capacity]);
+        }
+        //拷贝期间写者可能绕了一圈回来，被覆盖的槽位不可信；写者先写槽位再加written，
+        //逻辑序号after - capacity的槽位（就是下一个要写的）可能正写到一半，也不要
+        uint64_t after = buffer->written.load(std::memory_order_acquire);
+        size_t skip = 0;
+        if(after >= capacity && after - capacity + 1 > begin)
+        {
+            skip = after - capacity + 1 - begin;
+            if(skip > copy.size())
+            {
+                skip = copy.size();
+            }
+        }
+
+        snprintf(buf, sizeof buf,
+                "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}",
+                first ? "" : ",\n", pid, buffer->tid, buffer->tid);
+        out.append(buf);
+        first = false;
+
+        for(size_t i = skip; i < copy.size(); ++i)
+        {
+            const Span &s = copy[i];
+            int n = snprintf(buf, sizeof buf,
+                    ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+                    s.name, pid, buffer->tid, s.start / 1000.0, (s.end - s.start) / 1000.0);
+            out.append(buf, n);
+            if(s.fd >= 0 && s.value >= 0)
+            {
+                n = snprintf(buf, sizeof buf, ",\"args\":{\"fd\":%d,\"revents\":\"0x%x\"}}", s.fd, s.value);
+            }
+            else if(s.fd >= 0)
+            {
+                n = snprintf(buf, sizeof buf, ",\"args\":{\"fd\":%d}}", s.fd);
+            }
+            else if(s.value >= 0)
+            {
+                n = snprintf(buf, sizeof buf, ",\"args\":{\"count\":%d}}", s.value);
+            }
+            else
+            {
+                n = snprintf(buf, sizeof buf, "}");
+            }
+            out.append(buf, n);
+        }
+    }
+    out.append("\n]}\n");
+    return out;
+}
+
+bool Tracer::dumpToFile(const std::string &path)
+{
+    std::string json = dumpJson();
+    FILE *fp = ::fopen(path.c_str(), "w");
+    if(fp == nullptr)
+    {
+        return false;
+    }
+    bool ok = ::fwrite(json.data(), 1, json.size(), fp) == json.size();
+    ::fclose(fp);
+    return ok;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <atomic>
+#include <string>
+#include <chrono>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * 事件循环的时间线追踪，导出成Chrome trace-event格式的json，可以直接用Perfetto打开
+ * 每个线程第一次记录时分配一个固定大小的环形缓冲区，之后每个span只写一个槽位，不分配内存
+ * 关闭时每个埋点只有一次对全局开关的判断
+*/
+class Tracer : noncopyable
+{
+public:
+    //打开追踪，spansPerThread是每个线程环形缓冲区的容量，满了以后覆盖最早的span
+    //线程的缓冲区在它第一次记录的时候按当时的容量分配，之后不再改变
+    static void enable(size_t spansPerThread = 64 * 1024);
+    static void disable();
+    static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+    //纳秒，和std::chrono::steady_clock一致
+    static int64_t now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /**
+     * 记录一个span，name必须是字符串常量（只保存指针）
+     * fd>=0时导出args.fd，value是事件掩码，导出为args.revents；fd<0且value>=0时导出为args.count
+    */
+    static void record(const char *name, int64_t startNanos, int64_t endNanos, int fd = -1, int value = -1);
+
+    //把所有线程缓冲区里的span导出成json，可以在任意线程调用，不会停住正在记录的线程
+    static std::string dumpJson();
+    static bool dumpToFile(const std::string &path);
+
+private:
+    static std::atomic_bool enabled_;
+    static std::atomic<size_t> capacity_;
+};
+
+//作用域内的span，构造时判断一次开关，关闭时什么都不做
+class TraceSpan : noncopyable
+{
+public:
+    explicit TraceSpan(const char *name, int fd = -1, int value = -1)
+        : name_(Tracer::enabled() ? name : nullptr)
+    {
+        if(name_)
+        {
+            fd_ = fd;
+            value_ = value;
+            start_ = Tracer::now();
+        }
+    }
+
+    ~TraceSpan()
+    {
+        if(name_)
+        {
+            Tracer::record(name_, start_, Tracer::now(), fd_, value_);
+        }
+    }
+
+private:
+    const char *name_; //nullptr表示没有开启追踪
+    int fd_;
+    int value_;
+    int64_t start_;
+};
@@ -0,0 +1,80 @@
+#include "UdpServer.h"
+#include "EventLoop.h"
+#include "logger.h"
+
+#include <future>
+
+UdpServer::UdpServer(EventLoop *loop,
+                     const InetAddress &listenAddr,
+                     const std::string &nameArg,
+                     int batchSize,
+                     size_t maxPacketSize)
+    : loop_(loop)
+    , listenAddr_(listenAddr)
+    , name_(nameArg)
+    , batchSize_(batchSize)
+    , maxPacketSize_(maxPacketSize)
+    , started_(0)
+    , threadPool_(new EventLoopThreadPool(loop, nameArg))
+{
+    if(loop == nullptr)
+    {
+        LOG_FATAL("%s:%s:%d udp server loop is null! \n", __FILE__, __FUNCTION__, __LINE__);
+    }
+}
+
+UdpServer::~UdpServer()
+{
+    //socket的channel要在它自己的loop线程里摘掉，等每个loop做完再析构线程池
+    for(std::unique_ptr<UdpSocket> &socket : sockets_)
+    {
+        EventLoop *ioLoop = socket->getLoop();
+        if(ioLoop->isInLoopThread())
+        {
+            socket.reset();
+            continue;
+        }
+        std::promise<void> done;
+        UdpSocket *raw = socket.release();
+        ioLoop->runInLoop([raw, &done]() {
+            delete raw;
+            done.set_value();
+        });
+        done.get_future().wait();
+    }
+}
+
+void UdpServer::setThreadNum(int numThreads)
+{
+    threadPool_->setThreadNum(numThreads);
+}
+
+void UdpServer::start()
+{
+    if(started_++ != 0)
+    {
+        return;
+    }
+    threadPool_->start(threadInitCallback_);
+
+    //每个loop一个reuseport socket，在主线程里创建绑定好，绑定失败马上就能发现
+    //端口为0时第一个socket由内核分配端口，后面的绑定到同一个端口
+    std::vector<EventLoop*> loops = threadPool_->getAllLoops();
+    bool reusePort = loops.size() > 1;
+    InetAddress bindAddr(listenAddr_);
+    for(EventLoop *ioLoop : loops)
+    {
+        UdpSocket *socket = new UdpSocket(ioLoop, bindAddr, reusePort, batchSize_, maxPacketSize_);
+        bindAddr = socket->localAddress();
+        socket->setMessageCallback(messageCallback_);
+        sockets_.emplace_back(socket);
+        SocketInitCallback init = socketInitCallback_;
+        ioLoop->runInLoop([socket, init]() {
+            if(init)
+            {
+                init(socket);
+            }
+            socket->start();
+        });
+    }
+}
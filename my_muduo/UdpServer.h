@@ -0,0 +1,63 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "InetAddress.h"
+#include "UdpSocket.h"
+#include "EventLoopThreadPool.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+
+class EventLoop;
+
+/**
+ * UDP服务器：每个subloop一个绑定同一地址的SO_REUSEPORT socket，内核按四元组把数据报分到各个socket，
+ * 同一个对端的数据报总是落在同一个loop上，loop之间不共享任何状态
+ * 没有subloop时只在baseloop上开一个socket
+*/
+class UdpServer : noncopyable
+{
+public:
+    using ThreadInitCallback = std::function<void(EventLoop*)>;
+    //每个socket开始收包之前在它的loop线程里调用，可以用来调整socket（比如setGso）
+    using SocketInitCallback = std::function<void(UdpSocket*)>;
+
+    UdpServer(EventLoop *loop,
+              const InetAddress &listenAddr,
+              const std::string &nameArg,
+              int batchSize = 64,
+              size_t maxPacketSize = 2048);
+    ~UdpServer();
+
+    const std::string& name() const { return name_; }
+    EventLoop* getLoop() const { return loop_; }
+
+    void setThreadNum(int numThreads);
+    void setThreadInitCallback(const ThreadInitCallback &cb) { threadInitCallback_ = cb; }
+    void setSocketInitCallback(const SocketInitCallback &cb) { socketInitCallback_ = cb; }
+    void setMessageCallback(const UdpMessageCallback &cb) { messageCallback_ = cb; }
+
+    void start();
+
+    //所有socket，下标和EventLoopThreadPool::getAllLoops()一致；每个socket只能在它自己的loop线程里使用
+    const std::vector<std::unique_ptr<UdpSocket>>& sockets() const { return sockets_; }
+
+private:
+    EventLoop *loop_;
+    const InetAddress listenAddr_;
+    const std::string name_;
+    const int batchSize_;
+    const size_t maxPacketSize_;
+
+    ThreadInitCallback threadInitCallback_;
+    SocketInitCallback socketInitCallback_;
+    UdpMessageCallback messageCallback_;
+
+    std::atomic_int started_;
+    //sockets_在threadPool_之后析构不安全，析构函数里先在各自的loop线程里销毁socket
+    std::vector<std::unique_ptr<UdpSocket>> sockets_;
+    std::shared_ptr<EventLoopThreadPool> threadPool_;
+};
@@ -0,0 +1,311 @@
+#include "UdpSocket.h"
+#include "EventLoop.h"
+#include "logger.h"
+
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+//一个GSO消息最多的分段数和总字节数，超过内核会拒绝
+static const int kMaxGsoSegments = 64;
+static const size_t kMaxGsoBytes = 65000;
+//一次sendmmsg最多的消息数
+static const int kMaxSendMsgs = 256;
+//每次可读事件最多读几批，剩下的留给下一轮，水平触发还会再通知
+static const int kMaxReadRounds = 4;
+//待发送队列超过这么多就不等本轮末尾，马上发
+static const size_t kMaxPendingBytes = 4 * 1024 * 1024;
+
+static const size_t kControlSpace = CMSG_SPACE(sizeof(uint16_t));
+
+static int createUdpNonblocking(sa_family_t family)
+{
+    int sockfd = ::socket(family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_UDP);
+    if(sockfd < 0)
+    {
+        LOG_FATAL("%s:%s:%d udp socket create err:%d \n", __FILE__,__FUNCTION__,__LINE__,errno);
+    }
+    return sockfd;
+}
+
+UdpSocket::UdpSocket(EventLoop *loop,
+                     const InetAddress &bindAddr,
+                     bool reusePort,
+                     int batchSize,
+                     size_t maxPacketSize)
+    : loop_(loop)
+    , socket_(createUdpNonblocking(bindAddr.family())) //IPv4或者IPv6
+    , channel_(loop, socket_.fd())
+    , batchSize_(batchSize > 0 ? batchSize : 1)
+    , maxPacketSize_(maxPacketSize)
+    , recvBuffer_(batchSize_ * maxPacketSize)
+    , recvMsgs_(batchSize_)
+    , recvIovecs_(batchSize_)
+    , recvAddrs_(batchSize_)
+    , packets_(batchSize_)
+    , flushQueued_(false)
+    , gso_(false)
+    , sendMsgs_(kMaxSendMsgs)
+    , sendIovecs_(kMaxSendMsgs)
+    , sendControl_(kMaxSendMsgs * kControlSpace)
+    , alive_(std::make_shared<bool>(true))
+{
+    //UDP的SO_REUSEADDR会让别的socket悄悄绑定同一个端口抢走数据，只在明确要求reusePort时才打开
+    if(reusePort)
+    {
+        socket_.setReuseAddr(true);
+        socket_.setReusePort(true);
+    }
+    socket_.bindAddress(bindAddr);
+
+    //收包的iovec和地址只设置一次，每次recvmmsg前只需要重置长度
+    for(int i = 0; i < batchSize_; ++i)
+    {
+        recvIovecs_[i].iov_base = &recvBuffer_[i * maxPacketSize_];
+        recvIovecs_[i].iov_len = maxPacketSize_;
+        memset(&recvMsgs_[i], 0, sizeof recvMsgs_[i]);
+        recvMsgs_[i].msg_hdr.msg_iov = &recvIovecs_[i];
+        recvMsgs_[i].msg_hdr.msg_iovlen = 1;
+        recvMsgs_[i].msg_hdr.msg_name = &recvAddrs_[i];
+    }
+    channel_.setReadCallback(std::bind(&UdpSocket::handleRead, this, std::placeholders::_1));
+}
+
+UdpSocket::~UdpSocket()
+{
+    if(!channel_.isNoneEvent())
+    {
+        channel_.disableAll();
+    }
+    channel_.remove();
+}
+
+void UdpSocket::start()
+{
+    channel_.enableReading();
+}
+
+void UdpSocket::stop()
+{
+    flush();
+    channel_.disableAll();
+}
+
+bool UdpSocket::setGso(bool on)
+{
+    if(on)
+    {
+        //UDP_SEGMENT设成0只是检查内核是否支持，发送时每个消息用cmsg单独指定分段大小
+        int size = 0;
+        if(::setsockopt(socket_.fd(), SOL_UDP, UDP_SEGMENT, &size, sizeof size) < 0)
+        {
+            LOG_ERROR("UdpSocket UDP_SEGMENT not supported, errno:%d \n", errno);
+            gso_ = false;
+            return false;
+        }
+    }
+    gso_ = on;
+    return true;
+}
+
+InetAddress UdpSocket::localAddress() const
+{
+    return InetAddress::getLocalAddr(socket_.fd());
+}
+
+void UdpSocket::handleRead(TimeStamp receiveTime)
+{
+    for(int round = 0; round < kMaxReadRounds; ++round)
+    {
+        for(int i = 0; i < batchSize_; ++i)
+        {
+            recvMsgs_[i].msg_hdr.msg_namelen = sizeof(sockaddr_in6);
+            recvMsgs_[i].msg_hdr.msg_flags = 0;
+        }
+        int n = ::recvmmsg(socket_.fd(), recvMsgs_.data(), batchSize_, MSG_DONTWAIT, nullptr);
+        if(n <= 0)
+        {
+            if(n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            {
+                LOG_ERROR("UdpSocket::handleRead recvmmsg errno:%d \n", errno);
+            }
+            return;
+        }
+
+        ++stats_.recvCalls;
+        size_t bytes = 0;
+        for(int i = 0; i < n; ++i)
+        {
+            size_t len = recvMsgs_[i].msg_len;
+            if(recvMsgs_[i].msg_hdr.msg_flags & MSG_TRUNC)
+            {
+                ++stats_.truncated;
+                len = maxPacketSize_;
+            }
+            packets_[i].data = static_cast<const char*>(recvIovecs_[i].iov_base);
+            packets_[i].len = len;
+            packets_[i].peer.setSockAddr((sockaddr*)&recvAddrs_[i], recvMsgs_[i].msg_hdr.msg_namelen);
+            bytes += len;
+        }
+        stats_.packetsReceived += n;
+        stats_.bytesReceived += bytes;
+        LoopMetrics::add(loop_->metrics().bytesRead, bytes);
+        loop_->consumeReadBudget(bytes);
+
+        if(messageCallback_)
+        {
+            messageCallback_(this, packets_.data(), n, receiveTime);
+        }
+        //没收满说明socket已经读空了
+        if(n < batchSize_)
+        {
+            return;
+        }
+    }
+}
+
+void UdpSocket::sendTo(const InetAddress &peer, const void *data, size_t len)
+{
+    PendingPacket packet;
+    packet.offset = sendBuffer_.size();
+    packet.len = len;
+    packet.peer = peer;
+    sendBuffer_.append(static_cast<const char*>(data), len);
+    pending_.push_back(packet);
+
+    if(sendBuffer_.size() >= kMaxPendingBytes)
+    {
+        flush();
+    }
+    else if(!flushQueued_)
+    {
+        flushQueued_ = true;
+        std::weak_ptr<bool> alive(alive_);
+        loop_->queueFlush([this, alive]() {
+            if(alive.lock())
+            {
+                flushQueued_ = false;
+                flush();
+            }
+        });
+    }
+}
+
+/**
+ * 不开GSO时一个数据报一个消息
+ * 开了GSO时，从first开始，发给同一个对端、长度都等于第一个的连续数据报（最后一个可以更短）
+ * 在sendBuffer_里是连续的，合成一个iovec，用cmsg带上分段大小
+*/
+int UdpSocket::buildMessage(size_t first, struct mmsghdr *msg, struct iovec *iov, char *control)
+{
+    PendingPacket &head = pending_[first];
+    int count = 1;
+    size_t total = head.len;
+    if(gso_ && head.len > 0)
+    {
+        while(first + count < pending_.size() && count < kMaxGsoSegments)
+        {
+            const PendingPacket &next = pending_[first + count];
+            if(next.peer != head.peer || next.len > head.len || total + next.len > kMaxGsoBytes)
+            {
+                break;
+            }
+            total += next.len;
+            ++count;
+            if(next.len < head.len)
+            {
+                break; //短的只能是最后一段
+            }
+        }
+    }
+
+    iov->iov_base = &sendBuffer_[head.offset];
+    iov->iov_len = total;
+    memset(msg, 0, sizeof *msg);
+    msg->msg_hdr.msg_name = const_cast<sockaddr*>(head.peer.getSockAddr());
+    msg->msg_hdr.msg_namelen = head.peer.getSockAddrLen();
+    msg->msg_hdr.msg_iov = iov;
+    msg->msg_hdr.msg_iovlen = 1;
+    if(count > 1)
+    {
+        msg->msg_hdr.msg_control = control;
+        msg->msg_hdr.msg_controllen = kControlSpace;
+        struct cmsghdr *cm = CMSG_FIRSTHDR(&msg->msg_hdr);
+        cm->cmsg_level = SOL_UDP;
+        cm->cmsg_type = UDP_SEGMENT;
+        cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+        uint16_t segment = static_cast<uint16_t>(head.len);
+        memcpy(CMSG_DATA(cm), &segment, sizeof segment);
+    }
+    return count;
+}
+
+void UdpSocket::flush()
+{
+    size_t next = 0;
+    while(next < pending_.size())
+    {
+        //组装一批消息，记下每个消息包含几个数据报
+        int numMsgs = 0;
+        int packetsInMsg[kMaxSendMsgs];
+        size_t cursor = next;
+        while(cursor < pending_.size() && numMsgs < kMaxSendMsgs)
+        {
+            int used = buildMessage(cursor, &sendMsgs_[numMsgs], &sendIovecs_[numMsgs],
+                                    &sendControl_[numMsgs * kControlSpace]);
+            packetsInMsg[numMsgs++] = used;
+            cursor += used;
+        }
+
+        //中间某个消息出错时sendmmsg返回前面发出去的个数，下一轮从出错的消息开始发，sendmmsg返回-1和它的errno
+        int sent = ::sendmmsg(socket_.fd(), sendMsgs_.data(), numMsgs, MSG_DONTWAIT);
+        ++stats_.sendCalls;
+        if(sent < 0)
+        {
+            int savedErrno = errno;
+            if(savedErrno == EINTR)
+            {
+                continue;
+            }
+            if(savedErrno == EIO && gso_ && packetsInMsg[0] > 1)
+            {
+                //网卡不支持GSO校验和卸载时内核返回EIO，关掉GSO从这个消息开始重发
+                LOG_ERROR("UdpSocket GSO send failed, falling back to plain sendmmsg \n");
+                gso_ = false;
+                continue;
+            }
+            if(savedErrno == EAGAIN || savedErrno == EWOULDBLOCK || savedErrno == ENOBUFS)
+            {
+                //发送缓冲区满了，UDP不重试，剩下的都丢弃
+                stats_.sendDropped += pending_.size() - next;
+                break;
+            }
+            //只是这一个消息有问题（比如EMSGSIZE），丢掉它，后面的接着发
+            LOG_ERROR("UdpSocket::flush sendmmsg to %s errno:%d \n",
+                    pending_[next].peer.toIpPort().c_str(), savedErrno);
+            stats_.sendDropped += packetsInMsg[0];
+            next += packetsInMsg[0];
+            continue;
+        }
+
+        for(int i = 0; i < sent; ++i)
+        {
+            stats_.packetsSent += packetsInMsg[i];
+            stats_.bytesSent += sendIovecs_[i].iov_len;
+            if(packetsInMsg[i] > 1)
+            {
+                ++stats_.gsoMessages;
+            }
+            LoopMetrics::add(loop_->metrics().bytesWritten, sendIovecs_[i].iov_len);
+            next += packetsInMsg[i];
+        }
+    }
+    pending_.clear();
+    sendBuffer_.clear();
+}
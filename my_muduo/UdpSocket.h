@@ -0,0 +1,122 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Socket.h"
+#include "Channel.h"
+#include "InetAddress.h"
+#include "TimeStamp.h"
+
+#include <functional>
+#include <vector>
+#include <memory>
+#include <string>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+class EventLoop;
+class UdpSocket;
+
+//收到的一个数据报，data指向UdpSocket内部预分配的缓冲区，只在回调里有效
+struct UdpPacket
+{
+    const char *data;
+    size_t len;
+    InetAddress peer;
+};
+
+//一次recvmmsg收到的一批数据报
+using UdpMessageCallback = std::function<void(UdpSocket*, const UdpPacket *packets, int count, TimeStamp)>;
+
+/**
+ * 非阻塞的UDP socket，注册在一个loop上
+ * 读：可读时用recvmmsg一次收一批到预分配的缓冲区，整批交给回调，收包路径上不分配内存
+ * 写：sendTo先拷进待发送队列，本轮事件循环末尾（EventLoop::queueFlush）用sendmmsg一次发出去；
+ *     开启GSO以后，发给同一个对端、长度相同的连续数据报合并成一个UDP_SEGMENT消息，由内核/网卡切分
+ * UDP没有背压，发送缓冲区满(EAGAIN)时剩下的数据报直接丢弃并计数；单个数据报出错（比如EMSGSIZE）只丢弃这一个
+ * 除了构造以外所有方法都只能在loop线程调用
+*/
+class UdpSocket : noncopyable
+{
+public:
+    //只在loop线程读写的统计
+    struct Stats
+    {
+        int64_t packetsReceived = 0;
+        int64_t bytesReceived = 0;
+        int64_t recvCalls = 0;       //recvmmsg调用次数
+        int64_t truncated = 0;       //超过maxPacketSize被截断的数据报
+        int64_t packetsSent = 0;
+        int64_t bytesSent = 0;
+        int64_t sendCalls = 0;       //sendmmsg调用次数
+        int64_t gsoMessages = 0;     //发出去的GSO消息数
+        int64_t sendDropped = 0;     //发送失败丢弃的数据报
+    };
+
+    //bindAddr端口为0表示由内核分配（客户端）；reusePort时多个socket可以绑定同一个地址，内核按四元组分流
+    UdpSocket(EventLoop *loop,
+              const InetAddress &bindAddr,
+              bool reusePort = false,
+              int batchSize = 64,
+              size_t maxPacketSize = 2048);
+    ~UdpSocket();
+
+    void setMessageCallback(const UdpMessageCallback &cb) { messageCallback_ = cb; }
+
+    //开始/停止收包
+    void start();
+    void stop();
+
+    //开启UDP GSO，内核不支持时返回false，仍然逐个数据报发送
+    bool setGso(bool on);
+
+    //拷贝到待发送队列，本轮事件循环末尾统一发送
+    void sendTo(const InetAddress &peer, const void *data, size_t len);
+    //马上把待发送队列发出去
+    void flush();
+
+    EventLoop* getLoop() const { return loop_; }
+    int fd() const { return socket_.fd(); }
+    InetAddress localAddress() const;
+    const Stats& stats() const { return stats_; }
+
+private:
+    struct PendingPacket
+    {
+        size_t offset; //在sendBuffer_里的位置
+        size_t len;
+        InetAddress peer;
+    };
+
+    void handleRead(TimeStamp receiveTime);
+    //把从first开始的待发送数据报组装成消息，返回用掉了多少个
+    int buildMessage(size_t first, struct mmsghdr *msg, struct iovec *iov, char *control);
+
+    EventLoop *loop_;
+    Socket socket_;
+    Channel channel_;
+    UdpMessageCallback messageCallback_;
+
+    //收包用的预分配数组，batchSize_个槽位
+    const int batchSize_;
+    const size_t maxPacketSize_;
+    std::vector<char> recvBuffer_;
+    std::vector<struct mmsghdr> recvMsgs_;
+    std::vector<struct iovec> recvIovecs_;
+    std::vector<sockaddr_in6> recvAddrs_; //IPv4和IPv6的地址都放得下
+    std::vector<UdpPacket> packets_;
+
+    //待发送队列，数据连续存放，本轮末尾flush
+    std::string sendBuffer_;
+    std::vector<PendingPacket> pending_;
+    bool flushQueued_;
+    bool gso_;
+    //sendmmsg用的预分配数组
+    std::vector<struct mmsghdr> sendMsgs_;
+    std::vector<struct iovec> sendIovecs_;
+    std::vector<char> sendControl_;
+    std::shared_ptr<bool> alive_; //queueFlush的回调持有weak_ptr，socket析构以后不再flush
+
+    Stats stats_;
+};
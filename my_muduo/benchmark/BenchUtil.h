@@ -0,0 +1,102 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/resource.h>
+
+/**
+ * 性能测试程序共用的计时工具，只有头文件，不进动态库
+*/
+
+//一组线程的cpu时钟：被统计的线程自己调用record登记（比如在EventLoopThread的ThreadInitCallback里），
+//pthread_getcpuclockid取到的时钟主线程可以直接读
+class ThreadClocks
+{
+public:
+    //在被统计的线程里调用，name只用来打印
+    void record(const std::string &name = std::string())
+    {
+        clockid_t cid;
+        ::pthread_getcpuclockid(::pthread_self(), &cid);
+        std::lock_guard<std::mutex> lock(mutex_);
+        names_.push_back(name);
+        clocks_.push_back(cid);
+    }
+
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return clocks_.size();
+    }
+
+    std::string name(size_t i) const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return names_[i];
+    }
+
+    //每个线程累计的cpu秒数，顺序和登记的顺序一致
+    std::vector<double> snapshot() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<double> result;
+        for(clockid_t cid : clocks_)
+        {
+            struct timespec ts;
+            ::clock_gettime(cid, &ts);
+            result.push_back(ts.tv_sec + ts.tv_nsec / 1e9);
+        }
+        return result;
+    }
+
+    //所有线程加起来的cpu秒数
+    double cpuSeconds() const
+    {
+        double total = 0;
+        for(double s : snapshot())
+        {
+            total += s;
+        }
+        return total;
+    }
+
+private:
+    mutable std::mutex mutex_;
+    std::vector<std::string> names_;
+    std::vector<clockid_t> clocks_;
+};
+
+//整个进程用掉的cpu秒数（用户态加内核态）
+inline double processCpuSeconds()
+{
+    struct rusage usage;
+    ::getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6
+        + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+//单调时钟
+inline int64_t nowNanos()
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+inline int64_t nowMicros()
+{
+    return nowNanos() / 1000;
+}
+
+//忙等模拟CPU密集的计算
+inline void burn(int64_t nanos)
+{
+    int64_t end = nowNanos() + nanos;
+    while(nowNanos() < end)
+    {
+    }
+}
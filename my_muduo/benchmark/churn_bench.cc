@@ -0,0 +1,219 @@
+#include <my_muduo/TcpServer.h>
+#include <my_muduo/EventLoopThread.h>
+#include <my_muduo/logger.h>
+#include "BenchUtil.h"
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+/**
+ * 连接风暴测试：几个客户端线程用阻塞socket不停地 建连->(可选)交换一个消息->断开，
+ * 压的是 Acceptor::headleRead -> newConnection -> connectEstablished
+ *         -> handleClose -> removeConnectionInLoop -> connectDestroyed 这条路径
+ * 服务端建连后先发1字节hello，客户端从connect开始到收到hello的时间算作建连延迟，
+ * 服务端发完数据后主动shutdown，TIME_WAIT留在服务端，客户端的端口不会被耗尽
+ * 分别打印base loop(accept所在线程)、每个io线程、客户端线程的cpu，看瓶颈在不在base loop
+ * 用法：churn_bench [port] [server io线程数] [client线程数] [msgSize，0表示只收hello] [秒数]
+*/
+
+static std::atomic_bool g_stopped(false);
+static int g_msgSize = 0;
+
+//base loop、每个io线程、每个客户端线程的cpu时钟
+static ThreadClocks g_clocks;
+
+static void onConnection(const TcpConnectionPtr &conn)
+{
+    if(conn->connected())
+    {
+        conn->setTcpNoDelay(true);
+        conn->send(std::string(1, 'h'));
+        if(g_msgSize == 0)
+        {
+            conn->shutdown();
+        }
+    }
+}
+
+//交换消息模式：收齐一个消息就原样发回去，然后关闭写端
+static void onMessage(const TcpConnectionPtr &conn, Buffer *buf, TimeStamp)
+{
+    if(buf->readableBytes() >= static_cast<size_t>(g_msgSize))
+    {
+        conn->send(buf);
+        conn->shutdown();
+    }
+}
+
+struct ClientStats
+{
+    int64_t connections = 0;
+    int64_t failures = 0;
+    std::vector<int32_t> latencies; //微秒
+};
+
+static bool readFully(int fd, char *buf, size_t len)
+{
+    size_t got = 0;
+    while(got < len)
+    {
+        ssize_t n = ::read(fd, buf + got, len - got);
+        if(n <= 0)
+        {
+            return false;
+        }
+        got += n;
+    }
+    return true;
+}
+
+static void clientThread(const InetAddress *serverAddr, int id, ClientStats *stats)
+{
+    g_clocks.record("client" + std::to_string(id));
+    std::string message(g_msgSize, 'm');
+    std::vector<char> reply(g_msgSize + 1);
+    while(!g_stopped)
+    {
+        int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP);
+        int64_t start = nowMicros();
+        if(::connect(fd, serverAddr->getSockAddr(), serverAddr->getSockAddrLen()) < 0)
+        {
+            ++stats->failures;
+            ::close(fd);
+            if(errno == EADDRNOTAVAIL)
+            {
+                ::usleep(1000); //本地端口用完了，缓一下
+            }
+            continue;
+        }
+        char hello;
+        if(!readFully(fd, &hello, 1))
+        {
+            ++stats->failures;
+            ::close(fd);
+            continue;
+        }
+        stats->latencies.push_back(static_cast<int32_t>(nowMicros() - start));
+
+        bool ok = true;
+        if(g_msgSize > 0)
+        {
+            ok = ::write(fd, message.data(), message.size()) == static_cast<ssize_t>(message.size())
+                && readFully(fd, reply.data(), message.size());
+        }
+        //等服务端先关，读到EOF再close
+        ok = ok && ::read(fd, reply.data(), reply.size()) == 0;
+        ::close(fd);
+        if(ok)
+        {
+            ++stats->connections;
+        }
+        else
+        {
+            ++stats->failures;
+        }
+    }
+}
+
+static int32_t percentile(const std::vector<int32_t> &sorted, double p)
+{
+    if(sorted.empty())
+    {
+        return 0;
+    }
+    size_t idx = static_cast<size_t>(p / 100 * (sorted.size() - 1));
+    return sorted[idx];
+}
+
+int main(int argc, char *argv[])
+{
+    uint16_t port = argc > 1 ? static_cast<uint16_t>(atoi(argv[1])) : 8890;
+    int serverThreads = argc > 2 ? atoi(argv[2]) : 1;
+    int clientThreads = argc > 3 ? atoi(argv[3]) : 2;
+    g_msgSize = argc > 4 ? atoi(argv[4]) : 0;
+    double seconds = argc > 5 ? atof(argv[5]) : 5.0;
+    if(clientThreads < 1 || g_msgSize < 0)
+    {
+        fprintf(stderr, "Usage: %s [port] [serverThreads] [clientThreads] [msgSize] [seconds]\n", argv[0]);
+        return 1;
+    }
+
+    Logger::setLogThreshold(ERROR);
+
+    EventLoopThread baseThread([](EventLoop*) { g_clocks.record("server base loop"); });
+    EventLoop *baseLoop = baseThread.startLoop();
+    InetAddress listenAddr(port);
+    TcpServer server(baseLoop, listenAddr, "ChurnBench");
+    server.setConnectionCallback(onConnection);
+    server.setMessageCallback(onMessage);
+    server.setThreadNum(serverThreads);
+    //io线程数为0时连接也都在base loop上，不用再登记
+    std::atomic<int> ioIndex(0);
+    if(serverThreads > 0)
+    {
+        server.setThreadInitCallback([&ioIndex](EventLoop*) {
+            g_clocks.record("server io loop " + std::to_string(ioIndex++));
+        });
+    }
+    server.start();
+
+    std::vector<ClientStats> stats(clientThreads);
+    std::vector<std::thread> threads;
+    for(int i = 0; i < clientThreads; ++i)
+    {
+        threads.emplace_back(clientThread, &listenAddr, i, &stats[i]);
+    }
+
+    //等所有线程都登记好cpu时钟
+    while(g_clocks.size() != static_cast<size_t>(1 + serverThreads + clientThreads))
+    {
+    }
+    std::vector<double> startCpu = g_clocks.snapshot();
+    TimeStamp start(TimeStamp::now());
+    ::usleep(static_cast<useconds_t>(seconds * 1000 * 1000));
+    g_stopped = true;
+    for(std::thread &t : threads)
+    {
+        t.join();
+    }
+    double elapsed = timeDifference(TimeStamp::now(), start);
+    std::vector<double> endCpu = g_clocks.snapshot();
+
+    int64_t connections = 0;
+    int64_t failures = 0;
+    std::vector<int32_t> latencies;
+    for(ClientStats &s : stats)
+    {
+        connections += s.connections;
+        failures += s.failures;
+        latencies.insert(latencies.end(), s.latencies.begin(), s.latencies.end());
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    fprintf(stderr, "server io threads=%d client threads=%d msgSize=%d time=%.2fs\n",
+            serverThreads, clientThreads, g_msgSize, elapsed);
+    fprintf(stderr, "%ld connections, %ld failures, %.1f connections/s\n",
+            (long)connections, (long)failures, connections / elapsed);
+    fprintf(stderr, "accept latency(us): p50=%d p90=%d p99=%d p99.9=%d max=%d\n",
+            percentile(latencies, 50), percentile(latencies, 90), percentile(latencies, 99),
+            percentile(latencies, 99.9), latencies.empty() ? 0 : latencies.back());
+    for(size_t i = 0; i < g_clocks.size(); ++i)
+    {
+        fprintf(stderr, "  %-20s cpu %.1f%%\n", g_clocks.name(i).c_str(),
+                (endCpu[i] - startCpu[i]) / elapsed * 100);
+    }
+    ::_exit(0);
+}
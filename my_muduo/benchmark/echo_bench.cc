@@ -0,0 +1,181 @@
+#include <my_muduo/TcpServer.h>
+#include <my_muduo/TcpClient.h>
+#include <my_muduo/EventLoopThread.h>
+#include <my_muduo/logger.h>
+#include "BenchUtil.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <functional>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/**
+ * echo吞吐测试：进程里起一个echo服务器和若干客户端线程，全部走回环
+ * 每个连接保持pipeline个msgSize大小的消息在路上，收回一个完整的消息就再发一个，
+ * 统计每秒消息数、单方向的MiB/s，服务端和客户端线程各自的cpu占用
+ * 用法：echo_bench [port] [server线程数] [client线程数] [连接数] [msgSize] [pipeline] [秒数]
+*/
+
+static std::atomic_bool g_stopped(false);
+
+//服务端和客户端loop线程的cpu时钟
+static ThreadClocks g_serverClocks;
+static ThreadClocks g_clientClocks;
+
+static void onServerConnection(const TcpConnectionPtr &conn)
+{
+    if(conn->connected())
+    {
+        conn->setTcpNoDelay(true);
+    }
+}
+
+static void onServerMessage(const TcpConnectionPtr &conn, Buffer *buf, TimeStamp)
+{
+    conn->send(buf);
+}
+
+class EchoClient
+{
+public:
+    EchoClient(EventLoop *loop, const InetAddress &serverAddr,
+                const std::string &message, int pipeline, int id)
+        : client_(loop, serverAddr, "EchoBenchClient" + std::to_string(id))
+        , message_(message)
+        , pipeline_(pipeline)
+        , messages_(0)
+    {
+        client_.setConnectionCallback(
+            std::bind(&EchoClient::onConnection,this,std::placeholders::_1));
+        client_.setMessageCallback(
+            std::bind(&EchoClient::onMessage,this,
+                std::placeholders::_1,std::placeholders::_2,std::placeholders::_3));
+    }
+
+    void connect() { client_.connect(); }
+    int64_t messages() const { return messages_.load(std::memory_order_relaxed); }
+
+private:
+    void onConnection(const TcpConnectionPtr &conn)
+    {
+        if(conn->connected())
+        {
+            conn->setTcpNoDelay(true);
+            Buffer out;
+            for(int i = 0; i < pipeline_; ++i)
+            {
+                out.append(message_.data(), message_.size());
+            }
+            conn->send(&out);
+        }
+    }
+
+    //只按完整的消息计数，不足一个消息的留在buffer里
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, TimeStamp)
+    {
+        size_t completed = buf->readableBytes() / message_.size();
+        if(completed == 0)
+        {
+            return;
+        }
+        buf->retrieve(completed * message_.size());
+        messages_.fetch_add(completed, std::memory_order_relaxed);
+        if(!g_stopped)
+        {
+            Buffer out;
+            for(size_t i = 0; i < completed; ++i)
+            {
+                out.append(message_.data(), message_.size());
+            }
+            conn->send(&out);
+        }
+    }
+
+    TcpClient client_;
+    const std::string &message_;
+    int pipeline_;
+    std::atomic<int64_t> messages_;
+};
+
+int main(int argc, char *argv[])
+{
+    uint16_t port = argc > 1 ? static_cast<uint16_t>(atoi(argv[1])) : 8889;
+    int serverThreads = argc > 2 ? atoi(argv[2]) : 1;
+    int clientThreads = argc > 3 ? atoi(argv[3]) : 1;
+    int connections = argc > 4 ? atoi(argv[4]) : 16;
+    int msgSize = argc > 5 ? atoi(argv[5]) : 64;
+    int pipeline = argc > 6 ? atoi(argv[6]) : 1;
+    double seconds = argc > 7 ? atof(argv[7]) : 5.0;
+    if(clientThreads < 1 || connections < 1 || msgSize < 1 || pipeline < 1)
+    {
+        fprintf(stderr, "Usage: %s [port] [serverThreads] [clientThreads] [connections] [msgSize] [pipeline] [seconds]\n", argv[0]);
+        return 1;
+    }
+
+    Logger::setLogThreshold(ERROR);
+
+    //server线程数为0时所有连接都在这个base loop上，也算server的cpu
+    EventLoopThread serverThread([](EventLoop*) { g_serverClocks.record(); });
+    EventLoop *serverLoop = serverThread.startLoop();
+    InetAddress listenAddr(port);
+    TcpServer server(serverLoop, listenAddr, "EchoBench");
+    server.setConnectionCallback(onServerConnection);
+    server.setMessageCallback(onServerMessage);
+    server.setThreadNum(serverThreads);
+    if(serverThreads > 0)
+    {
+        server.setThreadInitCallback([](EventLoop*) { g_serverClocks.record(); });
+    }
+    server.start();
+
+    std::string message(msgSize, 'e');
+    std::vector<std::unique_ptr<EventLoopThread>> clientLoops;
+    std::vector<EventLoop*> loops;
+    for(int i = 0; i < clientThreads; ++i)
+    {
+        clientLoops.emplace_back(new EventLoopThread([](EventLoop*) { g_clientClocks.record(); }));
+        loops.push_back(clientLoops.back()->startLoop());
+    }
+
+    std::vector<std::unique_ptr<EchoClient>> clients;
+    for(int i = 0; i < connections; ++i)
+    {
+        clients.emplace_back(new EchoClient(loops[i % loops.size()], listenAddr, message, pipeline, i));
+        clients.back()->connect();
+    }
+
+    auto totalMessages = [&clients]() {
+        int64_t total = 0;
+        for(auto &c : clients)
+        {
+            total += c->messages();
+        }
+        return total;
+    };
+
+    //预热一秒再开始计时
+    ::sleep(1);
+    int64_t startCount = totalMessages();
+    double startServerCpu = g_serverClocks.cpuSeconds();
+    double startClientCpu = g_clientClocks.cpuSeconds();
+    TimeStamp start(TimeStamp::now());
+    ::usleep(static_cast<useconds_t>(seconds * 1000 * 1000));
+    int64_t count = totalMessages() - startCount;
+    double elapsed = timeDifference(TimeStamp::now(), start);
+    double serverCpu = g_serverClocks.cpuSeconds() - startServerCpu;
+    double clientCpu = g_clientClocks.cpuSeconds() - startClientCpu;
+    g_stopped = true;
+
+    fprintf(stderr, "connections=%d msgSize=%d pipeline=%d server threads=%d client threads=%d\n",
+            connections, msgSize, pipeline, serverThreads, clientThreads);
+    fprintf(stderr, "messages: %ld in %.2fs\n", (long)count, elapsed);
+    fprintf(stderr, "%.1f messages/s  %.3f MiB/s (one direction)\n",
+            count / elapsed, count * static_cast<double>(msgSize) / elapsed / 1024 / 1024);
+    fprintf(stderr, "server cpu: %.1f%%  client cpu: %.1f%%\n",
+            serverCpu / elapsed * 100, clientCpu / elapsed * 100);
+    ::_exit(0); //连接都还在各个loop上，直接退出
+}
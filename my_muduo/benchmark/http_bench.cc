@@ -0,0 +1,182 @@
+#include <my_muduo/HttpServer.h>
+#include <my_muduo/HttpRequest.h>
+#include <my_muduo/HttpResponse.h>
+#include <my_muduo/TcpClient.h>
+#include <my_muduo/EventLoopThread.h>
+#include <my_muduo/logger.h>
+#include "BenchUtil.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+
+/**
+ * 类似wrk的回环压测：进程里起一个HttpServer，再起几个客户端线程，
+ * 每个连接保持pipeline个请求在路上，统计每秒请求数和每个server线程的请求数
+ * 用法：http_bench [port] [server线程数] [client线程数] [连接数] [pipeline深度] [秒数]
+*/
+
+static std::atomic_bool g_stopped(false);
+static std::atomic<int64_t> g_responses(0);
+
+static const char kRequest[] = "GET /hello HTTP/1.1\r\nHost: localhost\r\nUser-Agent: http_bench\r\n\r\n";
+
+static void onHttpRequest(const HttpRequest &req, HttpResponse *resp)
+{
+    if(req.path() == "/hello")
+    {
+        resp->setStatusCode(HttpResponse::k200Ok);
+        resp->setStatusMessage("OK");
+        resp->setContentType("text/plain");
+        resp->setBody("hello, world!\n");
+    }
+    else
+    {
+        resp->setStatusCode(HttpResponse::k404NotFound);
+        resp->setStatusMessage("Not Found");
+        resp->setCloseConnection(true);
+    }
+}
+
+class BenchConnection
+{
+public:
+    BenchConnection(EventLoop *loop, const InetAddress &serverAddr, int pipeline, int id)
+        : client_(loop, serverAddr, "HttpBenchClient" + std::to_string(id))
+        , pipeline_(pipeline)
+    {
+        client_.setConnectionCallback(
+            std::bind(&BenchConnection::onConnection,this,std::placeholders::_1));
+        client_.setMessageCallback(
+            std::bind(&BenchConnection::onMessage,this,
+                std::placeholders::_1,std::placeholders::_2,std::placeholders::_3));
+    }
+
+    void connect() { client_.connect(); }
+
+private:
+    void onConnection(const TcpConnectionPtr &conn)
+    {
+        if(conn->connected())
+        {
+            std::string requests;
+            for(int i = 0; i < pipeline_; ++i)
+            {
+                requests.append(kRequest, sizeof kRequest - 1);
+            }
+            conn->send(requests);
+        }
+    }
+
+    //解析出所有完整的响应，每收到一个就再发一个请求
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, TimeStamp)
+    {
+        int completed = 0;
+        while(true)
+        {
+            const char *begin = buf->peek();
+            const char *end = begin + buf->readableBytes();
+            static const char kHeaderEnd[] = "\r\n\r\n";
+            const char *headerEnd = std::search(begin, end, kHeaderEnd, kHeaderEnd + 4);
+            if(headerEnd == end)
+            {
+                break;
+            }
+            static const char kContentLength[] = "Content-Length:";
+            const char *field = std::search(begin, headerEnd, kContentLength, kContentLength + 15);
+            size_t bodyLen = field == headerEnd ? 0 : strtoul(field + 15, nullptr, 10);
+            size_t total = headerEnd + 4 - begin + bodyLen;
+            if(buf->readableBytes() < total)
+            {
+                break;
+            }
+            buf->retrieve(total);
+            ++completed;
+        }
+
+        if(completed > 0)
+        {
+            g_responses.fetch_add(completed, std::memory_order_relaxed);
+            if(!g_stopped)
+            {
+                std::string requests;
+                for(int i = 0; i < completed; ++i)
+                {
+                    requests.append(kRequest, sizeof kRequest - 1);
+                }
+                conn->send(requests);
+            }
+        }
+    }
+
+    TcpClient client_;
+    int pipeline_;
+};
+
+int main(int argc, char *argv[])
+{
+    uint16_t port = argc > 1 ? static_cast<uint16_t>(atoi(argv[1])) : 8080;
+    int serverThreads = argc > 2 ? atoi(argv[2]) : 1;
+    int clientThreads = argc > 3 ? atoi(argv[3]) : 1;
+    int connections = argc > 4 ? atoi(argv[4]) : 16;
+    int pipeline = argc > 5 ? atoi(argv[5]) : 1;
+    double seconds = argc > 6 ? atof(argv[6]) : 5.0;
+
+    Logger::setLogThreshold(ERROR); //每个连接、每个channel的LOG_INFO会把吞吐拖垮
+    //服务端的应答可能在客户端断开以后才写出去
+    ::signal(SIGPIPE, SIG_IGN);
+
+    EventLoopThread serverThread;
+    EventLoop *serverLoop = serverThread.startLoop();
+    InetAddress listenAddr(port);
+    HttpServer server(serverLoop, listenAddr, "HttpBench");
+    server.setHttpCallback(onHttpRequest);
+    server.setThreadNum(serverThreads);
+    server.start();
+
+    std::vector<std::unique_ptr<EventLoopThread>> clientLoops;
+    for(int i = 0; i < clientThreads; ++i)
+    {
+        clientLoops.emplace_back(new EventLoopThread);
+    }
+    std::vector<EventLoop*> loops;
+    for(auto &t : clientLoops)
+    {
+        loops.push_back(t->startLoop());
+    }
+
+    std::vector<std::unique_ptr<BenchConnection>> clients;
+    for(int i = 0; i < connections; ++i)
+    {
+        clients.emplace_back(new BenchConnection(loops[i % loops.size()], listenAddr, pipeline, i));
+        clients.back()->connect();
+    }
+
+    //预热一秒再开始计时
+    ::sleep(1);
+    int64_t startCount = g_responses.load();
+    double startCpu = processCpuSeconds();
+    TimeStamp start(TimeStamp::now());
+    ::usleep(static_cast<useconds_t>(seconds * 1000 * 1000));
+    int64_t count = g_responses.load() - startCount;
+    double elapsed = timeDifference(TimeStamp::now(), start);
+    double cpu = processCpuSeconds() - startCpu;
+    g_stopped = true;
+
+    double rps = count / elapsed;
+    int workers = serverThreads > 0 ? serverThreads : 1;
+    fprintf(stderr, "connections=%d pipeline=%d server threads=%d client threads=%d\n",
+            connections, pipeline, serverThreads, clientThreads);
+    fprintf(stderr, "requests: %ld in %.2fs\n", (long)count, elapsed);
+    fprintf(stderr, "requests/sec: %.1f  per server thread: %.1f\n", rps, rps / workers);
+    fprintf(stderr, "process cpu: %.1f%% (client and server together)\n", cpu / elapsed * 100);
+    ::_exit(0); //连接都还在各个loop上，直接退出
+}
@@ -0,0 +1,286 @@
+#include <my_muduo/TcpServer.h>
+#include <my_muduo/TcpClient.h>
+#include <my_muduo/EventLoopThread.h>
+#include <my_muduo/LengthHeaderCodec.h>
+#include <my_muduo/Histogram.h>
+#include <my_muduo/Buffer.h>
+#include <my_muduo/logger.h>
+#include "BenchUtil.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * 延迟压测：进程里起一个长度头分帧的echo服务器，客户端按固定速率发请求，统计延迟分位数
+ * open模式：按时间表发送，不管前面的请求有没有回来，延迟从"计划发送时间"算起，
+ *          服务器卡顿时积压的请求也会被计入，没有coordinated omission
+ * closed模式：每个连接同时只有一个请求，收到回复才按时间表发下一个（rate为0就立刻发），
+ *          同时输出原始延迟和按期望间隔修正coordinated omission以后的延迟
+ * 服务端每个loop设置messageHistogram，统计messageCallback的耗时
+ * 用法：latency_bench [port] [server线程数] [client线程数] [连接数] [总请求速率/秒] [open|closed] [msgSize] [秒数]
+*/
+
+static std::atomic_bool g_recording(false);
+static std::atomic_bool g_stopped(false);
+
+//服务端：原样回显每一帧
+static LengthHeaderCodec *g_serverCodec = nullptr;
+
+static void onServerFrame(const TcpConnectionPtr &conn, const char *data, size_t len, TimeStamp)
+{
+    g_serverCodec->send(conn, data, len);
+}
+
+static std::mutex g_histogramMutex;
+static std::vector<std::unique_ptr<Histogram>> g_serverHistograms;
+
+static void installServerHistogram(EventLoop *loop)
+{
+    Histogram *histogram = new Histogram;
+    {
+        std::lock_guard<std::mutex> lock(g_histogramMutex);
+        g_serverHistograms.emplace_back(histogram);
+    }
+    loop->setMessageHistogram(histogram);
+}
+
+//每个客户端loop线程一组直方图，只有这个loop写
+struct ClientThread
+{
+    EventLoop *loop;
+    Histogram latency;   //open模式从计划时间算；closed模式是原始延迟
+    Histogram corrected; //closed模式修正coordinated omission以后的延迟
+};
+
+class LatencyClient
+{
+public:
+    LatencyClient(ClientThread *thread, const InetAddress &serverAddr,
+                bool openLoop, int64_t intervalMicros, int msgSize, int id)
+        : thread_(thread)
+        , client_(thread->loop, serverAddr, "LatencyClient" + std::to_string(id))
+        , codec_(std::bind(&LatencyClient::onFrame,this,
+                std::placeholders::_1,std::placeholders::_2,std::placeholders::_3,std::placeholders::_4))
+        , openLoop_(openLoop)
+        , interval_(intervalMicros)
+        , padding_(msgSize - 8, 'l')
+        , nextSend_(0)
+        , outstanding_(false)
+    {
+        client_.setConnectionCallback(
+            std::bind(&LatencyClient::onConnection,this,std::placeholders::_1));
+        client_.setMessageCallback(
+            std::bind(&LengthHeaderCodec::onMessage,&codec_,
+                std::placeholders::_1,std::placeholders::_2,std::placeholders::_3));
+    }
+
+    void connect() { client_.connect(); }
+
+    //loop线程里每100微秒调用一次，把到了计划时间的请求发出去
+    void tick(int64_t now)
+    {
+        if(!conn_ || g_stopped)
+        {
+            return;
+        }
+        if(openLoop_)
+        {
+            while(nextSend_ <= now)
+            {
+                sendRequest(nextSend_);
+                nextSend_ += interval_;
+            }
+        }
+        else if(!outstanding_ && nextSend_ <= now)
+        {
+            sendRequest(now);
+        }
+    }
+
+private:
+    void onConnection(const TcpConnectionPtr &conn)
+    {
+        if(conn->connected())
+        {
+            conn->setTcpNoDelay(true);
+            conn_ = conn;
+            nextSend_ = nowMicros();
+            tick(nextSend_);
+        }
+        else
+        {
+            conn_.reset();
+        }
+    }
+
+    //请求里带着计时起点：open模式是计划发送时间，closed模式是实际发送时间
+    void sendRequest(int64_t start)
+    {
+        Buffer request;
+        request.appendInt64(start);
+        request.append(padding_.data(), padding_.size());
+        codec_.send(conn_, &request);
+        outstanding_ = true;
+    }
+
+    void onFrame(const TcpConnectionPtr&, const char *data, size_t, TimeStamp)
+    {
+        int64_t start = 0;
+        ::memcpy(&start, data, sizeof start);
+        start = be64toh(start);
+        int64_t now = nowMicros();
+        int64_t latency = now - start;
+        if(g_recording)
+        {
+            thread_->latency.record(latency);
+            if(!openLoop_)
+            {
+                thread_->corrected.recordCorrected(latency, interval_);
+            }
+        }
+        if(!openLoop_)
+        {
+            outstanding_ = false;
+            //按时间表发下一个，已经落后了就立刻发，不补发错过的
+            nextSend_ = interval_ > 0 ? std::max(nextSend_ + interval_, now) : now;
+            tick(now);
+        }
+    }
+
+    ClientThread *thread_;
+    TcpClient client_;
+    LengthHeaderCodec codec_;
+    TcpConnectionPtr conn_;
+    const bool openLoop_;
+    const int64_t interval_; //每个连接两个请求之间的计划间隔，0表示不限速
+    const std::string padding_; //凑够msgSize的填充
+    int64_t nextSend_; //下一个请求的计划发送时间
+    bool outstanding_;
+};
+
+int main(int argc, char *argv[])
+{
+    uint16_t port = argc > 1 ? static_cast<uint16_t>(atoi(argv[1])) : 8892;
+    int serverThreads = argc > 2 ? atoi(argv[2]) : 1;
+    int clientThreads = argc > 3 ? atoi(argv[3]) : 1;
+    int connections = argc > 4 ? atoi(argv[4]) : 16;
+    double rate = argc > 5 ? atof(argv[5]) : 10000;
+    bool openLoop = argc > 6 ? ::strcmp(argv[6], "closed") != 0 : true;
+    int msgSize = argc > 7 ? atoi(argv[7]) : 64;
+    double seconds = argc > 8 ? atof(argv[8]) : 5.0;
+    if(clientThreads < 1 || connections < 1 || msgSize < 8 || rate < 0 || (openLoop && rate == 0))
+    {
+        fprintf(stderr, "Usage: %s [port] [serverThreads] [clientThreads] [connections] [rate] [open|closed] [msgSize>=8] [seconds]\n"
+                "  open mode needs rate > 0; closed mode with rate 0 runs as fast as possible\n", argv[0]);
+        return 1;
+    }
+    int64_t intervalMicros = rate > 0 ? static_cast<int64_t>(connections * 1e6 / rate) : 0;
+
+    Logger::setLogThreshold(ERROR);
+
+    EventLoopThread serverThread(serverThreads == 0 ? installServerHistogram : EventLoopThread::ThreadInitCallback());
+    EventLoop *serverLoop = serverThread.startLoop();
+    InetAddress listenAddr(port);
+    TcpServer server(serverLoop, listenAddr, "LatencyBench");
+    LengthHeaderCodec serverCodec(onServerFrame);
+    g_serverCodec = &serverCodec;
+    server.setConnectionCallback([](const TcpConnectionPtr &conn) {
+        if(conn->connected())
+        {
+            conn->setTcpNoDelay(true);
+        }
+    });
+    server.setMessageCallback(std::bind(&LengthHeaderCodec::onMessage,&serverCodec,
+                std::placeholders::_1,std::placeholders::_2,std::placeholders::_3));
+    server.setThreadNum(serverThreads);
+    if(serverThreads > 0)
+    {
+        server.setThreadInitCallback(installServerHistogram);
+    }
+    server.start();
+
+    std::vector<std::unique_ptr<EventLoopThread>> loopThreads;
+    std::vector<std::unique_ptr<ClientThread>> threads;
+    for(int i = 0; i < clientThreads; ++i)
+    {
+        loopThreads.emplace_back(new EventLoopThread);
+        threads.emplace_back(new ClientThread);
+        threads.back()->loop = loopThreads.back()->startLoop();
+    }
+
+    std::vector<std::unique_ptr<LatencyClient>> clients;
+    std::vector<std::vector<LatencyClient*>> clientsPerThread(clientThreads);
+    for(int i = 0; i < connections; ++i)
+    {
+        ClientThread *thread = threads[i % clientThreads].get();
+        clients.emplace_back(new LatencyClient(thread, listenAddr, openLoop, intervalMicros, msgSize, i));
+        clientsPerThread[i % clientThreads].push_back(clients.back().get());
+    }
+    for(int i = 0; i < clientThreads; ++i)
+    {
+        std::vector<LatencyClient*> list = clientsPerThread[i];
+        threads[i]->loop->runEvery(0.0001, [list]() {
+            int64_t now = nowMicros();
+            for(LatencyClient *c : list)
+            {
+                c->tick(now);
+            }
+        });
+    }
+    for(auto &c : clients)
+    {
+        c->connect();
+    }
+
+    //预热一秒再开始记录
+    ::sleep(1);
+    g_recording = true;
+    TimeStamp start(TimeStamp::now());
+    ::usleep(static_cast<useconds_t>(seconds * 1000 * 1000));
+    g_recording = false;
+    g_stopped = true;
+    double elapsed = timeDifference(TimeStamp::now(), start);
+
+    Histogram latency;
+    Histogram corrected;
+    for(auto &t : threads)
+    {
+        latency.merge(t->latency);
+        corrected.merge(t->corrected);
+    }
+    Histogram serverCallback;
+    {
+        std::lock_guard<std::mutex> lock(g_histogramMutex);
+        for(auto &h : g_serverHistograms)
+        {
+            serverCallback.merge(*h);
+        }
+    }
+
+    fprintf(stderr, "mode=%s rate=%.0f/s connections=%d msgSize=%d server threads=%d client threads=%d\n",
+            openLoop ? "open" : "closed", rate, connections, msgSize, serverThreads, clientThreads);
+    fprintf(stderr, "achieved %.1f responses/s over %.2fs\n", latency.count() / elapsed, elapsed);
+    if(openLoop)
+    {
+        fprintf(stderr, "latency(us, from intended send time): %s\n", latency.summary().c_str());
+    }
+    else
+    {
+        fprintf(stderr, "latency(us, raw):       %s\n", latency.summary().c_str());
+        if(intervalMicros > 0)
+        {
+            fprintf(stderr, "latency(us, corrected): %s\n", corrected.summary().c_str());
+        }
+    }
+    fprintf(stderr, "server messageCallback(ns): %s\n", serverCallback.summary().c_str());
+    ::_exit(0); //连接都还在各个loop上，直接退出
+}
@@ -0,0 +1,510 @@
+#include <my_muduo/Buffer.h>
+#include <my_muduo/Channel.h>
+#include <my_muduo/EventLoop.h>
+#include <my_muduo/EventLoopThread.h>
+#include <my_muduo/logger.h>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+
+/**
+ * 热路径原语的微基准，不依赖第三方库：
+ *   Buffer::append/makeSpace/readFd，EventLoop::runInLoop/queueInLoop，
+ *   Channel::handleEvent分发，LOG_INFO开关两种情况
+ * 每个用例自动加倍迭代次数直到跑满最短时间，输出ns/op和allocs/op（重载operator new计数）
+ * 用法：microbench [--filter 子串] [--min-time 秒] [--json 输出文件] [--compare 基准json文件]
+ * 比较时两份结果按名字对齐，打印变化的百分比，慢了超过10%的标出来
+*/
+
+//全局operator new计数，统计每次操作分配了几次内存
+static std::atomic<int64_t> g_allocs(0);
+
+void* operator new(size_t size)
+{
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    void *p = ::malloc(size == 0 ? 1 : size);
+    if(p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    ::free(p);
+}
+
+static int64_t nowNanos()
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+//用例拿到迭代次数，做完准备工作以后可以调用resetTimer把准备的时间和分配排除掉
+class BenchState
+{
+public:
+    explicit BenchState(int64_t iterations)
+        : iterations_(iterations)
+    {
+        resetTimer();
+    }
+
+    int64_t iterations() const { return iterations_; }
+
+    void resetTimer()
+    {
+        start_ = nowNanos();
+        startAllocs_ = g_allocs.load(std::memory_order_relaxed);
+    }
+
+    int64_t elapsedNanos() const { return nowNanos() - start_; }
+    int64_t allocs() const { return g_allocs.load(std::memory_order_relaxed) - startAllocs_; }
+
+private:
+    int64_t iterations_;
+    int64_t start_;
+    int64_t startAllocs_;
+};
+
+using BenchFunc = std::function<void(BenchState&)>;
+
+struct Benchmark
+{
+    std::string name;
+    BenchFunc func;
+};
+
+struct Result
+{
+    std::string name;
+    int64_t iterations;
+    double nsPerOp;
+    double allocsPerOp;
+};
+
+static std::vector<Benchmark> g_benchmarks;
+
+static void registerBench(const std::string &name, BenchFunc func)
+{
+    g_benchmarks.push_back(Benchmark{name, std::move(func)});
+}
+
+//防止编译器把结果优化掉
+static void doNotOptimize(const void *p)
+{
+    asm volatile("" : : "g"(p) : "memory");
+}
+
+static Result runBench(const Benchmark &bench, double minSeconds)
+{
+    int64_t iterations = 1;
+    while(true)
+    {
+        BenchState state(iterations);
+        bench.func(state);
+        int64_t elapsed = state.elapsedNanos();
+        int64_t allocs = state.allocs();
+        if(elapsed >= minSeconds * 1e9 || iterations >= (INT64_C(1) << 40))
+        {
+            return Result{bench.name, iterations,
+                        static_cast<double>(elapsed) / iterations,
+                        static_cast<double>(allocs) / iterations};
+        }
+        //按这次的耗时估计下一次需要的次数，最多放大10倍
+        double scale = elapsed > 0 ? minSeconds * 1e9 * 1.2 / elapsed : 10;
+        if(scale > 10)
+        {
+            scale = 10;
+        }
+        if(scale < 2)
+        {
+            scale = 2;
+        }
+        iterations = static_cast<int64_t>(iterations * scale);
+    }
+}
+
+// ---------------------------- Buffer ----------------------------
+
+static void benchBufferAppend(BenchState &state, size_t size)
+{
+    std::string data(size, 'b');
+    Buffer buf;
+    buf.append(data.data(), data.size()); //让buffer先长到需要的大小
+    buf.retrieveAll();
+    state.resetTimer();
+    for(int64_t i = 0; i < state.iterations(); ++i)
+    {
+        buf.append(data.data(), data.size());
+        buf.retrieveAll();
+    }
+    doNotOptimize(buf.peek());
+}
+
+//每次读走一半，可写空间不够时makeSpace把数据挪到前面，不扩容
+static void benchBufferMakeSpaceMove(BenchState &state, size_t size)
+{
+    std::string data(size, 'm');
+    Buffer buf(size * 2);
+    state.resetTimer();
+    for(int64_t i = 0; i < state.iterations(); ++i)
+    {
+        buf.append(data.data(), data.size());
+        buf.retrieve(buf.readableBytes() > size ? size : buf.readableBytes() / 2);
+    }
+    doNotOptimize(buf.peek());
+}
+
+//新buffer不停追加直到size，触发vector扩容
+static void benchBufferGrow(BenchState &state, size_t size)
+{
+    static const char chunk[128] = {0};
+    for(int64_t i = 0; i < state.iterations(); ++i)
+    {
+        Buffer buf;
+        for(size_t n = 0; n < size; n += sizeof chunk)
+        {
+            buf.append(chunk, sizeof chunk);
+        }
+        doNotOptimize(buf.peek());
+    }
+}
+
+//socketpair一端写size字节，另一端readFd读出来，包含两次系统调用
+static void benchBufferReadFd(BenchState &state, size_t size)
+{
+    int fds[2];
+    if(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+    {
+        ::perror("socketpair");
+        ::exit(1);
+    }
+    int sndbuf = static_cast<int>(size * 4);
+    ::setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof sndbuf);
+    ::setsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &sndbuf, sizeof sndbuf);
+    std::string data(size, 'r');
+    Buffer buf;
+    int savedErrno = 0;
+    state.resetTimer();
+    for(int64_t i = 0; i < state.iterations(); ++i)
+    {
+        size_t written = 0;
+        while(written < size)
+        {
+            ssize_t n = ::write(fds[0], data.data() + written, size - written);
+            if(n <= 0)
+            {
+                break;
+            }
+            written += n;
+            while(buf.readableBytes() < written)
+            {
+                if(buf.readFd(fds[1], &savedErrno) <= 0)
+                {
+                    break;
+                }
+            }
+        }
+        buf.retrieveAll();
+    }
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+// ---------------------------- EventLoop ----------------------------
+
+//所有EventLoop用例共用一个loop线程
+static EventLoop* benchLoop()
+{
+    static EventLoopThread thread;
+    static EventLoop *loop = thread.startLoop();
+    return loop;
+}
+
+static void waitUntil(const std::atomic<int64_t> &counter, int64_t target)
+{
+    while(counter.load(std::memory_order_acquire) < target)
+    {
+        std::this_thread::yield();
+    }
+}
+
+//loop线程里调用runInLoop，直接执行
+static void benchRunInLoopSameThread(BenchState &state)
+{
+    EventLoop *loop = benchLoop();
+    std::atomic<int64_t> done(0);
+    int64_t iterations = state.iterations();
+    state.resetTimer();
+    //放在定时器回调里跑，和channel回调里调用的情况一样
+    loop->runAfter(0, [loop, &done, iterations]() {
+        int64_t count = 0;
+        for(int64_t i = 0; i < iterations; ++i)
+        {
+            loop->runInLoop([&count]() { ++count; });
+        }
+        done.store(count, std::memory_order_release);
+    });
+    waitUntil(done, iterations);
+}
+
+//loop线程里调用queueInLoop，回调在本轮的doPendingFunctors里执行
+static void benchQueueInLoopSameThread(BenchState &state)
+{
+    EventLoop *loop = benchLoop();
+    std::atomic<int64_t> done(0);
+    int64_t iterations = state.iterations();
+    state.resetTimer();
+    loop->runAfter(0, [loop, &done, iterations]() {
+        for(int64_t i = 0; i < iterations; ++i)
+        {
+            loop->queueInLoop([&done]() { done.fetch_add(1, std::memory_order_release); });
+        }
+    });
+    waitUntil(done, iterations);
+}
+
+//producers个线程同时往loop投递，每次投递都可能写一次eventfd唤醒
+static void benchQueueInLoopCrossThread(BenchState &state, int producers)
+{
+    EventLoop *loop = benchLoop();
+    std::atomic<int64_t> done(0);
+    int64_t perThread = state.iterations() / producers + 1;
+    int64_t total = perThread * producers;
+    std::vector<std::thread> threads;
+    state.resetTimer();
+    for(int t = 0; t < producers; ++t)
+    {
+        threads.emplace_back([loop, &done, perThread]() {
+            for(int64_t i = 0; i < perThread; ++i)
+            {
+                loop->queueInLoop([&done]() { done.fetch_add(1, std::memory_order_release); });
+            }
+        });
+    }
+    for(std::thread &t : threads)
+    {
+        t.join();
+    }
+    waitUntil(done, total);
+}
+
+// ---------------------------- Channel ----------------------------
+
+//直接调用handleEvent，测分发（tie的weak_ptr提升 + revents判断 + std::function调用）的开销
+static void benchChannelHandleEvent(BenchState &state, bool tied)
+{
+    EventLoop *loop = benchLoop();
+    Channel channel(loop, -1);
+    int64_t reads = 0;
+    channel.setReadCallback([&reads](TimeStamp) { ++reads; });
+    std::shared_ptr<int> owner(new int(0));
+    if(tied)
+    {
+        channel.tie(owner);
+    }
+    channel.set_revents(EPOLLIN);
+    TimeStamp now(TimeStamp::now());
+    state.resetTimer();
+    for(int64_t i = 0; i < state.iterations(); ++i)
+    {
+        channel.handleEvent(now);
+    }
+    doNotOptimize(&reads);
+}
+
+// ---------------------------- Logging ----------------------------
+
+//门限以下的LOG_INFO只剩一次比较
+static void benchLogDisabled(BenchState &state)
+{
+    int saved = Logger::logThreshold();
+    Logger::setLogThreshold(ERROR);
+    for(int64_t i = 0; i < state.iterations(); ++i)
+    {
+        LOG_INFO("microbench %ld %s", static_cast<long>(i), "disabled");
+    }
+    Logger::setLogThreshold(saved);
+}
+
+//真正格式化并写出去，stdout临时重定向到/dev/null
+static void benchLogEnabled(BenchState &state)
+{
+    fflush(stdout);
+    int savedStdout = ::dup(STDOUT_FILENO);
+    int devNull = ::open("/dev/null", O_WRONLY);
+    ::dup2(devNull, STDOUT_FILENO);
+    int saved = Logger::logThreshold();
+    Logger::setLogThreshold(INFO);
+    state.resetTimer();
+    for(int64_t i = 0; i < state.iterations(); ++i)
+    {
+        LOG_INFO("microbench %ld %s", static_cast<long>(i), "enabled");
+    }
+    Logger::setLogThreshold(saved);
+    fflush(stdout);
+    ::dup2(savedStdout, STDOUT_FILENO);
+    ::close(savedStdout);
+    ::close(devNull);
+}
+
+static void registerAll()
+{
+    const size_t sizes[] = {16, 256, 4096, 65536};
+    for(size_t size : sizes)
+    {
+        std::string suffix = "/" + std::to_string(size);
+        registerBench("Buffer.append" + suffix, [size](BenchState &s) { benchBufferAppend(s, size); });
+        registerBench("Buffer.makeSpaceMove" + suffix, [size](BenchState &s) { benchBufferMakeSpaceMove(s, size); });
+        registerBench("Buffer.grow" + suffix, [size](BenchState &s) { benchBufferGrow(s, size); });
+        registerBench("Buffer.readFd" + suffix, [size](BenchState &s) { benchBufferReadFd(s, size); });
+    }
+    registerBench("EventLoop.runInLoop/sameThread", benchRunInLoopSameThread);
+    registerBench("EventLoop.queueInLoop/sameThread", benchQueueInLoopSameThread);
+    const int producers[] = {1, 2, 4};
+    for(int p : producers)
+    {
+        registerBench("EventLoop.queueInLoop/crossThread/" + std::to_string(p),
+                    [p](BenchState &s) { benchQueueInLoopCrossThread(s, p); });
+    }
+    registerBench("Channel.handleEvent/untied", [](BenchState &s) { benchChannelHandleEvent(s, false); });
+    registerBench("Channel.handleEvent/tied", [](BenchState &s) { benchChannelHandleEvent(s, true); });
+    registerBench("Log.info/disabled", benchLogDisabled);
+    registerBench("Log.info/enabled", benchLogEnabled);
+}
+
+// ---------------------------- JSON ----------------------------
+
+//每个用例一行，方便不引入json库也能读回来
+static bool saveJson(const std::string &path, const std::vector<Result> &results)
+{
+    FILE *fp = ::fopen(path.c_str(), "w");
+    if(fp == nullptr)
+    {
+        ::perror(path.c_str());
+        return false;
+    }
+    fprintf(fp, "{\"benchmarks\": [\n");
+    for(size_t i = 0; i < results.size(); ++i)
+    {
+        const Result &r = results[i];
+        fprintf(fp, "  {\"name\": \"%s\", \"iterations\": %ld, \"ns_per_op\": %.3f, \"allocs_per_op\": %.4f}%s\n",
+                r.name.c_str(), static_cast<long>(r.iterations), r.nsPerOp, r.allocsPerOp,
+                i + 1 < results.size() ? "," : "");
+    }
+    fprintf(fp, "]}\n");
+    ::fclose(fp);
+    return true;
+}
+
+static bool loadJson(const std::string &path, std::map<std::string, Result> *results)
+{
+    FILE *fp = ::fopen(path.c_str(), "r");
+    if(fp == nullptr)
+    {
+        ::perror(path.c_str());
+        return false;
+    }
+    char line[1024];
+    while(::fgets(line, sizeof line, fp))
+    {
+        char name[256];
+        long iterations = 0;
+        double ns = 0;
+        double allocs = 0;
+        if(::sscanf(line, " {\"name\": \"%255[^\"]\", \"iterations\": %ld, \"ns_per_op\": %lf, \"allocs_per_op\": %lf",
+                    name, &iterations, &ns, &allocs) == 4)
+        {
+            (*results)[name] = Result{name, iterations, ns, allocs};
+        }
+    }
+    ::fclose(fp);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    std::string filter;
+    std::string jsonPath;
+    std::string comparePath;
+    double minSeconds = 0.2;
+    for(int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if(arg == "--filter" && i + 1 < argc)
+        {
+            filter = argv[++i];
+        }
+        else if(arg == "--min-time" && i + 1 < argc)
+        {
+            minSeconds = atof(argv[++i]);
+        }
+        else if(arg == "--json" && i + 1 < argc)
+        {
+            jsonPath = argv[++i];
+        }
+        else if(arg == "--compare" && i + 1 < argc)
+        {
+            comparePath = argv[++i];
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [--filter substr] [--min-time seconds] [--json out.json] [--compare base.json]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::map<std::string, Result> baseline;
+    if(!comparePath.empty() && !loadJson(comparePath, &baseline))
+    {
+        return 1;
+    }
+
+    //用例里的LOG_INFO（EventLoop、Channel）不计入，只有Log.info/enabled自己打开
+    Logger::setLogThreshold(ERROR);
+    registerAll();
+
+    std::vector<Result> results;
+    fprintf(stderr, "%-42s %14s %12s %12s", "benchmark", "iterations", "ns/op", "allocs/op");
+    fprintf(stderr, baseline.empty() ? "\n" : " %12s %9s\n", "base ns/op", "change");
+    for(const Benchmark &bench : g_benchmarks)
+    {
+        if(!filter.empty() && bench.name.find(filter) == std::string::npos)
+        {
+            continue;
+        }
+        Result r = runBench(bench, minSeconds);
+        results.push_back(r);
+        fprintf(stderr, "%-42s %14ld %12.1f %12.3f", r.name.c_str(),
+                static_cast<long>(r.iterations), r.nsPerOp, r.allocsPerOp);
+        auto it = baseline.find(r.name);
+        if(it != baseline.end() && it->second.nsPerOp > 0)
+        {
+            double change = (r.nsPerOp - it->second.nsPerOp) / it->second.nsPerOp * 100;
+            fprintf(stderr, " %12.1f %+8.1f%%%s", it->second.nsPerOp, change, change > 10 ? "  <- slower" : "");
+        }
+        fprintf(stderr, "\n");
+    }
+
+    if(!jsonPath.empty() && !saveJson(jsonPath, results))
+    {
+        return 1;
+    }
+    ::_exit(0); //benchLoop的线程还在跑，直接退出
+}
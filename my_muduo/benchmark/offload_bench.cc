@@ -0,0 +1,129 @@
+#include <my_muduo/EventLoop.h>
+#include <my_muduo/EventLoopThread.h>
+#include <my_muduo/ComputePool.h>
+#include <my_muduo/Histogram.h>
+#include <my_muduo/logger.h>
+#include "BenchUtil.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <random>
+#include <future>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * CPU密集任务的卸载测试：一个loop线程每轮事件循环产生一个任务，任务时长在[minUs, maxUs]之间按对数均匀分布（差几个数量级），
+ * inline模式在loop线程里直接算，offload模式用 EventLoop::offload 交给计算线程池，结果回到loop线程
+ * 同时loop上有一个1ms的定时器，统计它的延迟：inline模式下loop被长任务卡住，offload模式下应该一直是准时的
+ * 输出任务吞吐、端到端延迟（从产生到continuation执行）、线程池利用率、偷取次数和排队时间
+ * 用法：offload_bench [inline|offload] [pool线程数] [任务数] [minUs] [maxUs]
+*/
+
+int main(int argc, char *argv[])
+{
+    bool offload = !(argc > 1 && strcmp(argv[1], "inline") == 0);
+    int threads = argc > 2 ? atoi(argv[2]) : 4;
+    int tasks = argc > 3 ? atoi(argv[3]) : 2000;
+    double minUs = argc > 4 ? atof(argv[4]) : 1;
+    double maxUs = argc > 5 ? atof(argv[5]) : 10000;
+    if(threads < 1 || tasks < 1 || minUs <= 0 || maxUs < minUs)
+    {
+        fprintf(stderr, "Usage: %s [inline|offload] [poolThreads] [tasks] [minUs] [maxUs]\n", argv[0]);
+        return 1;
+    }
+
+    Logger::setLogThreshold(ERROR);
+
+    //任务时长提前生成好，两种模式用同一组
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> logUniform(log(minUs), log(maxUs));
+    std::vector<int64_t> durations(tasks);
+    int64_t totalWork = 0;
+    for(int64_t &d : durations)
+    {
+        d = static_cast<int64_t>(exp(logUniform(rng)) * 1000);
+        totalWork += d;
+    }
+
+    ComputePool pool(threads, "bench");
+    pool.start();
+
+    EventLoopThread loopThread;
+    EventLoop *loop = loopThread.startLoop();
+    loop->setComputePool(&pool);
+
+    //loop线程独占的统计，只在loop线程里写
+    std::unique_ptr<Histogram> endToEnd(new Histogram);
+    std::unique_ptr<Histogram> timerLag(new Histogram);
+    std::promise<void> allDone;
+    int completed = 0;
+    int64_t start = 0;
+
+    //1ms的定时器，记录实际触发时间比预期晚了多少
+    int64_t expected = 0;
+    loop->runInLoop([&]() {
+        expected = nowNanos() + 1000 * 1000;
+        loop->runEvery(0.001, [&]() {
+            int64_t now = nowNanos();
+            timerLag->record(now - expected);
+            expected = now + 1000 * 1000;
+        });
+    });
+
+    //每轮loop产生一个任务，模拟请求不断到来
+    int next = 0;
+    std::function<void()> produce = [&]() {
+        if(next >= tasks)
+        {
+            return;
+        }
+        int64_t created = nowNanos();
+        int64_t d = durations[next++];
+        auto done = [&, created]() {
+            endToEnd->record(nowNanos() - created);
+            if(++completed == tasks)
+            {
+                allDone.set_value();
+            }
+        };
+        if(offload)
+        {
+            loop->offload([d]() { burn(d); }, done);
+        }
+        else
+        {
+            burn(d);
+            done();
+        }
+        loop->queueInLoop(produce);
+    };
+    loop->runInLoop([&]() {
+        start = nowNanos();
+        produce();
+    });
+
+    allDone.get_future().wait();
+    double elapsed = (nowNanos() - start) / 1e9;
+    std::unique_ptr<Histogram> queueLatency(new Histogram);
+    pool.mergeQueueLatency(queueLatency.get());
+
+    int workers = offload ? threads : 1;
+    fprintf(stderr, "mode=%s pool threads=%d tasks=%d task size %.0f..%.0f us (log-uniform), total work %.3fs\n",
+            offload ? "offload" : "inline", threads, tasks, minUs, maxUs, totalWork / 1e9);
+    fprintf(stderr, "elapsed %.3fs  %.0f tasks/s  utilisation %.1f%% of %d threads\n",
+            elapsed, tasks / elapsed, totalWork / 1e9 / elapsed / workers * 100, workers);
+    fprintf(stderr, "end-to-end ns:  %s\n", endToEnd->summary().c_str());
+    fprintf(stderr, "1ms timer lag ns: %s\n", timerLag->summary().c_str());
+    if(offload)
+    {
+        fprintf(stderr, "pool queue ns:  %s\n", queueLatency->summary().c_str());
+        fprintf(stderr, "steals %ld of %ld tasks\n", (long)pool.steals(), (long)pool.completed());
+    }
+    ::_exit(0);
+}
@@ -0,0 +1,134 @@
+#include <my_muduo/TcpClient.h>
+#include <my_muduo/EventLoopThread.h>
+#include <my_muduo/logger.h>
+#include "BenchUtil.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <functional>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/**
+ * pingpong客户端：每个会话先发一个blockSize的消息，之后收到什么就发回什么，
+ * 数据在客户端和服务端之间来回弹，统计一段时间内收到的字节数
+ * 用法：pingpong_client [ip] [port] [线程数] [blockSize] [会话数] [秒数]
+*/
+
+static std::atomic_bool g_stopped(false);
+
+class Session
+{
+public:
+    Session(EventLoop *loop, const InetAddress &serverAddr, const std::string &message, int id)
+        : client_(loop, serverAddr, "PingPongClient" + std::to_string(id))
+        , message_(message)
+        , bytesRead_(0)
+        , messagesRead_(0)
+    {
+        client_.setConnectionCallback(
+            std::bind(&Session::onConnection,this,std::placeholders::_1));
+        client_.setMessageCallback(
+            std::bind(&Session::onMessage,this,
+                std::placeholders::_1,std::placeholders::_2,std::placeholders::_3));
+    }
+
+    void connect() { client_.connect(); }
+
+    int64_t bytesRead() const { return bytesRead_.load(std::memory_order_relaxed); }
+    int64_t messagesRead() const { return messagesRead_.load(std::memory_order_relaxed); }
+
+private:
+    void onConnection(const TcpConnectionPtr &conn)
+    {
+        if(conn->connected())
+        {
+            conn->setTcpNoDelay(true);
+            conn->send(message_);
+        }
+    }
+
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, TimeStamp)
+    {
+        //只有loop线程写，主线程读，relaxed就够了
+        bytesRead_.fetch_add(buf->readableBytes(), std::memory_order_relaxed);
+        messagesRead_.fetch_add(1, std::memory_order_relaxed);
+        if(g_stopped)
+        {
+            buf->retrieveAll();
+            return;
+        }
+        conn->send(buf);
+    }
+
+    TcpClient client_;
+    const std::string &message_;
+    std::atomic<int64_t> bytesRead_;
+    std::atomic<int64_t> messagesRead_;
+};
+
+int main(int argc, char *argv[])
+{
+    const char *ip = argc > 1 ? argv[1] : "127.0.0.1";
+    uint16_t port = argc > 2 ? static_cast<uint16_t>(atoi(argv[2])) : 8888;
+    int threads = argc > 3 ? atoi(argv[3]) : 1;
+    int blockSize = argc > 4 ? atoi(argv[4]) : 16384;
+    int sessions = argc > 5 ? atoi(argv[5]) : 100;
+    double seconds = argc > 6 ? atof(argv[6]) : 10.0;
+    if(threads < 1 || blockSize < 1 || sessions < 1)
+    {
+        fprintf(stderr, "Usage: %s [ip] [port] [threads] [blockSize] [sessions] [seconds]\n", argv[0]);
+        return 1;
+    }
+
+    Logger::setLogThreshold(ERROR);
+
+    std::string message;
+    for(int i = 0; i < blockSize; ++i)
+    {
+        message.push_back(static_cast<char>(i % 128));
+    }
+
+    std::vector<std::unique_ptr<EventLoopThread>> threadList;
+    std::vector<EventLoop*> loops;
+    for(int i = 0; i < threads; ++i)
+    {
+        threadList.emplace_back(new EventLoopThread);
+        loops.push_back(threadList.back()->startLoop());
+    }
+
+    InetAddress serverAddr(port, ip);
+    std::vector<std::unique_ptr<Session>> sessionList;
+    for(int i = 0; i < sessions; ++i)
+    {
+        sessionList.emplace_back(new Session(loops[i % loops.size()], serverAddr, message, i));
+        sessionList.back()->connect();
+    }
+
+    double startCpu = processCpuSeconds();
+    TimeStamp start(TimeStamp::now());
+    ::usleep(static_cast<useconds_t>(seconds * 1000 * 1000));
+    g_stopped = true;
+    double elapsed = timeDifference(TimeStamp::now(), start);
+    double cpu = processCpuSeconds() - startCpu;
+
+    int64_t bytes = 0;
+    int64_t reads = 0;
+    for(auto &s : sessionList)
+    {
+        bytes += s->bytesRead();
+        reads += s->messagesRead();
+    }
+
+    fprintf(stderr, "threads=%d blockSize=%d sessions=%d time=%.2fs\n",
+            threads, blockSize, sessions, elapsed);
+    fprintf(stderr, "%ld total bytes read, %ld total reads, %.1f average read size\n",
+            (long)bytes, (long)reads, reads > 0 ? static_cast<double>(bytes) / reads : 0.0);
+    fprintf(stderr, "%.3f MiB/s throughput\n", bytes / elapsed / 1024 / 1024);
+    fprintf(stderr, "%.1f messages/s (%d bytes each)\n", bytes / elapsed / blockSize, blockSize);
+    fprintf(stderr, "client cpu: %.1f%%\n", cpu / elapsed * 100);
+    ::_exit(0); //连接还挂在各个loop上，直接退出
+}
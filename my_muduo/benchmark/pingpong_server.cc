@@ -0,0 +1,155 @@
+#include <my_muduo/TcpServer.h>
+#include <my_muduo/MetricsServer.h>
+#include <my_muduo/StatsPublisher.h>
+#include <my_muduo/logger.h>
+#include "BenchUtil.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <functional>
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * pingpong服务端：收到什么就原样发回去，配合pingpong_client测吞吐
+ * 每隔几秒打印一次这段时间的吞吐和进程cpu占用
+ * 用法：pingpong_server [port] [线程数] [打印间隔秒数] [metrics端口，0表示不开] [--tcp-info] [--shm-stats] [--top N]
+ * 下面几个观测功能会影响要测的吞吐，默认都关掉：
+ *   --tcp-info  每秒采样每个连接的TCP_INFO
+ *   --shm-stats 把统计发布到共享内存，运行时可以用 muduo-top <pid> 看每个loop的实时速率
+ *   --top N     每次打印时附带流量最大的N个连接
+*/
+
+static std::atomic<int64_t> g_bytes(0);
+static std::atomic<int64_t> g_reads(0);
+
+static void onConnection(const TcpConnectionPtr &conn)
+{
+    if(conn->connected())
+    {
+        conn->setTcpNoDelay(true);
+    }
+}
+
+static void onMessage(const TcpConnectionPtr &conn, Buffer *buf, TimeStamp)
+{
+    g_bytes.fetch_add(buf->readableBytes(), std::memory_order_relaxed);
+    g_reads.fetch_add(1, std::memory_order_relaxed);
+    conn->send(buf);
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<std::string> args;
+    bool tcpInfo = false;
+    bool shmStats = false;
+    size_t topN = 0;
+    for(int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if(arg == "--tcp-info")
+        {
+            tcpInfo = true;
+        }
+        else if(arg == "--shm-stats")
+        {
+            shmStats = true;
+        }
+        else if(arg == "--top" && i + 1 < argc)
+        {
+            topN = static_cast<size_t>(atoi(argv[++i]));
+        }
+        else if(arg.compare(0, 2, "--") == 0)
+        {
+            fprintf(stderr, "Usage: %s [port] [threads] [interval] [metricsPort] [--tcp-info] [--shm-stats] [--top N]\n", argv[0]);
+            return 1;
+        }
+        else
+        {
+            args.push_back(arg);
+        }
+    }
+    uint16_t port = args.size() > 0 ? static_cast<uint16_t>(atoi(args[0].c_str())) : 8888;
+    int threads = args.size() > 1 ? atoi(args[1].c_str()) : 0;
+    double interval = args.size() > 2 ? atof(args[2].c_str()) : 5.0;
+    uint16_t metricsPort = args.size() > 3 ? static_cast<uint16_t>(atoi(args[3].c_str())) : 0;
+
+    Logger::setLogThreshold(ERROR); //热路径上的LOG_INFO会把吞吐拖垮
+
+    EventLoop loop;
+    InetAddress listenAddr(port);
+    TcpServer server(&loop, listenAddr, "PingPongServer");
+    server.setConnectionCallback(onConnection);
+    server.setMessageCallback(onMessage);
+    server.setThreadNum(threads);
+    if(tcpInfo)
+    {
+        server.setTcpInfoInterval(1.0);
+    }
+    server.start();
+    fprintf(stderr, "pingpong_server listening on %u, %d io threads\n", port, threads);
+
+    //管理端口和服务共用base loop，curl http://127.0.0.1:<metrics端口>/metrics
+    std::unique_ptr<MetricsServer> metrics;
+    if(metricsPort > 0)
+    {
+        metrics.reset(new MetricsServer(&loop, InetAddress(metricsPort), "PingPongMetrics"));
+        metrics->start();
+    }
+
+    //发布到共享内存，muduo-top读的时候不经过socket
+    std::unique_ptr<StatsPublisher> publisher;
+    if(shmStats)
+    {
+        publisher.reset(new StatsPublisher(&loop, 1.0));
+        if(publisher->start())
+        {
+            fprintf(stderr, "stats published to %s\n", publisher->shmName().c_str());
+        }
+    }
+
+    int64_t lastBytes = 0;
+    int64_t lastReads = 0;
+    double lastCpu = processCpuSeconds();
+    TimeStamp last(TimeStamp::now());
+    loop.runEvery(interval, [&]() {
+        int64_t bytes = g_bytes.load(std::memory_order_relaxed);
+        int64_t reads = g_reads.load(std::memory_order_relaxed);
+        double cpu = processCpuSeconds();
+        TimeStamp now(TimeStamp::now());
+        double elapsed = timeDifference(now, last);
+        fprintf(stderr, "%.3f MiB/s  %.1f reads/s  avg read %.1f bytes  cpu %.1f%%\n",
+                (bytes - lastBytes) / elapsed / 1024 / 1024,
+                (reads - lastReads) / elapsed,
+                reads > lastReads ? static_cast<double>(bytes - lastBytes) / (reads - lastReads) : 0.0,
+                (cpu - lastCpu) / elapsed * 100);
+        lastBytes = bytes;
+        lastReads = reads;
+        lastCpu = cpu;
+        last = now;
+
+        //流量最大的几个连接，各个io loop自己生成快照，不用停下来
+        if(topN == 0)
+        {
+            return;
+        }
+        server.collectConnectionStats([topN](std::vector<ConnectionStats> &&stats) {
+            size_t top = std::min<size_t>(topN, stats.size());
+            std::partial_sort(stats.begin(), stats.begin() + top, stats.end(),
+                [](const ConnectionStats &a, const ConnectionStats &b) {
+                    return a.bytesRead + a.bytesWritten > b.bytesRead + b.bytesWritten;
+                });
+            for(size_t i = 0; i < top; ++i)
+            {
+                const ConnectionStats &c = stats[i];
+                fprintf(stderr, "  %s %s read %ld written %ld eagain %ld maxOutput %zu rtt %uus cwnd %u retrans %u\n",
+                        c.name.c_str(), c.peer.c_str(), (long)c.bytesRead, (long)c.bytesWritten,
+                        (long)c.writeEagain, c.maxOutputBufferBytes, c.rttMicros, c.sendCwnd, c.totalRetrans);
+            }
+        });
+    });
+    loop.loop();
+}
@@ -0,0 +1,147 @@
+#include <my_muduo/TcpServer.h>
+#include <my_muduo/ConnectionPool.h>
+#include <my_muduo/EventLoopThread.h>
+#include <my_muduo/logger.h>
+
+#include <string>
+#include <functional>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * 连接池的回环压测：同一个echo后端，
+ * 先测每个请求都新建连接（maxIdle=0，用完就关），再测复用池子里的连接
+ * 用法：pool_bench [port] [并发数] [每轮秒数]
+*/
+
+static const size_t kRequestSize = 16;
+
+class PoolBench
+{
+public:
+    PoolBench(EventLoop *loop, const InetAddress &backend, size_t maxIdle, int sessions)
+        : loop_(loop)
+        , backend_(backend)
+        , pool_(loop, "PoolBench", maxIdle)
+        , sessions_(sessions)
+        , request_(kRequestSize, 'x')
+        , completed_(0)
+        , stopped_(false)
+    {
+    }
+
+    void start()
+    {
+        for(int i = 0; i < sessions_; ++i)
+        {
+            issue();
+        }
+    }
+
+    void stop() { stopped_ = true; }
+
+    int64_t completed() const { return completed_; }
+    const ConnectionPool& pool() const { return pool_; }
+
+private:
+    //发起一次请求：从池子里拿连接，发请求，等回包
+    void issue()
+    {
+        if(stopped_)
+        {
+            return;
+        }
+        pool_.acquire(backend_, std::bind(&PoolBench::onAcquire,this,std::placeholders::_1));
+    }
+
+    void onAcquire(const TcpConnectionPtr &conn)
+    {
+        if(!conn)
+        {
+            //后端连不上，过一会儿再试
+            loop_->runAfter(0.1, std::bind(&PoolBench::issue,this));
+            return;
+        }
+        conn->setMessageCallback(
+            std::bind(&PoolBench::onResponse,this,
+                std::placeholders::_1,std::placeholders::_2,std::placeholders::_3));
+        conn->send(request_);
+    }
+
+    void onResponse(const TcpConnectionPtr &conn, Buffer *buf, TimeStamp)
+    {
+        if(buf->readableBytes() < kRequestSize)
+        {
+            return;
+        }
+        buf->retrieve(kRequestSize);
+        ++completed_;
+        pool_.release(conn);
+        issue();
+    }
+
+    EventLoop *loop_;
+    InetAddress backend_;
+    ConnectionPool pool_;
+    int sessions_;
+    std::string request_;
+    int64_t completed_;
+    bool stopped_;
+};
+
+static void onEcho(const TcpConnectionPtr &conn, Buffer *buf, TimeStamp)
+{
+    conn->send(buf->retrieveAllAsString());
+}
+
+static void onServerConnection(const TcpConnectionPtr&)
+{
+}
+
+//跑一轮，返回每秒完成的请求数
+static double runOnce(const InetAddress &backend, size_t maxIdle, int sessions, double seconds,
+                      int64_t *created)
+{
+    EventLoop loop;
+    PoolBench bench(&loop, backend, maxIdle, sessions);
+    bench.start();
+    loop.runAfter(seconds, [&]()
+    {
+        bench.stop();
+        loop.quit();
+    });
+    TimeStamp start(TimeStamp::now());
+    loop.loop();
+    double elapsed = timeDifference(TimeStamp::now(), start);
+    *created = bench.pool().createdCount();
+    return bench.completed() / elapsed;
+}
+
+int main(int argc, char *argv[])
+{
+    uint16_t port = argc > 1 ? static_cast<uint16_t>(atoi(argv[1])) : 9981;
+    int sessions = argc > 2 ? atoi(argv[2]) : 16;
+    double seconds = argc > 3 ? atof(argv[3]) : 3.0;
+
+    Logger::setLogThreshold(ERROR); //每个连接的LOG_INFO会把吞吐拖垮
+
+    //后端echo服务器跑在单独的线程里
+    EventLoopThread serverThread;
+    EventLoop *serverLoop = serverThread.startLoop();
+    InetAddress listenAddr(port);
+    TcpServer server(serverLoop, listenAddr, "PoolBenchServer");
+    server.setConnectionCallback(onServerConnection);
+    server.setMessageCallback(onEcho);
+    server.start();
+
+    int64_t freshConns = 0;
+    int64_t pooledConns = 0;
+    double fresh = runOnce(listenAddr, 0, sessions, seconds, &freshConns);
+    double pooled = runOnce(listenAddr, sessions, sessions, seconds, &pooledConns);
+
+    fprintf(stderr, "sessions=%d request=%zu bytes\n", sessions, kRequestSize);
+    fprintf(stderr, "without pool: %10.1f req/s  (%ld connections)\n", fresh, (long)freshConns);
+    fprintf(stderr, "with pool:    %10.1f req/s  (%ld connections)\n", pooled, (long)pooledConns);
+    return 0;
+}
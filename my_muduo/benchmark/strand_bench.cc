@@ -0,0 +1,193 @@
+#include <my_muduo/EventLoop.h>
+#include <my_muduo/EventLoopThread.h>
+#include <my_muduo/ComputePool.h>
+#include <my_muduo/Strand.h>
+#include <my_muduo/logger.h>
+#include "BenchUtil.h"
+
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <atomic>
+#include <random>
+#include <future>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * 模拟流水线协议：conns个连接，每个连接连续来requests个请求，处理时间在[minUs, maxUs]之间按对数均匀分布
+ * offload模式每个请求直接 EventLoop::offload，strand模式post到连接自己的Strand
+ * 统计吞吐、应答乱序的次数（continuation回到loop的顺序和请求顺序不一致）、同一个连接的请求同时在执行的次数
+ * strand模式最后再检查公平性：单线程的线程池里一个strand排着一长串任务，另一个strand后post的任务不应该等它全部执行完；
+ * 线程池里一直有别的任务排着时，这个strand也要能执行完
+ * 用法：strand_bench [offload|strand] [pool线程数] [连接数] [每个连接的请求数] [minUs] [maxUs]
+*/
+
+struct Conn
+{
+    StrandPtr strand;
+    std::atomic<int> running; //正在执行的请求数，strand模式下不应该超过1
+    int nextReply; //下一个应该发出的应答序号，只在loop线程里读写
+
+    Conn() : running(0), nextReply(0) {}
+};
+
+int main(int argc, char *argv[])
+{
+    bool useStrand = !(argc > 1 && strcmp(argv[1], "offload") == 0);
+    int threads = argc > 2 ? atoi(argv[2]) : 4;
+    int conns = argc > 3 ? atoi(argv[3]) : 50;
+    int requests = argc > 4 ? atoi(argv[4]) : 40;
+    double minUs = argc > 5 ? atof(argv[5]) : 1;
+    double maxUs = argc > 6 ? atof(argv[6]) : 2000;
+    if(threads < 1 || conns < 1 || requests < 1 || minUs <= 0 || maxUs < minUs)
+    {
+        fprintf(stderr, "Usage: %s [offload|strand] [poolThreads] [conns] [requests] [minUs] [maxUs]\n", argv[0]);
+        return 1;
+    }
+
+    Logger::setLogThreshold(ERROR);
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> logUniform(log(minUs), log(maxUs));
+    int total = conns * requests;
+    std::vector<int64_t> durations(total);
+    int64_t totalWork = 0;
+    for(int64_t &d : durations)
+    {
+        d = static_cast<int64_t>(exp(logUniform(rng)) * 1000);
+        totalWork += d;
+    }
+
+    ComputePool pool(threads, "bench");
+    pool.start();
+
+    EventLoopThread loopThread;
+    EventLoop *loop = loopThread.startLoop();
+    loop->setComputePool(&pool);
+
+    std::vector<std::unique_ptr<Conn>> connections;
+    for(int i = 0; i < conns; ++i)
+    {
+        connections.emplace_back(new Conn);
+        connections.back()->strand = std::make_shared<Strand>(loop);
+    }
+
+    std::atomic<int64_t> overlaps(0);
+    int outOfOrder = 0;
+    int completed = 0;
+    std::promise<void> allDone;
+    int64_t start = 0;
+
+    //loop线程里按轮次依次给每个连接发请求，模拟各个连接交错到来的流水线请求
+    loop->runInLoop([&]() {
+        start = nowNanos();
+        for(int r = 0; r < requests; ++r)
+        {
+            for(int c = 0; c < conns; ++c)
+            {
+                Conn *conn = connections[c].get();
+                int64_t d = durations[r * conns + c];
+                auto work = [conn, d, &overlaps]() {
+                    if(conn->running.fetch_add(1) != 0)
+                    {
+                        overlaps.fetch_add(1);
+                    }
+                    burn(d);
+                    conn->running.fetch_sub(1);
+                };
+                auto reply = [&, conn, r]() {
+                    if(r != conn->nextReply)
+                    {
+                        ++outOfOrder;
+                    }
+                    conn->nextReply = std::max(conn->nextReply, r + 1);
+                    if(++completed == total)
+                    {
+                        allDone.set_value();
+                    }
+                };
+                if(useStrand)
+                {
+                    conn->strand->post(work, reply);
+                }
+                else
+                {
+                    loop->offload(work, reply);
+                }
+            }
+        }
+    });
+
+    allDone.get_future().wait();
+    double elapsed = (nowNanos() - start) / 1e9;
+
+    fprintf(stderr, "mode=%s pool threads=%d conns=%d requests/conn=%d task size %.0f..%.0f us, total work %.3fs\n",
+            useStrand ? "strand" : "offload", threads, conns, requests, minUs, maxUs, totalWork / 1e9);
+    fprintf(stderr, "elapsed %.3fs  %.0f requests/s  utilisation %.1f%% of %d threads\n",
+            elapsed, total / elapsed, totalWork / 1e9 / elapsed / threads * 100, threads);
+    fprintf(stderr, "out-of-order replies %d, overlapping requests on one conn %ld, steals %ld\n",
+            outOfOrder, (long)overlaps.load(), (long)pool.steals());
+
+    if(useStrand)
+    {
+        //busy排上busyTasks个任务，执行到第10个时post一个任务给other，other执行时busy应该还有很多没执行
+        const int busyTasks = 200;
+        ComputePool single(1, "fairness");
+        single.start();
+        StrandPtr busy = std::make_shared<Strand>(loop, &single);
+        StrandPtr other = std::make_shared<Strand>(loop, &single);
+        std::atomic<int> busyDone(0);
+        std::promise<int> otherDone;
+        for(int i = 0; i < busyTasks; ++i)
+        {
+            busy->post([&, i]() {
+                burn(20 * 1000);
+                busyDone.fetch_add(1);
+                if(i == 10)
+                {
+                    other->post([&]() { otherDone.set_value(busyDone.load()); });
+                }
+            });
+        }
+        int before = otherDone.get_future().get();
+        fprintf(stderr, "fairness: second strand ran after %d of %d tasks of a busy strand on 1 thread %s\n",
+                before, busyTasks, before < busyTasks ? "ok" : "STARVED");
+        while(busy->pending() > 0)
+        {
+            ::usleep(1000);
+        }
+
+        //线程池一直不空：不停地有外部任务提交，busy的任务也要能按时执行完，而不是等队列空下来
+        //排着的任务比一个调度时间片能执行完的多，单核的机器上也不会在提交的间隙排空
+        const int steadyTasks = 10;
+        std::atomic<int> steadyDone(0);
+        for(int i = 0; i < steadyTasks; ++i)
+        {
+            busy->post([&steadyDone]() { burn(5 * 1000); steadyDone.fetch_add(1); });
+        }
+        int64_t steadyStart = nowNanos();
+        while(steadyDone.load() < steadyTasks && nowNanos() - steadyStart < 2000 * 1000 * 1000LL)
+        {
+            if(single.queued() < 2000)
+            {
+                single.submit([]() { burn(5 * 1000); });
+            }
+        }
+        int steady = steadyDone.load();
+        fprintf(stderr, "fairness under steady load: busy strand finished %d of %d tasks in %.0fms %s\n",
+                steady, steadyTasks, (nowNanos() - steadyStart) / 1e6, steady == steadyTasks ? "ok" : "STARVED");
+        while(busy->pending() > 0)
+        {
+            ::usleep(1000);
+        }
+        if(before >= busyTasks || steady < steadyTasks)
+        {
+            ::_exit(1);
+        }
+    }
+    ::_exit(0);
+}
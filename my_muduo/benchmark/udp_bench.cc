@@ -0,0 +1,233 @@
+#include <my_muduo/UdpServer.h>
+#include <my_muduo/UdpSocket.h>
+#include <my_muduo/EventLoop.h>
+#include <my_muduo/EventLoopThread.h>
+#include <my_muduo/logger.h>
+#include "BenchUtil.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <functional>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * UDP包速率测试：进程里起一个UdpServer（每个server线程一个reuseport socket）和若干客户端线程，全部走回环
+ * sink模式：客户端每轮事件循环发burst个包，服务端只计数，测单方向的pps和丢包率
+ * echo模式：每个客户端保持window个包在路上，服务端原样发回，测往返的pps
+ * 收发都是recvmmsg/sendmmsg批量，gso=1时同一个对端的连续数据报合并成UDP_SEGMENT发送
+ * 用法：udp_bench [port] [server线程数] [client线程数] [包大小] [秒数] [sink|echo] [gso 0|1] [burst/window]
+*/
+
+static std::atomic_bool g_stopped(false);
+static std::atomic<int64_t> g_serverPackets(0);
+static std::atomic<int64_t> g_serverBatches(0);
+
+//服务端和客户端loop线程的cpu时钟
+static ThreadClocks g_serverClocks;
+static ThreadClocks g_clientClocks;
+
+class UdpClient
+{
+public:
+    UdpClient(EventLoop *loop, const InetAddress &serverAddr, int packetSize, bool echo, int burst, bool gso)
+        : loop_(loop)
+        , serverAddr_(serverAddr)
+        , payload_(packetSize, 'u')
+        , echo_(echo)
+        , burst_(burst)
+        , gso_(gso)
+        , sent_(0)
+        , received_(0)
+        , lastReceived_(0)
+    {
+    }
+
+    //在client的loop线程里创建socket开始发
+    void start()
+    {
+        loop_->runInLoop([this]() {
+            socket_.reset(new UdpSocket(loop_, InetAddress(0)));
+            socket_->setMessageCallback(std::bind(&UdpClient::onMessage, this,
+                std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4));
+            if(gso_)
+            {
+                socket_->setGso(true);
+            }
+            socket_->start();
+            if(echo_)
+            {
+                sendBurst();
+                //包丢了window就会越来越小，一段时间没有回包就重新补满
+                loop_->runEvery(0.01, [this]() {
+                    int64_t received = received_.load(std::memory_order_relaxed);
+                    if(received == lastReceived_ && !g_stopped)
+                    {
+                        sendBurst();
+                    }
+                    lastReceived_ = received;
+                });
+            }
+            else
+            {
+                pump();
+            }
+        });
+    }
+
+    int64_t sent() const { return sent_.load(std::memory_order_relaxed); }
+    int64_t received() const { return received_.load(std::memory_order_relaxed); }
+
+private:
+    void sendBurst()
+    {
+        for(int i = 0; i < burst_; ++i)
+        {
+            socket_->sendTo(serverAddr_, payload_.data(), payload_.size());
+        }
+        sent_.store(sent_.load(std::memory_order_relaxed) + burst_, std::memory_order_relaxed);
+    }
+
+    //每轮事件循环发一批，本轮末尾sendmmsg，然后排到下一轮
+    void pump()
+    {
+        if(g_stopped)
+        {
+            return;
+        }
+        sendBurst();
+        loop_->queueInLoop(std::bind(&UdpClient::pump, this));
+    }
+
+    void onMessage(UdpSocket *socket, const UdpPacket*, int count, TimeStamp)
+    {
+        received_.store(received_.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+        if(echo_ && !g_stopped)
+        {
+            for(int i = 0; i < count; ++i)
+            {
+                socket->sendTo(serverAddr_, payload_.data(), payload_.size());
+            }
+            sent_.store(sent_.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+        }
+    }
+
+    EventLoop *loop_;
+    InetAddress serverAddr_;
+    std::string payload_;
+    bool echo_;
+    int burst_;
+    bool gso_;
+    std::unique_ptr<UdpSocket> socket_;
+    std::atomic<int64_t> sent_;
+    std::atomic<int64_t> received_;
+    int64_t lastReceived_;
+};
+
+int main(int argc, char *argv[])
+{
+    uint16_t port = argc > 1 ? static_cast<uint16_t>(atoi(argv[1])) : 9300;
+    int serverThreads = argc > 2 ? atoi(argv[2]) : 2;
+    int clientThreads = argc > 3 ? atoi(argv[3]) : 2;
+    int packetSize = argc > 4 ? atoi(argv[4]) : 64;
+    double seconds = argc > 5 ? atof(argv[5]) : 5.0;
+    bool echo = argc > 6 && strcmp(argv[6], "echo") == 0;
+    bool gso = argc > 7 && atoi(argv[7]) != 0;
+    int burst = argc > 8 ? atoi(argv[8]) : (echo ? 64 : 256);
+    if(clientThreads < 1 || packetSize < 1 || burst < 1)
+    {
+        fprintf(stderr, "Usage: %s [port] [serverThreads] [clientThreads] [packetSize] [seconds] [sink|echo] [gso 0|1] [burst]\n", argv[0]);
+        return 1;
+    }
+
+    Logger::setLogThreshold(ERROR);
+
+    //server线程数为0时唯一的socket在这个base loop上，也算server的cpu
+    EventLoopThread serverThread([](EventLoop*) { g_serverClocks.record(); });
+    EventLoop *serverLoop = serverThread.startLoop();
+    UdpServer server(serverLoop, InetAddress(port), "UdpBench");
+    server.setThreadNum(serverThreads);
+    if(serverThreads > 0)
+    {
+        server.setThreadInitCallback([](EventLoop*) { g_serverClocks.record(); });
+    }
+    server.setSocketInitCallback([gso](UdpSocket *socket) {
+        if(gso)
+        {
+            socket->setGso(true);
+        }
+    });
+    server.setMessageCallback([echo](UdpSocket *socket, const UdpPacket *packets, int count, TimeStamp) {
+        g_serverPackets.fetch_add(count, std::memory_order_relaxed);
+        g_serverBatches.fetch_add(1, std::memory_order_relaxed);
+        if(echo)
+        {
+            for(int i = 0; i < count; ++i)
+            {
+                socket->sendTo(packets[i].peer, packets[i].data, packets[i].len);
+            }
+        }
+    });
+    server.start();
+
+    ::usleep(100 * 1000);
+    std::vector<std::unique_ptr<EventLoopThread>> clientLoops;
+    std::vector<std::unique_ptr<UdpClient>> clients;
+    for(int i = 0; i < clientThreads; ++i)
+    {
+        clientLoops.emplace_back(new EventLoopThread([](EventLoop*) { g_clientClocks.record(); }));
+        EventLoop *loop = clientLoops.back()->startLoop();
+        clients.emplace_back(new UdpClient(loop, InetAddress(port), packetSize, echo, burst, gso));
+        clients.back()->start();
+    }
+
+    auto totals = [&clients](int64_t *sent, int64_t *received) {
+        *sent = 0;
+        *received = 0;
+        for(auto &c : clients)
+        {
+            *sent += c->sent();
+            *received += c->received();
+        }
+    };
+
+    //预热一秒再开始计时
+    ::sleep(1);
+    int64_t startSent, startReceived;
+    totals(&startSent, &startReceived);
+    int64_t startServer = g_serverPackets.load();
+    int64_t startBatches = g_serverBatches.load();
+    double startServerCpu = g_serverClocks.cpuSeconds();
+    double startClientCpu = g_clientClocks.cpuSeconds();
+    TimeStamp start(TimeStamp::now());
+    ::usleep(static_cast<useconds_t>(seconds * 1000 * 1000));
+    int64_t sent, received;
+    totals(&sent, &received);
+    sent -= startSent;
+    received -= startReceived;
+    int64_t serverPackets = g_serverPackets.load() - startServer;
+    int64_t batches = g_serverBatches.load() - startBatches;
+    double elapsed = timeDifference(TimeStamp::now(), start);
+    double serverCpu = g_serverClocks.cpuSeconds() - startServerCpu;
+    double clientCpu = g_clientClocks.cpuSeconds() - startClientCpu;
+    g_stopped = true;
+
+    fprintf(stderr, "mode=%s packetSize=%d server threads=%d client threads=%d gso=%d burst=%d\n",
+            echo ? "echo" : "sink", packetSize, serverThreads, clientThreads, gso ? 1 : 0, burst);
+    fprintf(stderr, "client sent:     %.0f pps\n", sent / elapsed);
+    fprintf(stderr, "server received: %.0f pps  %.3f MiB/s  avg batch %.1f  loss %.2f%%\n",
+            serverPackets / elapsed, serverPackets * static_cast<double>(packetSize) / elapsed / 1024 / 1024,
+            batches > 0 ? static_cast<double>(serverPackets) / batches : 0.0,
+            sent > 0 && serverPackets < sent ? (sent - serverPackets) * 100.0 / sent : 0.0);
+    if(echo)
+    {
+        fprintf(stderr, "client received: %.0f pps (round trips)\n", received / elapsed);
+    }
+    fprintf(stderr, "server cpu: %.1f%%  client cpu: %.1f%%\n",
+            serverCpu / elapsed * 100, clientCpu / elapsed * 100);
+    ::_exit(0); //socket都还在各个loop上，直接退出
+}
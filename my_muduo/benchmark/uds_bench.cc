@@ -0,0 +1,170 @@
+#include <my_muduo/TcpServer.h>
+#include <my_muduo/TcpClient.h>
+#include <my_muduo/EventLoop.h>
+#include <my_muduo/EventLoopThread.h>
+#include <my_muduo/logger.h>
+#include "BenchUtil.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <functional>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/**
+ * Unix域socket和TCP回环的pingpong对比：同一个进程里依次跑 TCP 127.0.0.1、TCP ::1、Unix域文件路径、
+ * Unix域抽象命名空间 四种地址，每种都是一个server线程一个client线程，每个连接只有一个消息在路上，
+ * 统计每秒往返次数、平均往返时间和每个往返花掉的cpu
+ * 用法：uds_bench [port] [连接数] [msgSize] [每种的秒数] [socket文件路径]
+*/
+
+//每一轮测试自己的状态，跑完以后连接留在各自的loop上不再发消息
+struct Run
+{
+    std::atomic_bool stopped{false};
+    ThreadClocks clocks; //server和client线程的cpu时钟
+};
+
+static void onServerConnection(const TcpConnectionPtr &conn)
+{
+    if(conn->connected())
+    {
+        conn->setTcpNoDelay(true); //Unix域socket上setsockopt会失败，不影响
+    }
+}
+
+static void onServerMessage(const TcpConnectionPtr &conn, Buffer *buf, TimeStamp)
+{
+    conn->send(buf);
+}
+
+class PingPongClient
+{
+public:
+    PingPongClient(EventLoop *loop, const InetAddress &serverAddr, const std::string &message, Run *run, int id)
+        : client_(loop, serverAddr, "UdsBenchClient" + std::to_string(id))
+        , message_(message)
+        , run_(run)
+        , roundTrips_(0)
+    {
+        client_.setConnectionCallback(
+            std::bind(&PingPongClient::onConnection,this,std::placeholders::_1));
+        client_.setMessageCallback(
+            std::bind(&PingPongClient::onMessage,this,
+                std::placeholders::_1,std::placeholders::_2,std::placeholders::_3));
+    }
+
+    void connect() { client_.connect(); }
+    int64_t roundTrips() const { return roundTrips_.load(std::memory_order_relaxed); }
+
+private:
+    void onConnection(const TcpConnectionPtr &conn)
+    {
+        if(conn->connected())
+        {
+            conn->setTcpNoDelay(true);
+            conn->send(message_);
+        }
+    }
+
+    //收齐一个完整的消息算一次往返，再发下一个
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, TimeStamp)
+    {
+        if(buf->readableBytes() < message_.size())
+        {
+            return;
+        }
+        buf->retrieve(message_.size());
+        roundTrips_.store(roundTrips_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        if(!run_->stopped)
+        {
+            conn->send(message_);
+        }
+    }
+
+    TcpClient client_;
+    const std::string &message_;
+    Run *run_;
+    std::atomic<int64_t> roundTrips_;
+};
+
+//对一个地址跑一轮，对象都不析构，最后_exit
+static void runOnce(const char *label, const InetAddress &addr, int connections, const std::string &message, double seconds)
+{
+    Run *run = new Run;
+    EventLoopThread *serverThread = new EventLoopThread([run](EventLoop*) { run->clocks.record(); });
+    EventLoop *serverLoop = serverThread->startLoop();
+    TcpServer *server = new TcpServer(serverLoop, addr, label);
+    server->setConnectionCallback(onServerConnection);
+    server->setMessageCallback(onServerMessage);
+    server->start();
+
+    EventLoopThread *clientThread = new EventLoopThread([run](EventLoop*) { run->clocks.record(); });
+    EventLoop *clientLoop = clientThread->startLoop();
+    std::vector<PingPongClient*> clients;
+    for(int i = 0; i < connections; ++i)
+    {
+        clients.push_back(new PingPongClient(clientLoop, addr, message, run, i));
+        clients.back()->connect();
+    }
+
+    auto total = [&clients]() {
+        int64_t n = 0;
+        for(PingPongClient *c : clients)
+        {
+            n += c->roundTrips();
+        }
+        return n;
+    };
+
+    //预热半秒再开始计时
+    ::usleep(500 * 1000);
+    int64_t startCount = total();
+    double startCpu = run->clocks.cpuSeconds();
+    TimeStamp start(TimeStamp::now());
+    ::usleep(static_cast<useconds_t>(seconds * 1000 * 1000));
+    int64_t count = total() - startCount;
+    double elapsed = timeDifference(TimeStamp::now(), start);
+    double cpu = run->clocks.cpuSeconds() - startCpu;
+    run->stopped = true;
+
+    double rate = count / elapsed;
+    fprintf(stderr, "%-22s %-28s %12.0f %10.2f %10.2f %8.1f%%\n",
+            label, addr.toIpPort().c_str(), rate,
+            rate > 0 ? connections / rate * 1e6 : 0.0,
+            count > 0 ? cpu / count * 1e6 : 0.0,
+            cpu / elapsed * 100);
+    ::usleep(100 * 1000); //等最后几个在路上的消息落地
+}
+
+int main(int argc, char *argv[])
+{
+    uint16_t port = argc > 1 ? static_cast<uint16_t>(atoi(argv[1])) : 9400;
+    int connections = argc > 2 ? atoi(argv[2]) : 1;
+    int msgSize = argc > 3 ? atoi(argv[3]) : 64;
+    double seconds = argc > 4 ? atof(argv[4]) : 3.0;
+    std::string path = argc > 5 ? argv[5] : "/tmp/uds_bench.sock";
+    if(connections < 1 || msgSize < 1)
+    {
+        fprintf(stderr, "Usage: %s [port] [connections] [msgSize] [seconds] [socketPath]\n", argv[0]);
+        return 1;
+    }
+
+    Logger::setLogThreshold(ERROR);
+
+    std::string message(msgSize, 'p');
+    fprintf(stderr, "connections=%d msgSize=%d seconds=%.1f, 1 server thread + 1 client thread\n",
+            connections, msgSize, seconds);
+    fprintf(stderr, "%-22s %-28s %12s %10s %10s %9s\n",
+            "transport", "address", "round trip/s", "avg rtt us", "cpu us/rt", "cpu");
+    runOnce("tcp-ipv4", InetAddress(port), connections, message, seconds);
+    runOnce("tcp-ipv6", InetAddress(static_cast<uint16_t>(port + 1), "::1"), connections, message, seconds);
+    runOnce("unix", InetAddress::unixPath(path), connections, message, seconds);
+    runOnce("unix-abstract", InetAddress::unixPath("uds_bench." + std::to_string(::getpid()), true),
+            connections, message, seconds);
+    ::unlink(path.c_str());
+    ::_exit(0); //连接都还在各个loop上，直接退出
+}
@@ -0,0 +1,56 @@
+#include <my_muduo/TcpServer.h>
+#include <my_muduo/HotRestart.h>
+#include <my_muduo/logger.h>
+
+#include <string>
+#include <memory>
+#include <functional>
+#include <unistd.h>
+
+/**
+ * 热重启的echo服务器：直接再启动一个同样的进程，新进程从旧进程接过监听socket开始accept，
+ * 旧进程停止accept，等已有连接关闭（最多10秒）以后退出，客户端不会遇到连接被拒绝
+*/
+
+static void onConnection(const TcpConnectionPtr &conn)
+{
+    LOG_INFO("pid %d Connection %s : %s", ::getpid(), conn->connected() ? "UP" : "DOWN",
+        conn->peerAddress().toIpPort().c_str());
+}
+
+static void onMessage(const TcpConnectionPtr &conn, Buffer *buf, TimeStamp time)
+{
+    conn->send(buf);
+}
+
+int main()
+{
+    EventLoop loop;
+    HotRestart restart(&loop, InetAddress::unixPath("hotrestart_server.control", true));
+
+    //有旧进程就接过它的监听fd，否则自己绑定
+    std::unique_ptr<TcpServer> server;
+    int listenFd = restart.inherit() ? restart.takeListenFd("EchoServer-01") : -1;
+    if(listenFd >= 0)
+    {
+        server.reset(new TcpServer(&loop, listenFd, "EchoServer-01"));
+    }
+    else
+    {
+        server.reset(new TcpServer(&loop, InetAddress(8000), "EchoServer-01"));
+    }
+    server->setConnectionCallback(onConnection);
+    server->setMessageCallback(onMessage);
+    server->setThreadNum(1);
+    server->start();
+
+    //下一个进程接手以后：drain已有连接，全部关闭或者到期以后退出
+    restart.addServer(server.get());
+    restart.setHandoffCallback([&loop, &server]() {
+        server->drain(10.0, [&loop]() { loop.quit(); });
+    });
+    restart.start();
+    loop.loop();
+    LOG_INFO("pid %d drained, exit", ::getpid());
+    return 0;
+}
@@ -0,0 +1,51 @@
+#include <my_muduo/TcpServer.h>
+#include <my_muduo/PreforkSupervisor.h>
+#include <my_muduo/logger.h>
+
+#include <string>
+#include <functional>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/**
+ * prefork的echo服务器：supervisor绑定端口以后fork出N个worker，每个worker一个独立的EventLoop和
+ * reuseport的TcpServer，各自绑定一个cpu；worker崩溃会被重新拉起，supervisor每秒打印所有worker的汇总
+ * 用法：prefork_server [port] [worker数]
+*/
+
+static void onMessage(const TcpConnectionPtr &conn, Buffer *buf, TimeStamp time)
+{
+    conn->send(buf);
+}
+
+int main(int argc, char *argv[])
+{
+    uint16_t port = argc > 1 ? static_cast<uint16_t>(atoi(argv[1])) : 8000;
+    int workers = argc > 2 ? atoi(argv[2]) : 4;
+
+    PreforkSupervisor supervisor(InetAddress(port), workers);
+    supervisor.setCpuAffinity(true);
+    supervisor.setStatsCallback([](const std::vector<PreforkSupervisor::WorkerStats> &stats) {
+        int64_t accepted = 0, active = 0, bytes = 0;
+        for(const PreforkSupervisor::WorkerStats &w : stats)
+        {
+            accepted += w.connectionsAccepted;
+            active += w.activeConnections;
+            bytes += w.bytesRead;
+            printf("  worker %d pid %d restarts %d accepted %ld active %ld read %ld bytes\n",
+                w.index, w.pid, w.restarts, (long)w.connectionsAccepted, (long)w.activeConnections, (long)w.bytesRead);
+        }
+        printf("total accepted %ld active %ld read %ld bytes\n", (long)accepted, (long)active, (long)bytes);
+        fflush(stdout);
+    });
+
+    return supervisor.run([&supervisor](int index) {
+        EventLoop loop;
+        TcpServer server(&loop, supervisor.listenAddress(), "PreforkEcho", TcpServer::kReusePort);
+        server.setConnectionCallback([](const TcpConnectionPtr &conn) {});
+        server.setMessageCallback(onMessage);
+        server.start();
+        loop.loop();
+    });
+}
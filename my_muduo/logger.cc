@@ -2,6 +2,28 @@
 #include "TimeStamp.h"
 
 #include <iostream>
+#include <stdlib.h>
+#include <string.h>
+
+int Logger::threshold_ = Logger::initThreshold();
+
+int Logger::initThreshold()
+{
+    const char *level = ::getenv("MUDUO_LOG_LEVEL");
+    if(level == nullptr)
+    {
+        return INFO;
+    }
+    if(::strcmp(level, "ERROR") == 0)
+    {
+        return ERROR;
+    }
+    if(::strcmp(level, "FATAL") == 0)
+    {
+        return FATAL;
+    }
+    return INFO;
+}
 
 // 获取日志唯一的实例对象
 Logger& Logger ::instance()
@@ -9,6 +9,7 @@
 #define LOG_INFO(logmsgFormat, ...)                       \
     do                                                    \
     {                                                     \
+        if(Logger::logThreshold() > INFO) break;          \
         Logger &logger = Logger::instance();              \
         logger.setLogLevel(INFO);                         \
         char buf[1024] = {0};                             \
@@ -19,6 +20,7 @@
 #define LOG_ERROR(logmsgFormat, ...)                      \
     do                                                    \
     {                                                     \
+        if(Logger::logThreshold() > ERROR) break;         \
         Logger &logger = Logger::instance();              \
         logger.setLogLevel(ERROR);                        \
         char buf[1024] = {0};                             \
@@ -77,7 +79,16 @@ public:
     // 写日志
     void log(std::string msg);
 
+    // 运行时的输出门限，低于门限的INFO/ERROR直接跳过，FATAL总是输出
+    // 默认INFO，压测的时候设成ERROR，热路径上的LOG_INFO只剩一次比较
+    // 也可以用环境变量MUDUO_LOG_LEVEL=INFO/ERROR/FATAL设置初值
+    static void setLogThreshold(int level) { threshold_ = level; }
+    static int logThreshold() { return threshold_; }
+
 private:
+    static int initThreshold();
+
+    static int threshold_;
     int logLevel_; // 类的成员变量
     //Logger(){};    // 构造函数私有化
 };
\ No newline at end of file
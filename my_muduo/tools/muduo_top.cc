@@ -0,0 +1,346 @@
+#include <my_muduo/StatsShmLayout.h>
+
+#include <map>
+#include <vector>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * muduo-top：attach到一个正在运行的进程的共享内存统计段（StatsPublisher发布的），
+ * 每隔几秒显示每个loop的速率和利用率；只读映射，不会让被观察的进程等待
+ * 用法：muduo-top <pid> [-d 刷新间隔秒数] [-n 刷新次数，0表示一直刷新]
+*/
+
+//从共享内存里拷出来的一条loop记录
+struct LoopSample
+{
+    int64_t tid;
+    int64_t pollWakeups;
+    int64_t eventsDispatched;
+    int64_t functorsRun;
+    int64_t pollNanos;
+    int64_t callbackNanos;
+    int64_t connectionsAccepted;
+    int64_t connectionsEstablished;
+    int64_t connectionsClosed;
+    int64_t bytesRead;
+    int64_t bytesWritten;
+    int64_t bufferedBytes;
+    int64_t stalls;
+    int64_t functorQueueP99;
+    int64_t functorQueueMax;
+    int64_t iterationP99Nanos;
+};
+
+struct ServerSample
+{
+    std::string name;
+    int64_t connectionsAccepted;
+    int64_t activeConnections;
+};
+
+struct Snapshot
+{
+    int64_t publishNanos;
+    std::vector<LoopSample> loops;
+    std::vector<ServerSample> servers;
+};
+
+static const int kMaxRetries = 1000;
+
+static int64_t get(const std::atomic<int64_t> &field)
+{
+    return field.load(std::memory_order_relaxed);
+}
+
+//seqlock读：写的一方正在写（奇数）或者读的过程中被改写了就重读
+static bool readLoop(const StatsShmLoop &r, LoopSample *out)
+{
+    for(int i = 0; i < kMaxRetries; ++i)
+    {
+        uint64_t before = r.seq.load(std::memory_order_acquire);
+        if(before & 1)
+        {
+            continue;
+        }
+        out->tid = get(r.tid);
+        out->pollWakeups = get(r.pollWakeups);
+        out->eventsDispatched = get(r.eventsDispatched);
+        out->functorsRun = get(r.functorsRun);
+        out->pollNanos = get(r.pollNanos);
+        out->callbackNanos = get(r.callbackNanos);
+        out->connectionsAccepted = get(r.connectionsAccepted);
+        out->connectionsEstablished = get(r.connectionsEstablished);
+        out->connectionsClosed = get(r.connectionsClosed);
+        out->bytesRead = get(r.bytesRead);
+        out->bytesWritten = get(r.bytesWritten);
+        out->bufferedBytes = get(r.bufferedBytes);
+        out->stalls = get(r.stalls);
+        out->functorQueueP99 = get(r.functorQueueP99);
+        out->functorQueueMax = get(r.functorQueueMax);
+        out->iterationP99Nanos = get(r.iterationP99Nanos);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(r.seq.load(std::memory_order_relaxed) == before)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool readServer(const StatsShmServer &r, ServerSample *out)
+{
+    for(int i = 0; i < kMaxRetries; ++i)
+    {
+        uint64_t before = r.seq.load(std::memory_order_acquire);
+        if(before & 1)
+        {
+            continue;
+        }
+        char name[kStatsShmNameLen];
+        memcpy(name, r.name, sizeof name);
+        name[kStatsShmNameLen - 1] = '\0';
+        out->connectionsAccepted = get(r.connectionsAccepted);
+        out->activeConnections = get(r.activeConnections);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(r.seq.load(std::memory_order_relaxed) == before)
+        {
+            out->name = name;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool readSnapshot(const StatsShmSegment *seg, Snapshot *snap)
+{
+    const StatsShmHeader &h = seg->header;
+    int numLoops = 0;
+    int numServers = 0;
+    int i = 0;
+    for(; i < kMaxRetries; ++i)
+    {
+        uint64_t before = h.seq.load(std::memory_order_acquire);
+        if(before & 1)
+        {
+            continue;
+        }
+        snap->publishNanos = h.publishNanos.load(std::memory_order_relaxed);
+        numLoops = h.numLoops.load(std::memory_order_relaxed);
+        numServers = h.numServers.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(h.seq.load(std::memory_order_relaxed) == before)
+        {
+            break;
+        }
+    }
+    if(i == kMaxRetries || numLoops > kStatsShmMaxLoops || numServers > kStatsShmMaxServers)
+    {
+        return false;
+    }
+
+    snap->loops.clear();
+    for(int k = 0; k < numLoops; ++k)
+    {
+        LoopSample sample;
+        if(readLoop(seg->loops[k], &sample))
+        {
+            snap->loops.push_back(sample);
+        }
+    }
+    snap->servers.clear();
+    for(int k = 0; k < numServers; ++k)
+    {
+        ServerSample sample;
+        if(readServer(seg->servers[k], &sample))
+        {
+            snap->servers.push_back(sample);
+        }
+    }
+    return true;
+}
+
+static const StatsShmSegment* attach(pid_t pid)
+{
+    char name[64];
+    snprintf(name, sizeof name, "/muduo-stats.%d", pid);
+    int fd = ::shm_open(name, O_RDONLY, 0);
+    if(fd < 0)
+    {
+        fprintf(stderr, "muduo-top: cannot open %s: %s (is StatsPublisher running in that process?)\n",
+                name, strerror(errno));
+        return nullptr;
+    }
+    struct stat st;
+    if(::fstat(fd, &st) < 0 || st.st_size < static_cast<off_t>(sizeof(StatsShmHeader)))
+    {
+        fprintf(stderr, "muduo-top: %s is too small\n", name);
+        ::close(fd);
+        return nullptr;
+    }
+    void *addr = ::mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(addr == MAP_FAILED)
+    {
+        fprintf(stderr, "muduo-top: mmap %s: %s\n", name, strerror(errno));
+        return nullptr;
+    }
+
+    const StatsShmSegment *seg = static_cast<const StatsShmSegment*>(addr);
+    const StatsShmHeader &h = seg->header;
+    if(h.magic != kStatsShmMagic)
+    {
+        fprintf(stderr, "muduo-top: %s is not a muduo stats segment\n", name);
+        return nullptr;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if(h.version != kStatsShmVersion
+        || h.headerSize != sizeof(StatsShmHeader)
+        || h.loopRecordSize != sizeof(StatsShmLoop)
+        || h.serverRecordSize != sizeof(StatsShmServer)
+        || st.st_size < static_cast<off_t>(sizeof(StatsShmSegment)))
+    {
+        fprintf(stderr, "muduo-top: %s has layout version %u, this muduo-top reads version %u\n",
+                name, h.version, kStatsShmVersion);
+        return nullptr;
+    }
+    return seg;
+}
+
+static double rate(int64_t now, int64_t before, double seconds)
+{
+    return seconds > 0 ? (now - before) / seconds : 0.0;
+}
+
+static void print(pid_t pid, const Snapshot &now, const Snapshot &prev, bool clear)
+{
+    double seconds = (now.publishNanos - prev.publishNanos) / 1e9;
+    std::map<int64_t, const LoopSample*> before;
+    for(const LoopSample &s : prev.loops)
+    {
+        before[s.tid] = &s;
+    }
+
+    if(clear)
+    {
+        printf("\033[H\033[2J");
+    }
+    printf("muduo-top  pid %d  interval %.2fs\n\n", pid, seconds);
+    printf("%8s %6s %9s %9s %9s %8s %7s %9s %10s %10s %9s %10s %7s\n",
+           "TID", "UTIL%", "WAKEUP/s", "EVENT/s", "FUNCTOR/s", "ACCEPT/s", "CONNS",
+           "READ MB/s", "WRITE MB/s", "BUFFERED", "QUEUE p99", "ITER p99us", "STALLS");
+
+    for(const LoopSample &s : now.loops)
+    {
+        auto it = before.find(s.tid);
+        //新出现的loop没有上一次的读数，这一行的速率不准，先显示0
+        const LoopSample &p = it != before.end() ? *it->second : s;
+        printf("%8ld %6.1f %9.0f %9.0f %9.0f %8.0f %7ld %9.2f %10.2f %10ld %4ld/%-4ld %10.1f %7ld\n",
+               static_cast<long>(s.tid),
+               seconds > 0 ? (s.callbackNanos - p.callbackNanos) / (seconds * 1e9) * 100 : 0.0,
+               rate(s.pollWakeups, p.pollWakeups, seconds),
+               rate(s.eventsDispatched, p.eventsDispatched, seconds),
+               rate(s.functorsRun, p.functorsRun, seconds),
+               rate(s.connectionsAccepted, p.connectionsAccepted, seconds),
+               static_cast<long>(s.connectionsEstablished - s.connectionsClosed),
+               rate(s.bytesRead, p.bytesRead, seconds) / (1024 * 1024),
+               rate(s.bytesWritten, p.bytesWritten, seconds) / (1024 * 1024),
+               static_cast<long>(s.bufferedBytes),
+               static_cast<long>(s.functorQueueP99),
+               static_cast<long>(s.functorQueueMax),
+               s.iterationP99Nanos / 1e3,
+               static_cast<long>(s.stalls));
+    }
+
+    if(!now.servers.empty())
+    {
+        std::map<std::string, const ServerSample*> serversBefore;
+        for(const ServerSample &s : prev.servers)
+        {
+            serversBefore[s.name] = &s;
+        }
+        printf("\n%-32s %9s %9s\n", "SERVER", "CONNS", "ACCEPT/s");
+        for(const ServerSample &s : now.servers)
+        {
+            auto it = serversBefore.find(s.name);
+            const ServerSample &p = it != serversBefore.end() ? *it->second : s;
+            printf("%-32s %9ld %9.0f\n", s.name.c_str(), static_cast<long>(s.activeConnections),
+                   rate(s.connectionsAccepted, p.connectionsAccepted, seconds));
+        }
+    }
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc < 2)
+    {
+        fprintf(stderr, "usage: muduo-top <pid> [-d seconds] [-n count]\n");
+        return 1;
+    }
+    pid_t pid = atoi(argv[1]);
+    double delay = 1.0;
+    int count = 0;
+    for(int i = 2; i + 1 < argc; i += 2)
+    {
+        if(strcmp(argv[i], "-d") == 0)
+        {
+            delay = atof(argv[i + 1]);
+        }
+        else if(strcmp(argv[i], "-n") == 0)
+        {
+            count = atoi(argv[i + 1]);
+        }
+    }
+
+    //进程被kill -9的话析构函数没有机会删掉段，留下来的段不要当成活的进程
+    if(::kill(pid, 0) < 0 && errno == ESRCH)
+    {
+        fprintf(stderr, "muduo-top: process %d is not running\n", pid);
+        return 1;
+    }
+    const StatsShmSegment *seg = attach(pid);
+    if(seg == nullptr)
+    {
+        return 1;
+    }
+    double publishInterval = seg->header.intervalNanos / 1e9;
+    if(delay < publishInterval)
+    {
+        delay = publishInterval; //比发布间隔刷得快也只能看到同一份数据
+    }
+
+    bool clear = ::isatty(STDOUT_FILENO);
+    Snapshot prev;
+    if(!readSnapshot(seg, &prev))
+    {
+        fprintf(stderr, "muduo-top: cannot read a consistent snapshot\n");
+        return 1;
+    }
+    for(int shown = 0; count == 0 || shown < count; )
+    {
+        ::usleep(static_cast<useconds_t>(delay * 1e6));
+        if(::kill(pid, 0) < 0 && errno == ESRCH)
+        {
+            fprintf(stderr, "muduo-top: process %d exited\n", pid);
+            return 0;
+        }
+        Snapshot now;
+        if(!readSnapshot(seg, &now) || now.publishNanos == prev.publishNanos)
+        {
+            continue; //进程还没有发布新的数据
+        }
+        print(pid, now, prev, clear);
+        prev = now;
+        ++shown;
+    }
+    return 0;
+}